@@ -0,0 +1,169 @@
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "data_manager.h"
+#include "camera.h"
+#include "gl/framebuffer.h"
+#include "gl/render_manager.h"
+#include "gl/shader.h"
+#include "utils/image_writer.h"
+#include "utils/photo_utils.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// Renders the QA images of a project without a window: per view, the rotated photo with its
+// landmarks as in the right pane of the detailed mode, and the mesh with the rays of all the
+// view's landmarks as in the left pane. Needs a current GL context; encoding is left to `writer`.
+class BatchRenderer
+{
+public:
+	static const int RENDER_MODE_TEXTURE = 2;
+	static const int RENDER_MODE_PURE_COLOR = 3;
+
+	BatchRenderer(ImageWriter &writer, int maxSize = 1024) :
+		m_writer(writer),
+		m_maxSize(maxSize),
+		m_modelShader(SHADER_DIR"model.vs", SHADER_DIR"model.fs"),
+		m_quadShader(SHADER_DIR"quad.vs", SHADER_DIR"quad.fs"),
+		m_lineShader(SHADER_DIR"line.vs", SHADER_DIR"line.fs"),
+		m_photoFbo("batch photo"),
+		m_modelFbo("batch model")
+	{
+	}
+
+	// Writes <outDir>/view_XX_landmarks.png and view_XX_model.png for every view
+	void renderProject(DataManager &dataManager, const std::filesystem::path &outDir)
+	{
+		TRACE_SCOPE("BatchRenderer::renderProject");
+		std::filesystem::create_directories(outDir);
+
+		const std::vector<Eigen::Vector3f> &aCamPositions = dataManager.getCamPositions();
+		m_modelShader.use();
+		for (std::size_t i = 0; i < aCamPositions.size(); ++i)
+		{
+			std::string strLightPos = "lightPosArr[" + std::to_string(i) + "]";
+			glUniform3fv(glGetUniformLocation(m_modelShader.ID, strLightPos.c_str()), 1, aCamPositions[i].data());
+		}
+
+		glEnable(GL_DEPTH_TEST);
+		glDisable(GL_SCISSOR_TEST);
+		for (unsigned int iView = 0; iView < dataManager.getFaces() && iView < dataManager.getTextures().size(); ++iView)
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "view_%02u", iView);
+			std::string sPrefix = (outDir / name).string();
+			renderLandmarks(dataManager, iView, sPrefix + "_landmarks.png");
+			renderModel(dataManager, iView, sPrefix + "_model.png");
+		}
+	}
+
+private:
+	void renderLandmarks(DataManager &dataManager, unsigned int iView, const std::string &path)
+	{
+		TRACE_SCOPE("BatchRenderer::renderLandmarks");
+		float faceWidth = dataManager.getWidth(), faceHeight = dataManager.getHeight();
+		const std::vector<float> &photoPts = dataManager.getLandmarkCoordsSets()[iView];
+		std::vector<float> scrPts = photo_utils::PhotoPts2ScrPts(photoPts, faceHeight, faceWidth, k_aRotTypes[iView]);
+
+		// The quad is drawn rotated, so the photo height runs along the image width
+		float scale = m_maxSize / std::max(faceWidth, faceHeight);
+		bind(m_photoFbo, int(faceHeight * scale), int(faceWidth * scale));
+
+		m_quadShader.use();
+		m_quadShader.setMat4("Proj", glm::ortho(-1.f, 1.f, -1.f, 1.f, 0.1f, 100.f));
+		m_quadShader.setMat4("View", glm::lookAt(glm::vec3(0.f, 0.f, 5.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f)));
+		m_quadShader.setInt("RenderMode", RENDER_MODE_PURE_COLOR);
+		m_quadShader.setVec3("PureColor", glm::vec3(1.f, 0.f, 0.f));
+		const float pointSize = 0.004f;
+		for (size_t i = 0; i < photoPts.size() / 2; ++i)
+		{
+			if (photoPts[i * 2] == 0.f && photoPts[i * 2 + 1] == 0.f) continue;
+			glm::mat4 quadModel = glm::translate(glm::mat4(1.f), glm::vec3(scrPts[i * 2], scrPts[i * 2 + 1], 0.f));
+			quadModel = glm::scale(quadModel, glm::vec3(pointSize * faceWidth / faceHeight, pointSize, 1.1f));
+			m_quadShader.setMat4("Model", quadModel);
+			m_renderManager.RenderQuad(RotateType_No);
+		}
+
+		m_quadShader.setMat4("Model", Eigen::Matrix4f::Identity());
+		m_quadShader.setInt("RenderMode", RENDER_MODE_TEXTURE);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, dataManager.getTextures()[iView].id);
+		m_renderManager.RenderQuad(k_aRotTypes[iView]);
+		readBack(m_photoFbo, path);
+	}
+
+	void renderModel(DataManager &dataManager, unsigned int iView, const std::string &path)
+	{
+		TRACE_SCOPE("BatchRenderer::renderModel");
+		bind(m_modelFbo, m_maxSize, m_maxSize * 3 / 4);
+		Camera cam;
+		glm::mat4 proj = glm::perspective(glm::radians(cam.Zoom), float(m_modelFbo.width) / m_modelFbo.height, 0.1f, 5000.0f);
+		glm::mat4 view = cam.GetViewMatrix();
+
+		m_modelShader.use();
+		m_modelShader.setMat4("Proj", proj);
+		m_modelShader.setMat4("View", view);
+		m_modelShader.setVec3("ViewPos", cam.Position);
+		dataManager.getModel()->Draw(m_modelShader);
+
+		double invF = 1. / dataManager.getF();
+		double faceWidth = dataManager.getWidth(), faceHeight = dataManager.getHeight();
+		const std::vector<float> &photoPts = dataManager.getLandmarkCoordsSets()[iView];
+		m_lineShader.use();
+		m_lineShader.setMat4("Proj", proj);
+		m_lineShader.setMat4("View", view);
+		m_lineShader.setMat4("Model", dataManager.getInvTransMatrices()[iView]);
+		for (size_t i = 0; i < photoPts.size() / 2; ++i)
+		{
+			if (photoPts[i * 2] == 0.f && photoPts[i * 2 + 1] == 0.f) continue;
+			float x = (photoPts[i * 2] - faceWidth * 0.5 - dataManager.getCx()) * invF;
+			float y = (photoPts[i * 2 + 1] - faceHeight * 0.5 - dataManager.getCy()) * invF;
+			m_lineShader.setVec4("EndPoint", x, y, 1.f, 1.f);
+			m_renderManager.RenderLine();
+		}
+		readBack(m_modelFbo, path);
+	}
+
+	// one target per image kind, so alternating sizes do not reallocate
+	static void bind(Framebuffer &fbo, int width, int height)
+	{
+		fbo.resize(width, height);
+		fbo.bind();
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+
+	void readBack(const Framebuffer &fbo, const std::string &path)
+	{
+		TRACE_SCOPE("BatchRenderer::readBack");
+		std::vector<uint8_t> pixels(size_t(fbo.width) * fbo.height * 3);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, fbo.width, fbo.height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+		fbo.unbind();
+		m_writer.write(path, fbo.width, fbo.height, 3, std::move(pixels), true);
+	}
+
+	ImageWriter &m_writer;
+	int m_maxSize;
+	Shader m_modelShader;
+	Shader m_quadShader;
+	Shader m_lineShader;
+	RenderManager m_renderManager;
+	Framebuffer m_photoFbo;
+	Framebuffer m_modelFbo;
+};
+
+
+#endif // BATCH_RENDERER_H
@@ -0,0 +1,43 @@
+#ifndef MESH_DATA_H
+#define MESH_DATA_H
+
+#include <glm/glm.hpp>
+
+#include "utils/mesh_optimize.h"
+
+#include <vector>
+
+
+class Vertex {
+public:
+	glm::vec3 position_;
+	glm::vec3 normal_;
+	glm::vec4 color_;
+};
+
+
+// Host copy of a mesh as ingested: what the GL Mesh uploads and the CPU passes read
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	// post-transform cache miss ratio of the index order as loaded and after optimize()
+	float acmrBefore = 0.f;
+	float acmrAfter = 0.f;
+
+	// reorders triangles for vertex cache and overdraw, then vertices for fetch locality
+	void optimize()
+	{
+		acmrBefore = mesh_utils::computeAcmr(indices, vertices.size());
+		if (!indices.empty())
+		{
+			mesh_utils::optimizeVertexCache(indices, vertices.size());
+			mesh_utils::optimizeOverdraw(indices, &vertices[0].position_.x, vertices.size(), sizeof(Vertex));
+			mesh_utils::optimizeVertexFetch(vertices, indices);
+		}
+		acmrAfter = mesh_utils::computeAcmr(indices, vertices.size());
+	}
+};
+
+
+#endif // MESH_DATA_H
@@ -0,0 +1,29 @@
+#ifndef MESH_IO_H
+#define MESH_IO_H
+
+#include "core/mesh_data.h"
+
+#include <string>
+#include <vector>
+
+namespace mesh_io
+{
+
+
+// Meshes of a model file in any format ASSIMP reads, triangulated, with generated normals
+// where missing; empty if the file can not be read
+std::vector<MeshData> loadMeshes(const std::string &path);
+
+// Meshes from a cache written by saveCache(), if it is still valid for `sourcePath`
+bool loadCache(const std::string &cachePath, const std::string &sourcePath, std::vector<MeshData> &meshes);
+
+// Writes the meshes, as loaded and optimized, for the next start
+bool saveCache(const std::string &cachePath, const std::string &sourcePath, const std::vector<MeshData> &meshes);
+
+// Optimized meshes of `path`, read from the cache at `cachePath` or loaded, optimized and cached there
+std::vector<MeshData> ingest(const std::string &path, const std::string &cachePath);
+
+
+}
+
+#endif // MESH_IO_H
@@ -0,0 +1,22 @@
+#ifndef PHOTO_CAMERAS_H
+#define PHOTO_CAMERAS_H
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+
+// The calibrated cameras of the photos, one per view: projection matrices that map world points
+// to photo pixels of `width` x `height` photos, and the camera centers. ProjectData owns the one
+// instance; classes that project into the photos keep a pointer to it instead of a copy.
+struct PhotoCameras
+{
+	std::vector<Eigen::Matrix<float, 3, 4>> aProj;
+	std::vector<Eigen::Vector3f> aCenters;
+	float width = 0.f, height = 0.f;
+
+	size_t views() const { return aProj.size(); }
+};
+
+
+#endif // PHOTO_CAMERAS_H
@@ -0,0 +1,134 @@
+#ifndef PROJECT_DATA_H
+#define PROJECT_DATA_H
+
+#include <Eigen/Dense>
+
+#include "core/photo_cameras.h"
+#include "core/texture.h"
+#include "config.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+const RotateType k_aRotTypes[] = {
+	RotateType_CW, RotateType_CW, RotateType_CW, RotateType_CW, 
+	RotateType_CW, RotateType_CCW, RotateType_CCW, RotateType_CW, 
+	RotateType_CW, RotateType_CW, RotateType_CCW, RotateType_CCW, 
+	RotateType_CCW, RotateType_CCW, RotateType_CCW, RotateType_CCW, 
+	RotateType_CCW, RotateType_CW, RotateType_CW, RotateType_CCW,
+	RotateType_CCW, RotateType_CCW, RotateType_CCW, RotateType_CCW
+};
+
+// The files of one capture project without any GL: cameras from the PhotoScan XML, the 2D
+// landmark annotations and the decoded photos. Loaded on construction; the viewer's
+// DataManager adds the model and the GPU resources on top.
+class ProjectData
+{
+public:
+	explicit ProjectData(const std::string &rootDir);
+	virtual ~ProjectData();
+
+	ProjectData(const ProjectData&) = delete;
+	ProjectData& operator=(const ProjectData&) = delete;
+
+	// writes the landmarks of one view over its annotation files, keeping the old ones as backups
+	void saveLandmarks(unsigned int iPickedFace);
+
+	// A landmark that changed on disk while it had unsaved edits here; the edit is kept
+	struct LandmarkConflict
+	{
+		int iView;
+		int iLandmark;
+		float local[2];
+		float disk[2];
+	};
+
+	// A landmark that took the position from disk
+	struct LandmarkUpdate
+	{
+		int iView;
+		int iLandmark;
+		float from[2];
+		float to[2];
+	};
+
+	struct LandmarkReload
+	{
+		size_t nFiles = 0;		// parsed and merged
+		std::vector<LandmarkUpdate> aUpdates;
+		std::vector<LandmarkConflict> aConflicts;
+	};
+
+	// Re-reads the given annotation files, others in the list are ignored, and merges them into the
+	// landmarks: every changed file is parsed before anything is written, and a file that fails to
+	// parse is skipped whole. A landmark takes the position from disk unless it was edited since the
+	// last load or save, in which case it is reported as a conflict if the file moved it as well
+	LandmarkReload reloadLandmarks(const std::vector<fs::path> &aPaths);
+
+	// true if landmark `iLandmark` of `iView` differs from what was last loaded or saved
+	bool isEdited(int iView, int iLandmark) const;
+
+	// frees decoded photos that were never uploaded, as in software rendering
+	void releasePixels();
+
+	fs::path photoPath(int i) const;
+	const fs::path& rootDir() const { return m_pathRootDir; }
+	const fs::path& modelPath() const { return m_pathModel; }
+	const fs::path& facialLandmarkDir() const { return m_dirFacialLdmk; }
+	const fs::path& earLandmarkDir() const { return m_dirEarLdmk; }
+
+	double getF() const { return m_f; }
+	double getCx() const { return m_cx; }
+	double getCy() const { return m_cy; }
+	double getWidth() const { return m_width; }
+	double getHeight() const { return m_height; }
+	double getScale() const { return m_scale; }
+	unsigned int getFaces() const { return m_nFaces; }
+
+	const PhotoCameras& getCameras() const { return m_cameras; }
+	const std::vector<Eigen::Matrix<float, 3, 4>>& getProjMatrices() const { return m_cameras.aProj; }
+	const std::vector<Eigen::Matrix4f>& getInvTransMatrices() const { return m_aInvTransMatrices; }
+	const std::vector<Eigen::Vector3f>& getCamPositions() const { return m_cameras.aCenters; }
+	std::vector<std::vector<float>>& getLandmarkCoordsSets() { return m_aLandmarkCoordsSets; }
+	const std::vector<Texture>& getTextures() const { return m_aTextures; }
+
+protected:
+	fs::path m_pathRootDir;
+	fs::path m_dirFacialLdmk;
+	fs::path m_dirEarLdmk;
+	fs::path m_pathPhotoDir;
+	fs::path m_pathModel;
+	fs::path m_pathXml;
+
+	// camera infomation
+	double m_f;
+	double m_cx;
+	double m_cy;
+	double m_width;
+	double m_height;
+	double m_scale;
+	unsigned int m_nFaces;
+	PhotoCameras m_cameras;
+	std::vector<Eigen::Matrix<float, 3, 4> > m_aTransMatrices;
+	std::vector<Eigen::Matrix4f> m_aInvTransMatrices;
+
+	std::vector<std::vector<float>> m_aLandmarkCoordsSets;
+	std::vector<std::vector<float>> m_aSavedLandmarkSets;	// as last loaded or saved, to tell local edits apart
+	std::vector<Texture> m_aTextures;
+
+private:
+	int loadCamInfo();
+	void loadLandmarks();
+	// first landmark a file of `dir` holds and how many, false if it is no annotation directory
+	bool landmarkRange(const fs::path &dir, int &iFirst, int &n) const;
+	// reads landmarks iFirst..iFirst + n - 1 from the lines of `path` into `coords`, ignoring any
+	// further lines; false if unreadable or malformed
+	static bool parseLandmarks(const fs::path &path, int iFirst, int n, std::vector<float> &coords);
+	void loadTextures();
+};
+
+
+#endif // PROJECT_DATA_H
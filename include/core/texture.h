@@ -0,0 +1,34 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <string>
+#include <iostream>
+
+#include "stb_image.h"	// implemented in src/core/stb_image.cpp
+
+#include "config.h"
+
+// A decoded photo; `id` is the GL texture once the viewer uploads it
+class Texture
+{
+public:
+	Texture() = default;
+	Texture(const std::string& p)
+	{
+		data = stbi_load(p.c_str(), &width, &height, &channels, 0);
+		if (!data)
+		{
+			std::cout << "Texture failed to load at path: " << p << std::endl;
+			stbi_image_free(data);
+		}
+	}
+
+	unsigned int id = 0;
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	unsigned char *data = nullptr;	// decoded pixels, freed once uploaded
+};
+
+
+#endif // TEXTURE_H
\ No newline at end of file
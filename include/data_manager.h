@@ -1,118 +1,147 @@
 #ifndef DATA_MANAGER
 #define DATA_MANAGER
 
-#include "utils/file_utils.h"
+#include "core/mesh_io.h"
+#include "core/project_data.h"
+#include "utils/task_scheduler.h"
+#include "utils/trace.h"
 #include "gl/model.h"
 #include "gl/render_manager.h"
-#include "gl/texture.h"
+#include "memory_registry.h"
+#include "vertex_color_baker.h"
 #include "config.h"
-#include "tinyxml2.h"
 #include <Eigen/Dense>
-#include <boost/algorithm/string.hpp>
 
+#include <algorithm>
 #include <filesystem>
-#include <fstream>
+#include <future>
+#include <memory>
 #include <string>
 #include <iostream>
 #include <vector>
 #include <chrono>
 
-namespace fs = std::filesystem;
-using namespace tinyxml2;
-
-const RotateType k_aRotTypes[] = {
-	RotateType_CW, RotateType_CW, RotateType_CW, RotateType_CW, 
-	RotateType_CW, RotateType_CCW, RotateType_CCW, RotateType_CW, 
-	RotateType_CW, RotateType_CW, RotateType_CCW, RotateType_CCW, 
-	RotateType_CCW, RotateType_CCW, RotateType_CCW, RotateType_CCW, 
-	RotateType_CCW, RotateType_CW, RotateType_CW, RotateType_CCW,
-	RotateType_CCW, RotateType_CCW, RotateType_CCW, RotateType_CCW
-};
-
-class DataManager
+// The project plus what the viewer needs a GL context for: the uploaded photos and the model
+class DataManager : public ProjectData
 {
 public:
 	DataManager(const std::string &rootDir) :
-		m_pathRootDir(fs::path(rootDir)),
-		m_dirFacialLdmk(m_pathRootDir / "face_landmarks"),
-		m_dirEarLdmk(m_pathRootDir / "ear_landmarks"),
-		m_pathPhotoDir(m_pathRootDir / "image"),
-		m_pathXml(m_pathRootDir / "cam_scale.xml"),
-		m_pathModel(m_pathRootDir / "photoscan_scale.ply")
+		ProjectData(rootDir)
+	{
+	}
+
+	~DataManager()
+	{
+		delete m_model;
+	}
+
+	DataManager(const DataManager&) = delete;
+	DataManager& operator=(const DataManager&) = delete;
+
+	// `bGenerateLods` = false skips the background LOD and meshlet build, for one-shot rendering;
+	// `bUpload` = false keeps the meshes on the host only, for the software rasterizer;
+	// `bPhotoColors` bakes vertex colors from the photos and shows them instead of the mesh's own,
+	// so then call it before bindTextures() frees their pixels. Batch renders keep the mesh colors
+	void loadModel(bool bGenerateLods = true, bool bUpload = true, bool bPhotoColors = false)
 	{
-		loadCamInfo();
-		loadLandmarks();
-		loadTextures();
+		TRACE_SCOPE("DataManager::loadModel");
+		m_model = ingestModel(m_pathModel, m_scale).release();
+		setupModel(bGenerateLods, bUpload, bPhotoColors);
 	}
 
-	void loadModel()
+	// Starts re-reading the model file on the scheduler, e.g. after another tool rewrote it; the
+	// current model stays in use until pollReload() says the new one is ready. A request while a
+	// reload runs starts another one once it is done, so the latest file contents win
+	void startReloadModel()
 	{
-		m_model = new Model(m_pathModel.string());
-		for(auto& mesh : m_model->meshes)
+		if (m_reloadTask.valid())
 		{
-			for(auto& v : mesh.vertices)
-			{
-				v.position_ = v.position_ / static_cast<float>(m_scale);
-			}
+			m_bReloadAgain = true;
+			return;
 		}
-		m_model->setup();
+		fs::path pathModel = m_pathModel;
+		double scale = m_scale;
+		m_reloadTask = utils::scheduler().submit([pathModel, scale]() {
+			return ingestModel(pathModel, scale);
+		}, utils::TaskPriority_Normal);
 	}
 
-	void saveLandmarks(unsigned int iPickedFace) const
+	// True once a reload is ready for finishReload(), polled from the render loop
+	bool pollReload()
 	{
-		std::cout << "save landmark from face " << iPickedFace << std::endl;
+		if (!m_reloadTask.valid() || m_reloadTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+		if (!m_bReloadAgain)
+			return true;
+		m_reloadTask = std::future<std::unique_ptr<Model>>();
+		m_bReloadAgain = false;
+		startReloadModel();
+		return false;
+	}
 
-		auto landmarkCoords = m_aLandmarkCoordsSets[iPickedFace];
-		auto now = std::chrono::system_clock::now();
-		time_t tt = std::chrono::system_clock::to_time_t(now);
-		std::string strTime = ctime(&tt);
-		strTime = strTime.substr(4, 3) + "_" + strTime.substr(9, 1) + "_" + strTime.substr(11, 8);
-		fs::path landmarkFile = m_dirFacialLdmk / (file_utils::Id2Str(iPickedFace) + ".txt");
-		if(fs::exists(landmarkFile))
+	// Swaps the reloaded model in, on the GL thread. Nothing may still use the old one, including
+	// background builds over its meshes. The photos' pixels are gone by now, so the baked colors
+	// come back only from a cache that still matches
+	void finishReload()
+	{
+		TRACE_SCOPE("DataManager::finishReload");
+		std::unique_ptr<Model> pModel = m_reloadTask.get();
+		if (m_model)
 		{
-			fs::rename(landmarkFile, fs::path(m_dirFacialLdmk / (file_utils::Id2Str(iPickedFace)
-				+ "_" + strTime + ".backup")));
-			std::ofstream out(landmarkFile.string());
-			for (int i = 0; i < N_FACIAL_LDMKS; ++i)
-			{
-				out << std::scientific << std::setprecision(19) 
-					<< landmarkCoords[i * 2] << " " << landmarkCoords[i * 2 + 1] << "\n";
-			}
-			out.close();
+			m_model->release();
+			delete m_model;
 		}
-		landmarkFile = m_dirEarLdmk / (file_utils::Id2Str(iPickedFace) + ".txt");
+		m_model = pModel.release();
+		setupModel(true, true, true);
+	}
+
+	bool hasPhotoColors() const { return !m_aPhotoColors.empty(); }
+	bool usesPhotoColors() const { return m_bPhotoColors; }
 
-		if(fs::exists(landmarkFile))
+	// switches the mesh between the colors baked from the photos and its own;
+	// `bUpload` refills the vertex buffers, which must then run on the GL thread
+	void usePhotoColors(bool bUse, bool bUpload = true)
+	{
+		m_bPhotoColors = bUse && hasPhotoColors();
+		const std::vector<uint8_t> &aColors = m_bPhotoColors ? m_aPhotoColors : m_aSourceColors;
+		size_t i = 0;
+		for (auto &mesh : m_model->meshes)
 		{
-			fs::rename(landmarkFile, fs::path(m_dirEarLdmk / (file_utils::Id2Str(iPickedFace)
-				+ "_" + strTime + ".backup")));
-			std::ofstream out(landmarkFile.string());
-			for (int i = N_FACIAL_LDMKS; i < N_LANDMARKS; ++i)
+			for (auto &v : mesh.vertices)
 			{
-				out << std::scientific << std::setprecision(19) 
-					<< landmarkCoords[i * 2] << " " << landmarkCoords[i * 2 + 1] << "\n";
+				v.color_ = glm::vec4(aColors[i], aColors[i + 1], aColors[i + 2], aColors[i + 3]) / 255.f;
+				i += 4;
 			}
-			out.close();
+			if (bUpload)
+				mesh.uploadVertices();
 		}
 	}
 
-	const Model *getModel() const { return m_model; }
+	// deletes the textures and mesh buffers; must run on the GL thread before the context goes away
+	void releaseGpu()
+	{
+		for (size_t i = 0; i < m_aTextures.size(); ++i)
+		{
+			glDeleteTextures(1, &m_aTextures[i].id);
+			m_aTextures[i].id = 0;
+			for (int level = 0; level < 32; ++level)
+				g_memoryRegistry.release("Photos", "view " + std::to_string(i) + " mip " + std::to_string(level));
+		}
+		if (m_model)
+			m_model->release();
+	}
 
-	double getF() const { return m_f; }
-	double getCx() const { return m_cx; }
-	double getCy() const { return m_cy; }
-	double getWidth() const { return m_width; }
-	double getHeight() const { return m_height; }
-	unsigned int getFaces() const { return m_nFaces; }
+	// picks up model data finished by background workers; call once per frame on the GL thread
+	bool updateModel()
+	{
+		return m_model->pollLods();
+	}
 
-	const std::vector<Eigen::Matrix<float, 3, 4>>& getProjMatrices() const { return m_aProjMatrices; }
-	const std::vector<Eigen::Matrix4f>& getInvTransMatrices() const { return m_aInvTransMatrices; }
-	const std::vector<Eigen::Vector3f>& getCamPositions() const { return m_aCamPositions; }
-	std::vector<std::vector<float>>& getLandmarkCoordsSets() { return m_aLandmarkCoordsSets; }
-	const std::vector<Texture>& getTextures() const { return m_aTextures; }
+	const Model *getModel() const { return m_model; }
 
 	void bindTextures()
 	{
+		TRACE_SCOPE("DataManager::bindTextures");
 		for (auto& tex : m_aTextures)
 		{
 			glGenTextures(1, &tex.id);
@@ -127,324 +156,108 @@ public:
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+			// RGB8 is padded to 4 bytes per texel by most drivers
+			std::string sView = "view " + std::to_string(&tex - &m_aTextures[0]);
+			int level = 0;
+			for (int w = tex.width, h = tex.height; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1), ++level)
+			{
+				g_memoryRegistry.set("Photos", sView + " mip " + std::to_string(level), 
+					MemoryRegistry::Location_Gpu, size_t(w) * h * 4);
+				if (w == 1 && h == 1)
+					break;
+			}
+
 			stbi_image_free(tex.data);
+			tex.data = nullptr;
+			g_memoryRegistry.release("Photos", sView + " pixels");
 		}
 	}
 
-	fs::path m_pathRootDir;
-	fs::path m_dirFacialLdmk;
-	fs::path m_dirEarLdmk;
-	fs::path m_pathPhotoDir;
-	fs::path m_pathModel;
-	fs::path m_pathXml;
-
-	Model *m_model;
-
-	// camera infomation
-	double m_f;
-	double m_cx;
-	double m_cy;
-	double m_width;
-	double m_height;
-	double m_scale;
-	unsigned int m_nFaces;
-	std::vector<Eigen::Matrix<float, 3, 4> > m_aProjMatrices;
-	std::vector<Eigen::Matrix<float, 3, 4> > m_aTransMatrices;
-	std::vector<Eigen::Matrix4f> m_aInvTransMatrices;
-	std::vector<Eigen::Vector3f> m_aCamPositions;
-
-	std::vector<std::vector<float>> m_aLandmarkCoordsSets;
-	std::vector<Texture> m_aTextures;
-
 private:
-
-	int loadCamInfo()
+	Model *m_model = nullptr;
+	std::future<std::unique_ptr<Model>> m_reloadTask;
+	bool m_bReloadAgain = false;	// the file changed again while m_reloadTask ran
+
+	// RGBA8 per vertex of every mesh: baked from the photos, and as loaded
+	std::vector<uint8_t> m_aPhotoColors;
+	std::vector<uint8_t> m_aSourceColors;
+	bool m_bPhotoColors = false;
+
+	// Meshes of the model file in the cameras' units, without GL, so it can run on a worker;
+	// optimized meshes are cached next to the model file
+	static std::unique_ptr<Model> ingestModel(const fs::path &pathModel, double scale)
 	{
-		std::cout << "Load camera information." << std::endl;
-
-		Eigen::Matrix4f T_model = Eigen::Matrix4f::Identity();
-
-		m_aProjMatrices.clear();
-		m_aTransMatrices.clear();
-		m_aInvTransMatrices.clear();
-		m_aCamPositions.clear();
-
-		std::vector<double> sensor_f;
-		std::vector<double> sensor_cx;
-		std::vector<double> sensor_cy;
-		std::vector<double> sensor_w;
-		std::vector<double> sensor_h;
-
-		std::vector<int> sensor_idxs;
-
-		int sensorNum;
-
-		XMLDocument doc;
-		doc.LoadFile(m_pathXml.string().c_str());
-
-		XMLElement *root = doc.RootElement();
-		XMLElement *chunk = root->FirstChildElement("chunk");  //document->chunk->sensors
-		if (chunk != NULL)
+		TRACE_SCOPE("DataManager::ingestModel");
+		fs::path pathCache = pathModel;
+		pathCache += ".meshcache";
+		std::unique_ptr<Model> pModel(new Model());
+		for (auto &data : mesh_io::ingest(pathModel.string(), pathCache.string()))
+			pModel->meshes.emplace_back(std::move(data));
+		for(auto& mesh : pModel->meshes)
 		{
-			//model transform
-			XMLElement *xml_transform = chunk->FirstChildElement("transform");
-			if (xml_transform != NULL)
-			{
-				XMLElement* rot = xml_transform->FirstChildElement("rotation");
-				if(rot)
-				{
-					const char* rotationText = xml_transform->FirstChildElement("rotation")->GetText();
-					const char* translationText = xml_transform->FirstChildElement("translation")->GetText();
-
-					char *rotation = const_cast<char *>(rotationText);
-					char *splits;
-					const char *d = " ";
-					splits = strtok(rotation, d);
-					int row = 0, col = 0;
-					while (splits)
-					{
-						T_model(row, col) = atof(splits);
-						col++;
-						if (col == 3)
-						{
-							row++;
-							col = 0;
-						}
-						splits = strtok(NULL, d);
-					}
-
-					char *translation = const_cast<char *>(translationText);
-					splits = strtok(translation, d);
-					for (int i = 0; i < 3; i++)
-					{
-						T_model(i, 3) = atof(splits);
-						splits = strtok(NULL, d);
-					}
-				}
-				else
-				{
-					m_scale = stod(xml_transform->FirstChildElement("scale")->GetText());
-					std::cout << "Scale:" << m_scale << std::endl;
-				}
-			}
-
-
-			// sensors
-			XMLElement *xml_sensors = chunk->FirstChildElement("sensors");
-			if (xml_sensors != NULL)
-			{
-				int sensorNum = atoi(xml_sensors->Attribute("next_id"));
-				cout << "sensor nums: " << sensorNum << endl;
-
-				// intial sensor size
-				sensor_f.resize(sensorNum);
-				sensor_cx.resize(sensorNum);
-				sensor_cy.resize(sensorNum);
-				sensor_w.resize(sensorNum);
-				sensor_h.resize(sensorNum);
-
-				XMLElement *xml_sensor = xml_sensors->FirstChildElement("sensor");
-				for (int i = 0; i < sensorNum; i++)
-					while (NULL != xml_sensor)
-					{
-						int sensorId = atoi(xml_sensor->Attribute("id"));
-						//cout<<sensorId<<endl;
-
-						XMLElement *xml_calibration = xml_sensor->FirstChildElement("calibration");
-						XMLElement *xml_resolution = xml_calibration->FirstChildElement("resolution");
-
-						XMLElement *xml_f = xml_calibration->FirstChildElement("f");
-						XMLElement *xml_cx = xml_calibration->FirstChildElement("cx");
-						XMLElement *xml_cy = xml_calibration->FirstChildElement("cy");
-
-						sensor_w[sensorId] = atoi(xml_resolution->Attribute("width"));
-						sensor_h[sensorId] = atoi(xml_resolution->Attribute("height"));
-						sensor_f[sensorId] = atof(xml_f->GetText());
-						sensor_cx[sensorId] = atof(xml_cx->GetText());
-						sensor_cy[sensorId] = atof(xml_cy->GetText());
-
-						//distoration parameters
-						XMLElement *xml_k1 = xml_calibration->FirstChildElement("k1");
-						XMLElement *xml_k2 = xml_calibration->FirstChildElement("k2");
-						XMLElement *xml_p1 = xml_calibration->FirstChildElement("p1");
-						XMLElement *xml_p2 = xml_calibration->FirstChildElement("p2");
-						XMLElement *xml_k3 = xml_calibration->FirstChildElement("k3");
-
-						xml_sensor = xml_sensor->NextSiblingElement("sensor");
-					}
-			}
-
-			//cameras
-			XMLElement *cameras = chunk->FirstChildElement("cameras");
-			if (cameras != NULL)
+			for(auto& v : mesh.vertices)
 			{
-				m_nFaces = atoi(cameras->Attribute("next_id"));
-				cout << "camera nums: " << m_nFaces << endl;
-
-				sensor_idxs.resize(m_nFaces);
-
-				XMLElement *xml_camera = cameras->FirstChildElement("camera");
-				while (NULL != xml_camera)
-				{
-
-					Eigen::Matrix<float, 4, 4> T_camera;
-					Eigen::Matrix<float, 3, 4> P;
-					int camera_idx = atoi(xml_camera->Attribute("id"));
-					int sensor_idx = atoi(xml_camera->Attribute("sensor_id"));
-					//cout << "camera " << camera_idx << " using sensor " << sensor_idx << endl;
-
-
-					const char* transformtmp = xml_camera->FirstChildElement("transform")->GetText();
-					char *transform = const_cast<char *>(transformtmp);
-					char *splits;
-					const char *d = " ";
-					splits = strtok(transform, d);
-					int row = 0, col = 0;
-					while (splits) {
-						T_camera(row, col) = atof(splits);
-						col++;
-						if (col == 4) {
-							row++;
-							col = 0;
-						}
-						splits = strtok(NULL, d);
-
-					}
-
-					double f = sensor_f[sensor_idx];
-					double cx = sensor_cx[sensor_idx];
-					double cy = sensor_cy[sensor_idx];
-					double w = sensor_w[sensor_idx];
-					double h = sensor_h[sensor_idx];
-					Eigen::Matrix<float, 3, 4> K;
-					K << f, 0, w / 2.0 + cx, 0,
-						0, f, h / 2.0 + cy, 0,
-						0, 0, 1, 0;
-
-					Eigen::Matrix<float, 4, 4> T = T_camera.inverse() * T_model.inverse();
-					P = K * T;
-
-					m_aProjMatrices.push_back(P);
-					m_aTransMatrices.push_back(T.block(0, 0, 3, 4));
-					m_aInvTransMatrices.push_back(T.inverse());
-
-					Eigen::Matrix3f R = T.block(0, 0, 3, 3);
-					Eigen::Vector3f t(T(0, 3), T(1, 3), T(2, 3));
-					Eigen::Vector3f tmp = -R.transpose()*t;
-					m_aCamPositions.push_back(Eigen::Vector3f(tmp[0], tmp[1], tmp[2]));
-
-					sensor_idxs[camera_idx] = sensor_idx;
-
-					xml_camera = xml_camera->NextSiblingElement("camera");
-				}
+				v.position_ = v.position_ / static_cast<float>(scale);
 			}
 		}
-
-		m_f = sensor_f[0];
-		m_cx = sensor_cx[0];
-		m_cy = sensor_cy[0];
-		m_width = sensor_w[0];
-		m_height = sensor_h[0];
-
-		return 0;
+		return pModel;
 	}
 
-	void loadLandmarks()
+	// colors, buffers and LODs of a freshly ingested m_model, see loadModel()
+	void setupModel(bool bGenerateLods, bool bUpload, bool bPhotoColors)
 	{
-		std::cout << "Load landmarks." << std::endl;
-
-		m_aLandmarkCoordsSets.resize(m_nFaces);
-		for(auto& set : m_aLandmarkCoordsSets)
-			set = std::vector<float>(N_LANDMARKS * 2, 0.f);
-
-		if (!std::filesystem::exists(m_dirFacialLdmk))
-		{
-			std::cout << "Error: Directory " << m_dirFacialLdmk << " does not exist." << std::endl;
-			return;
-		}
-
-		std::cout << m_dirFacialLdmk << std::endl;
-		for (std::filesystem::directory_iterator it(m_dirFacialLdmk); 
-			it != std::filesystem::directory_iterator(); it++)
+		m_aPhotoColors.clear();
+		m_aSourceColors.clear();
+		m_bPhotoColors = false;
+		g_memoryRegistry.release("Meshes", "vertex colors");
+		if (bPhotoColors)
 		{
-			if (it->path().extension() != ".txt")
-				continue;
-
-			std::string filename = it->path().string();
-			std::cout << "Load landmarks from: " << filename << std::endl;
-			unsigned int camera_id = file_utils::Str2Id(it->path().stem().string());
-
-			std::ifstream in(filename);
-			if (!in)
-			{
-				std::cout << "\nError: Can not open " << it->path().string() << "." << std::endl;
-				return;
-			}
-			std::string line;
-			int i = 0;
-			while (std::getline(in, line))
-			{
-				if (line.empty() || line == "\n")
-					continue;
-				std::vector<std::string> words;
-				boost::split(words, line, boost::is_any_of(" "));
-				m_aLandmarkCoordsSets[camera_id][i * 2] = std::stof(words[0]);
-				m_aLandmarkCoordsSets[camera_id][(i++) * 2 + 1] = std::stof(words[1]);
-				// std::cout << m_aLandmarkCoordsSets[camera_id][(i-1) * 2] << " : " << 
-				// 	m_aLandmarkCoordsSets[camera_id][(i-1) * 2 + 1] << std::endl;
-			}
+			loadPhotoColors();
+			usePhotoColors(hasPhotoColors(), false);
 		}
-
-		if (!std::filesystem::exists(m_dirEarLdmk))
-		{
-			std::cout << "Error: Diretcory " << m_dirEarLdmk << " does not exist." << std::endl;
+		if (!bUpload)
 			return;
-		}
+		m_model->setup();
+		if (bGenerateLods)
+			m_model->generateLods();
+	}
 
-		for (std::filesystem::directory_iterator it(m_dirEarLdmk); it != std::filesystem::directory_iterator(); it++)
+	// vertex colors baked from the photos, cached next to the model with the files they came from;
+	// without a valid cache or decoded photos the mesh keeps its own colors
+	void loadPhotoColors()
+	{
+		TRACE_SCOPE("DataManager::loadPhotoColors");
+		m_aSourceColors.clear();
+		for (const auto &mesh : m_model->meshes)
 		{
-			if (it->path().extension() != ".txt")
-				continue;
-
-			unsigned int camera_id = file_utils::Str2Id(it->path().stem().string());
-			std::cout << "Cam: " << camera_id << std::endl;
-			std::string filename = it->path().string();
-			std::cout << "Load landmarks from: " << filename << std::endl;
-
-			std::ifstream in(filename);
-			if (!in)
+			for (const auto &v : mesh.vertices)
 			{
-				std::cout << "\nError: Can not open " << it->path().string() << "." << std::endl;
-				return;
-			}
-			std::string line;
-			int i = 0;
-			while (std::getline(in, line))
-			{
-				if (line.empty() || line == "\n")
-					continue;
-				std::vector<std::string> words;
-				boost::split(words, line, boost::is_any_of(" "));
-				m_aLandmarkCoordsSets[camera_id][(N_FACIAL_LDMKS + i) * 2] = std::stof(words[0]);
-				m_aLandmarkCoordsSets[camera_id][(N_FACIAL_LDMKS + i++) * 2 + 1] = std::stof(words[1]);
+				for (int k = 0; k < 4; ++k)
+					m_aSourceColors.push_back(static_cast<uint8_t>(std::lround(glm::clamp(v.color_[k], 0.f, 1.f) * 255.f)));
 			}
 		}
-		std::cout << "Done" << std::endl;
-
-	}
-
-	void loadTextures()
-	{
-		std::cout << "Load texture" << std::endl;
-		m_aTextures.resize(N_VIEWS);
-		for (auto i = 0; i < N_VIEWS; i++)
+		m_aPhotoColors.clear();
+
+		std::vector<std::string> aPhotoPaths;
+		for (int i = 0; i < int(m_aTextures.size()); ++i)
+			aPhotoPaths.push_back(photoPath(i).string());
+		fs::path pathCache = m_pathModel;
+		pathCache += ".colors";
+		VertexColorBaker::CacheHeader header = VertexColorBaker::cacheHeader(m_pathModel.string(), aPhotoPaths, m_aSourceColors.size() / 4);
+		VertexColorBaker baker;
+		if (!baker.loadCache(pathCache.string(), header))
 		{
-			fs::path pathTexture = m_pathPhotoDir / (file_utils::Id2Str(i) + ".jpg");
-			if(!fs::exists(pathTexture))
-				pathTexture = m_pathPhotoDir / (file_utils::Id2Str(i) + ".JPG");
-			std::cout << "Load texture: " << pathTexture.string() << std::endl;
-			m_aTextures[i] = Texture(pathTexture.string());
+			if (std::none_of(m_aTextures.begin(), m_aTextures.end(), [](const Texture &tex) { return tex.data != nullptr; }))
+				return;
+			auto start = std::chrono::steady_clock::now();
+			baker.bake(*m_model, m_cameras, m_aTextures);
+			std::cout << "Baked photo colors into " << baker.bakedCount() << " of " << header.vertexCount << " vertices in "
+				<< std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms." << std::endl;
+			baker.saveCache(pathCache.string(), header);
 		}
+		m_aPhotoColors = baker.colors();
+		g_memoryRegistry.set("Meshes", "vertex colors", MemoryRegistry::Location_Host, 
+			m_aPhotoColors.capacity() + m_aSourceColors.capacity());
 	}
 
 };
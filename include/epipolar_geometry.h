@@ -0,0 +1,121 @@
+#ifndef EPIPOLAR_GEOMETRY_H
+#define EPIPOLAR_GEOMETRY_H
+
+#include <Eigen/Dense>
+
+#include "core/photo_cameras.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+
+// Fundamental matrices between every pair of views, computed once from the projection matrices.
+// fundamental(iFrom, iTo) maps a photo pixel of view `iFrom` to its epipolar line in view `iTo`,
+// so drawing the lines of one landmark is a 3x3 product and a clip per view.
+class EpipolarGeometry
+{
+public:
+	// `cameras` must outlive this, or the next setCameras()
+	void setCameras(const PhotoCameras *cameras)
+	{
+		m_cameras = cameras;
+		m_nViews = cameras->views();
+
+		// pseudo-inverses, once per view
+		std::vector<Eigen::Matrix<double, 3, 4>> aProj(m_nViews);
+		std::vector<Eigen::Matrix<double, 4, 3>> aPinv(m_nViews);
+		for (size_t i = 0; i < m_nViews; ++i)
+		{
+			aProj[i] = cameras->aProj[i].cast<double>();
+			aPinv[i] = aProj[i].transpose() * (aProj[i] * aProj[i].transpose()).inverse();
+		}
+
+		// F = [e']x P' P+, with e' the epipole of the source camera in the target view
+		m_aF.assign(m_nViews * m_nViews, Eigen::Matrix3f::Zero());
+		for (size_t iFrom = 0; iFrom < m_nViews; ++iFrom)
+		{
+			for (size_t iTo = 0; iTo < m_nViews; ++iTo)
+			{
+				if (iFrom == iTo)
+					continue;
+				Eigen::Vector3d e = aProj[iTo] * cameras->aCenters[iFrom].cast<double>().homogeneous();
+				Eigen::Matrix3d ex;
+				ex << 0., -e.z(), e.y(),
+					e.z(), 0., -e.x(),
+					-e.y(), e.x(), 0.;
+				Eigen::Matrix3d F = ex * aProj[iTo] * aPinv[iFrom];
+				m_aF[iFrom * m_nViews + iTo] = (F / F.norm()).cast<float>();
+			}
+		}
+	}
+
+	size_t views() const { return m_nViews; }
+
+	const Eigen::Matrix3f& fundamental(size_t iFrom, size_t iTo) const { return m_aF[iFrom * m_nViews + iTo]; }
+
+	// Appends x0, y0, x1, y1 in photo pixels of view `iView` for the epipolar line of landmark
+	// `iLandmark` from every other view annotating it; returns the number of segments added
+	size_t segments(const std::vector<std::vector<float>> &aLandmarkSets, size_t iView, size_t iLandmark,
+		std::vector<float> &aSegments) const
+	{
+		size_t nSegments = 0;
+		for (size_t iFrom = 0; iFrom < m_nViews && iFrom < aLandmarkSets.size(); ++iFrom)
+		{
+			const std::vector<float> &pts = aLandmarkSets[iFrom];
+			if (iFrom == iView || iLandmark * 2 + 1 >= pts.size())
+				continue;
+			float x = pts[iLandmark * 2], y = pts[iLandmark * 2 + 1];
+			if (x == 0.f && y == 0.f) continue;
+
+			Eigen::Vector3f line = fundamental(iFrom, iView) * Eigen::Vector3f(x, y, 1.f);
+			Eigen::Vector2f p0, p1;
+			if (clip(line, p0, p1))
+			{
+				aSegments.insert(aSegments.end(), { p0.x(), p0.y(), p1.x(), p1.y() });
+				++nSegments;
+			}
+		}
+		return nSegments;
+	}
+
+private:
+	// Liang-Barsky clip of the line a*x + b*y + c = 0 to the photo rectangle
+	bool clip(const Eigen::Vector3f &line, Eigen::Vector2f &p0, Eigen::Vector2f &p1) const
+	{
+		float n2 = line.head<2>().squaredNorm();
+		if (n2 < std::numeric_limits<float>::min())
+			return false;
+		Eigen::Vector2f origin = -line.z() / n2 * line.head<2>();
+		Eigen::Vector2f dir(-line.y(), line.x());
+
+		float tMin = -std::numeric_limits<float>::infinity(), tMax = std::numeric_limits<float>::infinity();
+		const float aMin[2] = { 0.f, 0.f }, aMax[2] = { m_cameras->width, m_cameras->height };
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			if (std::abs(dir[axis]) < 1e-12f)
+			{
+				if (origin[axis] < aMin[axis] || origin[axis] > aMax[axis])
+					return false;
+				continue;
+			}
+			float t0 = (aMin[axis] - origin[axis]) / dir[axis];
+			float t1 = (aMax[axis] - origin[axis]) / dir[axis];
+			tMin = std::max(tMin, std::min(t0, t1));
+			tMax = std::min(tMax, std::max(t0, t1));
+		}
+		if (tMin >= tMax)
+			return false;
+		p0 = origin + tMin * dir;
+		p1 = origin + tMax * dir;
+		return true;
+	}
+
+	const PhotoCameras *m_cameras = nullptr;
+	size_t m_nViews = 0;
+	std::vector<Eigen::Matrix3f> m_aF;	// row-major over (from, to)
+};
+
+
+#endif // EPIPOLAR_GEOMETRY_H
@@ -0,0 +1,15 @@
+#ifndef DRAW_STATS_H
+#define DRAW_STATS_H
+
+
+// Per-frame counters of GL work, reset by the frame profiler
+struct DrawStats
+{
+	unsigned int drawCalls = 0;
+	unsigned int stateChanges = 0;	// program, texture, vertex array and framebuffer binds
+};
+
+inline DrawStats g_drawStats;
+
+
+#endif // DRAW_STATS_H
@@ -0,0 +1,122 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <glad/glad.h>
+
+#include "gl/draw_stats.h"
+#include "memory_registry.h"
+
+#include <iostream>
+#include <string>
+
+
+// Offscreen render target with a color texture and a depth-stencil renderbuffer
+class Framebuffer
+{
+public:
+	explicit Framebuffer(const std::string &name = "framebuffer") : m_name(name) {}
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer& operator=(const Framebuffer&) = delete;
+
+	~Framebuffer()
+	{
+		release();
+	}
+
+	// (Re)allocates the attachments when the size changes; returns true if it did
+	bool resize(int w, int h)
+	{
+		if (FBO != 0 && w == width && h == height)
+			return false;
+		release();
+		width = w;
+		height = h;
+
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+		glGenTextures(1, &colorTex);
+		glBindTexture(GL_TEXTURE_2D, colorTex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTex, 0);
+
+		glGenRenderbuffers(1, &depthRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cerr << "[Error] Framebuffer " << width << "x" << height << " is not complete." << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		g_memoryRegistry.set("Render targets", m_name, MemoryRegistry::Location_Gpu, size_t(width) * height * (4 + 4));
+		return true;
+	}
+
+	// Binds for drawing and sets the viewport and scissor to the whole target
+	void bind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glViewport(0, 0, width, height);
+		glScissor(0, 0, width, height);
+		++g_drawStats.stateChanges;
+	}
+
+	// Binds for drawing into the lower-left w x h region only, for reduced-resolution passes
+	void bind(int w, int h) const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glViewport(0, 0, w, h);
+		glScissor(0, 0, w, h);
+		++g_drawStats.stateChanges;
+	}
+
+	void unbind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		++g_drawStats.stateChanges;
+	}
+
+	// Copies the color attachment into a rectangle of the default framebuffer
+	void blitTo(int x, int y, int w, int h, GLenum filter = GL_NEAREST) const
+	{
+		blitRegionTo(width, height, x, y, w, h, filter);
+	}
+
+	// Copies the lower-left srcW x srcH region, scaling it with `filter` when sizes differ
+	void blitRegionTo(int srcW, int srcH, int x, int y, int w, int h, GLenum filter = GL_LINEAR) const
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, srcW, srcH, x, y, x + w, y + h, GL_COLOR_BUFFER_BIT, filter);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		g_drawStats.stateChanges += 2;
+		++g_drawStats.drawCalls;	// counted as one, it costs a full-pane copy
+	}
+
+	void release()
+	{
+		if (FBO == 0)
+			return;
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteTextures(1, &colorTex);
+		glDeleteRenderbuffers(1, &depthRBO);
+		FBO = colorTex = depthRBO = 0;
+		g_memoryRegistry.release("Render targets", m_name);
+	}
+
+	unsigned int FBO = 0;
+	unsigned int colorTex = 0;
+	unsigned int depthRBO = 0;
+	int width = 0;
+	int height = 0;
+
+private:
+	std::string m_name;
+};
+
+
+#endif // FRAMEBUFFER_H
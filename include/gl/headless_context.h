@@ -0,0 +1,102 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <glad/glad.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "gl/program_cache.h"
+
+#include <cstring>
+#include <iostream>
+
+
+// OpenGL 3.3 core context without a window or surface, for batch rendering into framebuffers.
+// Prefers Mesa's surfaceless platform, which needs neither a display server nor a GPU
+// (llvmpipe), and falls back to the default EGL display.
+class HeadlessContext
+{
+public:
+	HeadlessContext() = default;
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	~HeadlessContext()
+	{
+		destroy();
+	}
+
+	// Creates the context, makes it current on the calling thread and loads the GL functions
+	bool create()
+	{
+		const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay && extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless"))
+			m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (m_display == EGL_NO_DISPLAY)
+			m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+		EGLint major, minor;
+		if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, &major, &minor))
+		{
+			std::cerr << "[Error] Failed to initialize EGL." << std::endl;
+			return false;
+		}
+		std::cout << "EGL " << major << "." << minor << " (" << eglQueryString(m_display, EGL_VENDOR) << ")" << std::endl;
+
+		const EGLint configAttribs[] = {
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_SURFACE_TYPE, 0,	// surfaceless, everything goes to framebuffer objects
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint nConfigs = 0;
+		if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(m_display, configAttribs, &config, 1, &nConfigs) || nConfigs == 0)
+		{
+			std::cerr << "[Error] No EGL config for desktop OpenGL." << std::endl;
+			return false;
+		}
+
+		const EGLint contextAttribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, contextAttribs);
+		if (m_context == EGL_NO_CONTEXT || !eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+		{
+			std::cerr << "[Error] Failed to create a surfaceless OpenGL 3.3 context." << std::endl;
+			return false;
+		}
+
+		if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+		{
+			std::cerr << "[Error] Failed to initialize GLAD." << std::endl;
+			return false;
+		}
+		g_programCache.loadEntryPoints((GLADloadproc)eglGetProcAddress);
+		std::cout << "Headless renderer: " << glGetString(GL_RENDERER) << std::endl;
+		return true;
+	}
+
+	void destroy()
+	{
+		if (m_display == EGL_NO_DISPLAY)
+			return;
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (m_context != EGL_NO_CONTEXT)
+			eglDestroyContext(m_display, m_context);
+		eglTerminate(m_display);
+		m_display = EGL_NO_DISPLAY;
+		m_context = EGL_NO_CONTEXT;
+	}
+
+private:
+	EGLDisplay m_display = EGL_NO_DISPLAY;
+	EGLContext m_context = EGL_NO_CONTEXT;
+};
+
+
+#endif // HEADLESS_CONTEXT_H
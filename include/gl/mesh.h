@@ -7,44 +7,211 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <gl/shader.h>
+#include "core/mesh_data.h"
+#include "gl/draw_stats.h"
+#include "memory_registry.h"
+#include "utils/mesh_simplify.h"
+#include "utils/meshlet_utils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
 #include <string>
 #include <vector>
 using namespace std;
 
 
-class Vertex {
-public:
-	glm::vec3 position_;
-	glm::vec3 normal_;
-	glm::vec4 color_;
+// GPU-side vertex, 16 bytes instead of the 40 of Vertex; decoded in model.vs
+struct PackedVertex {
+	uint16_t position_[4];	// unorm, relative to the mesh bounds (w is padding)
+	int16_t normal_[2];		// snorm, octahedral encoding
+	uint8_t color_[4];		// unorm RGBA8
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay tightly packed");
+
+
+// A range of the element buffer holding one level of detail
+struct MeshLod {
+	size_t indexOffset;		// in indices
+	unsigned int indexCount;
+	float error;			// max deviation from the full mesh, in model units
 };
 
 
-class Mesh {
+class Mesh : public MeshData {
 public:
-	// mesh Data
-	vector<Vertex> vertices;
-	vector<unsigned int> indices;
 	unsigned int VAO;
+	string label = "mesh";	// names the buffers in the memory registry
+
+	// levels of detail, lods[0] is the full mesh; coarser levels appear once uploaded
+	vector<MeshLod> lods;
+	// clusters of lods[0] for CPU culling, empty until uploaded
+	vector<mesh_utils::Meshlet> meshlets;
+	glm::vec3 center = glm::vec3(0.f);
+	float radius = 0.f;
 
 	// constructor
 	Mesh(vector<Vertex> vertices, vector<unsigned int> indices)
 	{
-		this->vertices = vertices;
-		this->indices = indices;
+		this->vertices = std::move(vertices);
+		this->indices = std::move(indices);
 
 		// now that we have all the required data, set the vertex buffers and its attribute pointers.
 		// setupMesh();
 	}
 
+	explicit Mesh(MeshData &&data) : MeshData(std::move(data)) { }
+
 	// render the mesh
 	void Draw(Shader &shader) const
 	{
 		// draw mesh
+		setBoundsUniforms(shader);
 		glBindVertexArray(VAO);
 		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
 		glBindVertexArray(0);
+		++g_drawStats.stateChanges;
+		++g_drawStats.drawCalls;
+	}
+
+	// render the coarsest level whose error projects to at most `maxPixelError` pixels;
+	// the full level is culled per meshlet and submitted as one multi-draw
+	void Draw(Shader &shader, const glm::mat4 &proj, const glm::mat4 &view, float viewportHeight, float maxPixelError) const
+	{
+		glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+		size_t iLod = selectLod(proj, eye, viewportHeight, maxPixelError);
+		setBoundsUniforms(shader);
+		glBindVertexArray(VAO);
+		++g_drawStats.stateChanges;
+		if (iLod == 0 && !meshlets.empty())
+		{
+			glm::vec4 planes[6];
+			mesh_utils::extractFrustumPlanes(proj * view, planes);
+
+			// Adjacent visible meshlets merge into one range
+			m_aDrawCounts.clear();
+			m_aDrawOffsets.clear();
+			size_t rangeEnd = SIZE_MAX;
+			for (const auto &m : meshlets)
+			{
+				if (mesh_utils::cullMeshlet(m, planes, eye))
+					continue;
+				if (m.indexOffset == rangeEnd)
+					m_aDrawCounts.back() += m.indexCount;
+				else
+				{
+					m_aDrawCounts.push_back(m.indexCount);
+					m_aDrawOffsets.push_back((const void*)(size_t(m.indexOffset) * sizeof(unsigned int)));
+				}
+				rangeEnd = m.indexOffset + m.indexCount;
+			}
+			if (!m_aDrawCounts.empty())
+			{
+				glMultiDrawElements(GL_TRIANGLES, &m_aDrawCounts[0], GL_UNSIGNED_INT, &m_aDrawOffsets[0], m_aDrawCounts.size());
+				++g_drawStats.drawCalls;
+			}
+		}
+		else
+		{
+			const MeshLod &lod = lods[iLod];
+			glDrawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT, (void*)(lod.indexOffset * sizeof(unsigned int)));
+			++g_drawStats.drawCalls;
+		}
+		glBindVertexArray(0);
+	}
+
+	size_t selectLod(const glm::mat4 &proj, const glm::vec3 &eye, float viewportHeight, float maxPixelError) const
+	{
+		float dist = std::max(glm::length(eye - center) - radius, 1e-3f);
+		float pixelsPerUnit = proj[1][1] * 0.5f * viewportHeight / dist;
+
+		size_t iLod = 0;
+		while (iLod + 1 < lods.size() && lods[iLod + 1].error * pixelsPerUnit <= maxPixelError)
+			++iLod;
+		return iLod;
+	}
+
+	// splits the full level into meshlets; CPU only, safe to run on a worker thread
+	void buildMeshlets()
+	{
+		m_aPendingMeshlets.clear();
+		m_aMeshletIndices = indices;
+		if (indices.empty())
+			return;
+		g_memoryRegistry.set("Staging", label + " meshlet indices", MemoryRegistry::Location_Host, 
+			m_aMeshletIndices.capacity() * sizeof(unsigned int));
+		m_aPendingMeshlets = mesh_utils::buildMeshlets(&vertices[0].position_.x, vertices.size(), sizeof(Vertex), m_aMeshletIndices);
+
+		// Cones follow the winding; flip them if it disagrees with the vertex normals
+		double orientation = 0.0;
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			const Vertex &v0 = vertices[indices[t]], &v1 = vertices[indices[t + 1]], &v2 = vertices[indices[t + 2]];
+			glm::vec3 n = glm::cross(v1.position_ - v0.position_, v2.position_ - v0.position_);
+			orientation += glm::dot(n, v0.normal_ + v1.normal_ + v2.normal_);
+		}
+		if (orientation < 0.0)
+		{
+			for (auto &m : m_aPendingMeshlets)
+				m.coneAxis = -m.coneAxis;
+		}
+	}
+
+	// simplifies the mesh into a chain of LODs; CPU only, safe to run on a worker thread
+	void buildLods()
+	{
+		const size_t MIN_LOD_INDICES = 3 * 2048;
+		m_aPendingLods.clear();
+		m_aPendingIndices.clear();
+		if (indices.empty())
+			return;
+
+		vector<size_t> targets;
+		for (size_t n = indices.size() / 2; n >= MIN_LOD_INDICES; n /= 2)
+			targets.push_back(n);
+
+		// the full level is stored in meshlet order when buildMeshlets() ran first
+		m_aPendingIndices = m_aMeshletIndices.empty() ? indices : std::move(m_aMeshletIndices);
+		m_aMeshletIndices.clear();
+		for (auto &level : mesh_utils::simplify(&vertices[0].position_.x, vertices.size(), sizeof(Vertex), m_aPendingIndices, targets))
+		{
+			m_aPendingLods.push_back({ m_aPendingIndices.size(), static_cast<unsigned int>(level.indices.size()), level.error });
+			m_aPendingIndices.insert(m_aPendingIndices.end(), level.indices.begin(), level.indices.end());
+		}
+		g_memoryRegistry.release("Staging", label + " meshlet indices");
+		g_memoryRegistry.set("Staging", label + " LOD indices", MemoryRegistry::Location_Host, 
+			m_aPendingIndices.capacity() * sizeof(unsigned int));
+	}
+
+	// uploads the levels produced by buildLods(); must run on the GL thread
+	void uploadLods()
+	{
+		if (m_aPendingIndices.empty())
+			return;
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_aPendingIndices.size() * sizeof(unsigned int), &m_aPendingIndices[0], GL_STATIC_DRAW);
+		glBindVertexArray(0);
+
+		lods.resize(1);
+		lods.insert(lods.end(), m_aPendingLods.begin(), m_aPendingLods.end());
+		meshlets.swap(m_aPendingMeshlets);
+		m_aPendingMeshlets.clear();
+		std::cout << "Mesh meshlets: " << meshlets.size() << ", LODs (triangles):";
+		for (auto &lod : lods)
+			std::cout << " " << lod.indexCount / 3;
+		std::cout << std::endl;
+
+		g_memoryRegistry.set("Meshes", label + " EBO", MemoryRegistry::Location_Gpu, m_aPendingIndices.size() * sizeof(unsigned int));
+		g_memoryRegistry.set("Meshes", label + " meshlets", MemoryRegistry::Location_Host, 
+			meshlets.capacity() * sizeof(mesh_utils::Meshlet));
+
+		vector<unsigned int>().swap(m_aPendingIndices);
+		m_aPendingLods.clear();
+		g_memoryRegistry.release("Staging", label + " LOD indices");
 	}
 
 public:
@@ -54,31 +221,115 @@ public:
 	// initializes all the buffer objects/arrays
 	void setupMesh()
 	{
+		// bounding sphere for LOD selection
+		glm::vec3 bbMin(std::numeric_limits<float>::max()), bbMax(-std::numeric_limits<float>::max());
+		for (auto &v : vertices)
+		{
+			bbMin = glm::min(bbMin, v.position_);
+			bbMax = glm::max(bbMax, v.position_);
+		}
+		center = (bbMin + bbMax) * 0.5f;
+		radius = 0.f;
+		for (auto &v : vertices)
+			radius = std::max(radius, glm::length(v.position_ - center));
+		lods = { { 0, static_cast<unsigned int>(indices.size()), 0.f } };
+
+		// quantization box of the packed positions
+		m_boundsMin = bbMin;
+		m_boundsExtent = glm::max(bbMax - bbMin, glm::vec3(1e-6f));
+
 		// create buffers/arrays
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
 		glGenBuffers(1, &EBO);
 
 		glBindVertexArray(VAO);
-		// load data into vertex buffers
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		// A great thing about structs is that their memory layout is sequential for all its items.
-		// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-		// again translates to 3/2 floats which translates to a byte array.
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+		uploadVertices();
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
-		// set the vertex attribute pointers
+		// CPU copies stay alive: LOD, meshlet and later passes read them
+		g_memoryRegistry.set("Meshes", label + " vertices", MemoryRegistry::Location_Host, vertices.capacity() * sizeof(Vertex));
+		g_memoryRegistry.set("Meshes", label + " indices", MemoryRegistry::Location_Host, indices.capacity() * sizeof(unsigned int));
+		g_memoryRegistry.set("Meshes", label + " EBO", MemoryRegistry::Location_Gpu, indices.size() * sizeof(unsigned int));
+
+		// set the vertex attribute pointers, all normalized integer formats
 		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position_));
 		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal_));
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal_));
 		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color_));
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, color_));
 
 		glBindVertexArray(0);
 	}
+
+	// deletes the GL objects created by setupMesh(); must run on the GL thread
+	void releaseBuffers()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		VAO = VBO = EBO = 0;
+		for (const char *buffer : { " vertices", " indices", " VBO", " EBO", " meshlets" })
+			g_memoryRegistry.release("Meshes", label + buffer);
+	}
+
+	// packs `vertices` and (re)fills the vertex buffer; must run on the GL thread
+	void uploadVertices()
+	{
+		vector<PackedVertex> packed(vertices.size());
+		glm::vec3 invExtent = glm::vec3(1.f) / m_boundsExtent;
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			const Vertex &v = vertices[i];
+			PackedVertex &p = packed[i];
+
+			glm::vec3 q = glm::clamp((v.position_ - m_boundsMin) * invExtent, 0.f, 1.f);
+			for (int k = 0; k < 3; ++k)
+				p.position_[k] = static_cast<uint16_t>(std::lround(q[k] * 65535.f));
+			p.position_[3] = 0;
+
+			// octahedral: project onto |x| + |y| + |z| = 1 and fold the lower hemisphere
+			glm::vec3 n = v.normal_ / std::max(std::abs(v.normal_.x) + std::abs(v.normal_.y) + std::abs(v.normal_.z), 1e-20f);
+			float ox = n.x, oy = n.y;
+			if (n.z < 0.f)
+			{
+				ox = (1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f);
+				oy = (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f);
+			}
+			p.normal_[0] = static_cast<int16_t>(std::lround(glm::clamp(ox, -1.f, 1.f) * 32767.f));
+			p.normal_[1] = static_cast<int16_t>(std::lround(glm::clamp(oy, -1.f, 1.f) * 32767.f));
+
+			for (int k = 0; k < 4; ++k)
+				p.color_[k] = static_cast<uint8_t>(std::lround(glm::clamp(v.color_[k], 0.f, 1.f) * 255.f));
+		}
+
+		g_memoryRegistry.set("Staging", label + " packed vertices", MemoryRegistry::Location_Host, packed.size() * sizeof(PackedVertex));
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.empty() ? nullptr : &packed[0], GL_STATIC_DRAW);
+		g_memoryRegistry.set("Meshes", label + " VBO", MemoryRegistry::Location_Gpu, packed.size() * sizeof(PackedVertex));
+		g_memoryRegistry.release("Staging", label + " packed vertices");
+	}
+
+private:
+	void setBoundsUniforms(const Shader &shader) const
+	{
+		shader.setVec3("BoundsMin", m_boundsMin);
+		shader.setVec3("BoundsExtent", m_boundsExtent);
+	}
+
+	glm::vec3 m_boundsMin = glm::vec3(0.f);
+	glm::vec3 m_boundsExtent = glm::vec3(1.f);
+
+	vector<unsigned int> m_aPendingIndices;	// full mesh followed by every LOD
+	vector<MeshLod> m_aPendingLods;
+	vector<unsigned int> m_aMeshletIndices;	// full level in meshlet order
+	vector<mesh_utils::Meshlet> m_aPendingMeshlets;
+
+	// per-frame multi-draw ranges, kept to avoid reallocating
+	mutable vector<GLsizei> m_aDrawCounts;
+	mutable vector<const void*> m_aDrawOffsets;
 };
 #endif
\ No newline at end of file
@@ -6,14 +6,18 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-
+#include "core/mesh_io.h"
 #include "gl/mesh.h"
 #include "gl/shader.h"
+#include "utils/task_scheduler.h"
+#include "utils/trace.h"
 
 #include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <future>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -37,6 +41,17 @@ public:
 		loadModel(path);
 	}
 
+	// drops LOD builds that have not started and waits for the running ones, which hold the meshes
+	~Model()
+	{
+		m_lodCancel.cancel();
+		for (auto &task : m_aLodTasks)
+		{
+			if (task.valid())
+				task.wait();
+		}
+	}
+
 	// draws the model, and thus all its meshes
 	void Draw(Shader &shader) const
 	{
@@ -44,96 +59,73 @@ public:
 			meshes[i].Draw(shader);
 	}
 
-	void setup() 
+	// draws each mesh at the level of detail matching its projected size in the viewport
+	void Draw(Shader &shader, const glm::mat4 &proj, const glm::mat4 &view, float viewportHeight, float maxPixelError = 1.f) const
 	{
 		for (unsigned int i = 0; i < meshes.size(); i++)
-			meshes[i].setupMesh();
+			meshes[i].Draw(shader, proj, view, viewportHeight, maxPixelError);
 	}
 
-	// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-	void loadModel(string const &path)
+	// starts building the meshlets and LOD chains of all meshes as background tasks
+	void generateLods()
 	{
-		// read file via ASSIMP
-		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenNormals);
-		// check for errors
-		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+		for (unsigned int i = 0; i < meshes.size(); i++)
 		{
-			cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-			return;
+			Mesh *pMesh = &meshes[i];
+			m_aLodTasks.push_back(utils::scheduler().submit([pMesh]() {
+				TRACE_SCOPE("Build meshlets and LODs");
+				pMesh->buildMeshlets();
+				pMesh->buildLods();
+			}, utils::TaskPriority_Background, m_lodCancel));
 		}
-		// retrieve the directory path of the filepath
-		directory = path.substr(0, path.find_last_of('/'));
-
-		// process ASSIMP's root node recursively
-		processNode(scene->mRootNode, scene);
 	}
 
-private:
-	// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-	void processNode(aiNode *node, const aiScene *scene)
+	// uploads meshlets and LOD chains that finished building; returns true if any mesh changed
+	bool pollLods()
 	{
-		// process each mesh located at the current node
-		for (unsigned int i = 0; i < node->mNumMeshes; i++)
-		{
-			// the node object only contains indices to index the actual objects in the scene. 
-			// the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			meshes.push_back(processMesh(mesh, scene));
-		}
-		// after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-		for (unsigned int i = 0; i < node->mNumChildren; i++)
+		bool bChanged = false;
+		for (unsigned int i = 0; i < m_aLodTasks.size(); i++)
 		{
-			processNode(node->mChildren[i], scene);
+			if (!m_aLodTasks[i].valid() || 
+				m_aLodTasks[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				continue;
+			m_aLodTasks[i].get();
+			TRACE_SCOPE("Upload LODs");
+			meshes[i].uploadLods();
+			bChanged = true;
 		}
-
+		return bChanged;
 	}
 
-	Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+	void setup() 
 	{
-		// data to fill
-		vector<Vertex> vertices;
-		vector<unsigned int> indices;
-
-		// walk through each of the mesh's vertices
-		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
-		{
-			Vertex vertex;
-			glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-			// positions
-			vector.x = mesh->mVertices[i].x;
-			vector.y = mesh->mVertices[i].y;
-			vector.z = mesh->mVertices[i].z;
-			vertex.position_ = vector;
-			// normals
-			vector.x = mesh->mNormals[i].x;
-			vector.y = mesh->mNormals[i].y;
-			vector.z = mesh->mNormals[i].z;
-			vertex.normal_ = vector;
-
-			glm::vec4 color(1.f, 1.f, 1.f, 1.f);
-			color.x = mesh->mColors[0][i].r;
-			color.y = mesh->mColors[0][i].g;
-			color.z = mesh->mColors[0][i].b;
-			// color.w = mesh->mColors[0][i].a;
-			//std::cout << color.x << " " << color.y << " " << color.z << " " << color.w << std::endl;
-			vertex.color_ = color;
-
-			vertices.push_back(vertex);
-		}
-		// now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+		for (unsigned int i = 0; i < meshes.size(); i++)
 		{
-			aiFace face = mesh->mFaces[i];
-			// retrieve all indices of the face and store them in the indices vector
-			for (unsigned int j = 0; j < face.mNumIndices; j++)
-				indices.push_back(face.mIndices[j]);
+			meshes[i].label = "mesh " + to_string(i);
+			meshes[i].setupMesh();
 		}
+	}
 
-		// return a mesh object created from the extracted mesh data
-		return Mesh(vertices, indices);
+	// deletes the GL objects of every mesh; must run on the GL thread
+	void release()
+	{
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			meshes[i].releaseBuffers();
 	}
 
+	// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+	void loadModel(string const &path)
+	{
+		TRACE_SCOPE("Model::loadModel");
+		for (auto &data : mesh_io::loadMeshes(path))
+			meshes.emplace_back(std::move(data));
+		// retrieve the directory path of the filepath
+		directory = path.substr(0, path.find_last_of('/'));
+	}
+
+private:
+	vector<std::future<void>> m_aLodTasks;	// one per mesh, in the same order
+	utils::CancelToken m_lodCancel = utils::CancelToken::create();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,190 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// from ARB_get_program_binary, core since 4.1; the loader may be generated without them
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+
+// Linked programs saved with glGetProgramBinary and restored with glProgramBinary on the next
+// start, which skips compiling and linking; that is most of the startup on software GL. Entries
+// are keyed by the driver strings and the shader sources, so an edited shader or an updated
+// driver misses and is rebuilt, and a binary the driver still rejects falls back the same way.
+class ProgramCache
+{
+public:
+	// Where binaries go, created on first save; empty keeps the cache off
+	void setDirectory(const std::string &dir) { m_dir = dir; }
+
+	// Resolves the binary entry points through the GL loader; call once the context is current.
+	// The cache stays off if the driver offers no binary format
+	void loadEntryPoints(GLADloadproc load)
+	{
+		m_getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(load("glGetProgramBinary"));
+		m_programBinary = reinterpret_cast<ProgramBinaryProc>(load("glProgramBinary"));
+		m_programParameteri = reinterpret_cast<ProgramParameteriProc>(load("glProgramParameteri"));
+		GLint nFormats = 0;
+		if (m_getProgramBinary && m_programBinary && m_programParameteri)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats);
+		while (glGetError() != GL_NO_ERROR)
+			;	// GL_INVALID_ENUM where the extension is missing
+		m_bSupported = nFormats > 0;
+		m_driver.clear();
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+		{
+			const GLubyte *s = glGetString(name);
+			m_driver += s ? reinterpret_cast<const char*>(s) : "";
+			m_driver += '\n';
+		}
+	}
+
+	bool enabled() const { return m_bSupported && !m_dir.empty(); }
+
+	// FNV-1a of the driver and the sources, which are given in stage order
+	uint64_t key(const std::vector<std::string> &aSources) const
+	{
+		uint64_t h = 14695981039346656037ull;
+		auto add = [&h](const std::string &s) {
+			for (unsigned char c : s)
+				h = (h ^ c) * 1099511628211ull;
+			h = (h ^ 0xff) * 1099511628211ull;	// separator, so moving text between stages changes the key
+		};
+		add(m_driver);
+		for (const std::string &source : aSources)
+			add(source);
+		return h;
+	}
+
+	// Asks the driver to keep the binary of `program` retrievable; call before linking
+	void prepare(GLuint program) const
+	{
+		if (enabled())
+			m_programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// Links `program` from the binary cached under `key`; false if there is none or it is rejected
+	bool load(GLuint program, uint64_t key)
+	{
+		if (!enabled())
+			return false;
+		std::ifstream in(path(key), std::ios::binary | std::ios::ate);
+		if (!in)
+			return false;
+		uint64_t fileSize = uint64_t(in.tellg());
+		in.seekg(0);
+		Header header;
+		in.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!in || memcmp(header.magic, k_magic, sizeof(header.magic)) != 0 || header.version != k_version || header.key != key)
+			return false;
+		if (header.length != fileSize - sizeof(header))
+			return false;	// truncated or corrupt, and never allocate what the file cannot hold
+		std::vector<char> binary(header.length);
+		in.read(binary.data(), binary.size());
+		if (!in)
+			return false;
+		m_programBinary(program, header.format, binary.data(), GLsizei(binary.size()));
+		GLint bLinked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &bLinked);
+		m_nHits += bLinked == GL_TRUE;
+		return bLinked == GL_TRUE;
+	}
+
+	// Caches the binary of the linked `program` under `key`
+	void save(GLuint program, uint64_t key)
+	{
+		if (!enabled())
+			return;
+		++m_nMisses;
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+		std::vector<char> binary(length);
+		Header header = { {}, k_version, 0, key, 0 };
+		memcpy(header.magic, k_magic, sizeof(header.magic));
+		GLsizei written = 0;
+		m_getProgramBinary(program, length, &written, &header.format, binary.data());
+		header.length = uint64_t(written);
+
+		// written aside under a name of this process and renamed over, so another instance never
+		// reads half a file nor writes into the same temporary
+		std::error_code ec;
+		std::filesystem::create_directories(m_dir, ec);
+		std::string target = path(key), temp = target + "." + std::to_string(getpid()) + ".tmp";
+		bool bWritten;
+		{
+			std::ofstream out(temp, std::ios::binary);
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(binary.data(), written);
+			bWritten = bool(out);
+		}
+		if (bWritten)
+			std::filesystem::rename(temp, target, ec);
+		if (!bWritten || ec)
+		{
+			std::cout << "Could not cache a shader binary in " << m_dir << (ec ? ": " + ec.message() : "") << std::endl;
+			std::filesystem::remove(temp, ec);
+		}
+	}
+
+	// programs restored from the cache, and built and then cached, since the start
+	unsigned int hits() const { return m_nHits; }
+	unsigned int misses() const { return m_nMisses; }
+
+private:
+	typedef void (APIENTRYP GetProgramBinaryProc)(GLuint, GLsizei, GLsizei*, GLenum*, void*);
+	typedef void (APIENTRYP ProgramBinaryProc)(GLuint, GLenum, const void*, GLsizei);
+	typedef void (APIENTRYP ProgramParameteriProc)(GLuint, GLenum, GLint);
+
+	// bump k_version when the layout changes
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		GLenum format;
+		uint64_t key;
+		uint64_t length;
+	};
+	static constexpr char k_magic[8] = { 'F', 'M', 'V', 'P', 'R', 'O', 'G', '\0' };
+	static constexpr uint32_t k_version = 1;
+
+	std::string path(uint64_t key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+		return (std::filesystem::path(m_dir) / name).string();
+	}
+
+	std::string m_dir;
+	std::string m_driver;
+	bool m_bSupported = false;
+	GetProgramBinaryProc m_getProgramBinary = nullptr;
+	ProgramBinaryProc m_programBinary = nullptr;
+	ProgramParameteriProc m_programParameteri = nullptr;
+	unsigned int m_nHits = 0, m_nMisses = 0;
+};
+
+inline ProgramCache g_programCache;
+
+
+#endif // PROGRAM_CACHE_H
@@ -5,14 +5,44 @@
 #include <GLFW/glfw3.h>
 
 #include "gl/shader.h"
+#include "gl/draw_stats.h"
 #include "config.h"
 
 #include <string>
+#include <vector>
 
 
 class RenderManager
 {
 public:
+	// Quad corners per rotation: a strip of 4 unrotated, then 6 CW and 6 CCW as triangles
+	static constexpr float k_aQuadVertices[] = {
+		// Positions        Texture coords
+		// No rotation
+		-1.0f,  1.0f, 1.0f, 0.0f, 0.0f,
+		-1.0f, -1.0f, 1.0f, 0.0f, 1.0f,
+		 1.0f,  1.0f, 1.0f, 1.0f, 0.0f,
+		 1.0f, -1.0f, 1.0f, 1.0f, 1.0f,
+		
+		 // CW
+		-1.0f,  1.0f, 1.0f, 0.0f, 0.0f,
+		-1.0f, -1.0f, 1.0f, 1.0f, 0.0f,
+		 1.0f,  1.0f, 1.0f, 0.0f, 1.0f,
+
+		-1.0f, -1.0f, 1.0f, 1.0f, 0.0f,
+		 1.0f, -1.0f, 1.0f, 1.0f, 1.0f,
+		 1.0f,  1.0f, 1.0f, 0.0f, 1.0f,
+
+		 // CCW
+		-1.0f,  1.0f, 1.0f, 1.0f, 0.0f,
+		-1.0f, -1.0f, 1.0f, 0.0f, 0.0f,
+		 1.0f,  1.0f, 1.0f, 1.0f, 1.0f,				 
+
+		-1.0f, -1.0f, 1.0f, 0.0f, 0.0f,
+		 1.0f, -1.0f, 1.0f, 0.0f, 1.0f,
+		 1.0f,  1.0f, 1.0f, 1.0f, 1.0f,				 
+	};
+
 	void RenderCube()
 	{
 		if (cubeVAO == 0)
@@ -80,6 +110,8 @@ public:
 		glBindVertexArray(cubeVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
 		glBindVertexArray(0);
+		++g_drawStats.stateChanges;
+		++g_drawStats.drawCalls;
 	}
 
 
@@ -87,39 +119,12 @@ public:
 	{
 		if (quadVAO == 0)
 		{
-			float quadVertices[] = {
-				// Positions        Texture coords
-				// No rotation
-				-1.0f,  1.0f, 1.0f, 0.0f, 0.0f,
-				-1.0f, -1.0f, 1.0f, 0.0f, 1.0f,
-				 1.0f,  1.0f, 1.0f, 1.0f, 0.0f,
-				 1.0f, -1.0f, 1.0f, 1.0f, 1.0f,
-				
-				 // CW
-				-1.0f,  1.0f, 1.0f, 0.0f, 0.0f,
-				-1.0f, -1.0f, 1.0f, 1.0f, 0.0f,
-				 1.0f,  1.0f, 1.0f, 0.0f, 1.0f,
-
-				-1.0f, -1.0f, 1.0f, 1.0f, 0.0f,
-				 1.0f, -1.0f, 1.0f, 1.0f, 1.0f,
-				 1.0f,  1.0f, 1.0f, 0.0f, 1.0f,
-
-				 // CCW
-				-1.0f,  1.0f, 1.0f, 1.0f, 0.0f,
-				-1.0f, -1.0f, 1.0f, 0.0f, 0.0f,
-				 1.0f,  1.0f, 1.0f, 1.0f, 1.0f,				 
-
-				-1.0f, -1.0f, 1.0f, 0.0f, 0.0f,
-				 1.0f, -1.0f, 1.0f, 0.0f, 1.0f,
-				 1.0f,  1.0f, 1.0f, 1.0f, 1.0f,				 
-			};
-
 			// setup plane VAO
 			glGenVertexArrays(1, &quadVAO);
 			glGenBuffers(1, &quadVBO);
 			glBindVertexArray(quadVAO);
 			glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(k_aQuadVertices), k_aQuadVertices, GL_STATIC_DRAW);
 			glEnableVertexAttribArray(0);
 			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
 			glEnableVertexAttribArray(1);
@@ -133,6 +138,8 @@ public:
 		else if(rotateType == RotateType_CCW)
 			glDrawArrays(GL_TRIANGLES, 10, 6);
 		glBindVertexArray(0);
+		++g_drawStats.stateChanges;
+		++g_drawStats.drawCalls;
 	}
 
 
@@ -158,6 +165,8 @@ public:
 		glBindVertexArray(pointsVAO);
 		glDrawArrays(GL_POINTS, 0, size);
 		glBindVertexArray(0);
+		++g_drawStats.stateChanges;
+		++g_drawStats.drawCalls;
 	}
 
 
@@ -179,6 +188,40 @@ public:
 		glLineWidth(1.5f);
 		glDrawArrays(GL_LINES, 0, 2);
 		glBindVertexArray(0);
+		++g_drawStats.stateChanges;
+		++g_drawStats.drawCalls;
+	}
+
+	// Draws `aPoints` (x0, y0, x1, y1, ...) as GL_LINES in one call; the buffer grows as needed
+	void RenderLines(const std::vector<float> &aPoints)
+	{
+		if (aPoints.empty())
+			return;
+		if (linesVAO == 0)
+		{
+			glGenVertexArrays(1, &linesVAO);
+			glGenBuffers(1, &linesVBO);
+			glBindVertexArray(linesVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, linesVBO);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, linesVBO);
+		if (aPoints.size() > linesCapacity)
+		{
+			linesCapacity = aPoints.size();
+			glBufferData(GL_ARRAY_BUFFER, linesCapacity * sizeof(float), aPoints.data(), GL_DYNAMIC_DRAW);
+		}
+		else
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, 0, aPoints.size() * sizeof(float), aPoints.data());
+		}
+		glBindVertexArray(linesVAO);
+		glLineWidth(1.5f);
+		glDrawArrays(GL_LINES, 0, GLsizei(aPoints.size() / 2));
+		glBindVertexArray(0);
+		++g_drawStats.stateChanges;
+		++g_drawStats.drawCalls;
 	}
 	
 	/* Vertex Object */
@@ -190,6 +233,9 @@ public:
 	unsigned int pointsVBO;
 	unsigned int lineVAO = 0;
 	unsigned int lineVBO;
+	unsigned int linesVAO = 0;
+	unsigned int linesVBO;
+	size_t linesCapacity = 0;
 };
 
 #endif
@@ -6,10 +6,15 @@
 
 #include "Eigen/Core"
 
+#include "gl/draw_stats.h"
+#include "gl/program_cache.h"
+
+#include <cstdint>
+#include <filesystem>
 #include <string>
 #include <fstream>
-#include <sstream>
 #include <iostream>
+#include <vector>
 
 
 class Shader
@@ -17,94 +22,50 @@ class Shader
 public:
 	unsigned int ID;
 	
-	// constructor generates the shader on the fly
+	// constructor generates the shader on the fly, from the program cache when it holds the same sources
 	// ------------------------------------------------------------------------
-	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
-	{
-		// 1. retrieve the vertex/fragment source code from filePath
-		std::string vertexCode;
-		std::string fragmentCode;
-		std::string geometryCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		std::ifstream gShaderFile;
-		// ensure ifstream objects can throw exceptions:
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try
-		{
-			// open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// read file's buffer contents into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-			// convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-			// if geometry shader path is present, also load a geometry shader
-			if (geometryPath != nullptr)
-			{
-				gShaderFile.open(geometryPath);
-				std::stringstream gShaderStream;
-				gShaderStream << gShaderFile.rdbuf();
-				gShaderFile.close();
-				geometryCode = gShaderStream.str();
-			}
-		}
-		catch (std::ifstream::failure& e)
+	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) :
+		m_vertexPath(vertexPath),
+		m_fragmentPath(fragmentPath),
+		m_geometryPath(geometryPath ? geometryPath : "")
+	{
+		build(ID, true);
+	}
+	// rebuilds the program from the files and swaps it in, keeping the current one (and its
+	// uniform values, which a new program does not have) if anything fails; true if swapped
+	// ------------------------------------------------------------------------
+	bool reload()
+	{
+		unsigned int program;
+		// not cached: every save while editing would leave a binary behind, the next start
+		// caches the sources as they end up
+		if (!build(program, false))
 		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+			glDeleteProgram(program);
+			return false;
 		}
-		const char* vShaderCode = vertexCode.c_str();
-		const char * fShaderCode = fragmentCode.c_str();
-		// 2. compile shaders
-		unsigned int vertex, fragment;
-		// vertex shader
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
-		checkCompileErrors(vertex, "VERTEX");
-		// fragment Shader
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
-		checkCompileErrors(fragment, "FRAGMENT");
-		// if geometry shader is given, compile geometry shader
-		unsigned int geometry;
-		if (geometryPath != nullptr)
+		glDeleteProgram(ID);
+		ID = program;
+		std::cout << "Reloaded shader " << m_vertexPath << " + " << m_fragmentPath << std::endl;
+		return true;
+	}
+	// true if `path` is one of this program's source files
+	bool uses(const std::string &path) const
+	{
+		std::filesystem::path p = std::filesystem::path(path).lexically_normal();
+		for (const std::string *source : { &m_vertexPath, &m_fragmentPath, &m_geometryPath })
 		{
-			const char * gShaderCode = geometryCode.c_str();
-			geometry = glCreateShader(GL_GEOMETRY_SHADER);
-			glShaderSource(geometry, 1, &gShaderCode, NULL);
-			glCompileShader(geometry);
-			checkCompileErrors(geometry, "GEOMETRY");
+			if (!source->empty() && std::filesystem::path(*source).lexically_normal() == p)
+				return true;
 		}
-		// shader Program
-		ID = glCreateProgram();
-		glAttachShader(ID, vertex);
-		glAttachShader(ID, fragment);
-		if (geometryPath != nullptr)
-			glAttachShader(ID, geometry);
-		glLinkProgram(ID);
-		checkCompileErrors(ID, "PROGRAM");
-		// delete the shaders as they're linked into our program now and no longer necessery
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
-		if (geometryPath != nullptr)
-			glDeleteShader(geometry);
-
+		return false;
 	}
 	// activate the shader
 	// ------------------------------------------------------------------------
 	void use()
 	{
 		glUseProgram(ID);
+		++g_drawStats.stateChanges;
 	}
 	// utility uniform functions
 	// ------------------------------------------------------------------------
@@ -171,9 +132,69 @@ public:
 	}
 
 private:
+	std::string m_vertexPath;
+	std::string m_fragmentPath;
+	std::string m_geometryPath;		// empty without a geometry stage
+
+	// whole file into `code`, false if it cannot be read
+	static bool readFile(const std::string &path, std::string &code)
+	{
+		std::ifstream in(path, std::ios::binary | std::ios::ate);
+		if (!in)
+			return false;
+		code.resize(size_t(in.tellg()));
+		in.seekg(0);
+		in.read(&code[0], code.size());
+		return bool(in);
+	}
+
+	// links a new program into `program`, saving its binary to the program cache if `bCache`;
+	// false if a file was unreadable or a stage failed
+	bool build(unsigned int &program, bool bCache)
+	{
+		// 1. retrieve the source code from the files
+		std::vector<std::string> aSources(m_geometryPath.empty() ? 2 : 3);
+		bool bRead = readFile(m_vertexPath, aSources[0]) && readFile(m_fragmentPath, aSources[1]);
+		if (!m_geometryPath.empty())
+			bRead = bRead && readFile(m_geometryPath, aSources[2]);
+		if (!bRead)
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+
+		program = glCreateProgram();
+		uint64_t key = g_programCache.key(aSources);
+		if (bRead && g_programCache.load(program, key))
+			return true;
+
+		// 2. compile shaders
+		const GLenum aStages[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+		const char *aTypes[] = { "VERTEX", "FRAGMENT", "GEOMETRY" };
+		bool bOk = bRead;
+		std::vector<unsigned int> aShaders;
+		for (size_t i = 0; i < aSources.size(); ++i)
+		{
+			const char *code = aSources[i].c_str();
+			unsigned int shader = glCreateShader(aStages[i]);
+			glShaderSource(shader, 1, &code, NULL);
+			glCompileShader(shader);
+			bOk = checkCompileErrors(shader, aTypes[i]) && bOk;
+			glAttachShader(program, shader);
+			aShaders.push_back(shader);
+		}
+		// shader Program
+		g_programCache.prepare(program);
+		glLinkProgram(program);
+		bOk = checkCompileErrors(program, "PROGRAM") && bOk;
+		// delete the shaders as they're linked into our program now and no longer necessery
+		for (unsigned int shader : aShaders)
+			glDeleteShader(shader);
+		if (bOk && bCache)
+			g_programCache.save(program, key);
+		return bOk;
+	}
+
 	// utility function for checking shader compilation/linking errors.
 	// ------------------------------------------------------------------------
-	void checkCompileErrors(GLuint shader, std::string type)
+	bool checkCompileErrors(GLuint shader, std::string type)
 	{
 		GLint success;
 		GLchar infoLog[1024];
@@ -195,6 +216,7 @@ private:
 				std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
 			}
 		}
+		return success == GL_TRUE;
 	}
 };
 #endif
\ No newline at end of file
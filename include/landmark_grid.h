@@ -0,0 +1,122 @@
+#ifndef LANDMARK_GRID_H
+#define LANDMARK_GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+// Uniform 2D grid over the screen-space landmark positions of one view, used for CPU hit-testing.
+// Positions live in the [-extent, extent]^2 space of the landmark pane; points outside are kept
+// in the border cells, so queries stay correct, only slower.
+class LandmarkGrid
+{
+public:
+	static const int NO_LANDMARK = -1;
+
+	LandmarkGrid(float cellSize = 0.02f, float extent = 1.f) :
+		m_cellSize(cellSize),
+		m_extent(extent)
+	{
+		m_nCellsPerSide = std::max(1, static_cast<int>(std::ceil(2.f * extent / cellSize)));
+		m_aCells.resize(m_nCellsPerSide * m_nCellsPerSide);
+	}
+
+	// Drops every landmark and makes room for `nLandmarks` of them
+	void reset(int nLandmarks)
+	{
+		for (auto& cell : m_aCells)
+			cell.clear();
+		m_aPoints.assign(nLandmarks, Point());
+	}
+
+	// Inserts or moves landmark `i`, touching only the cells it leaves and enters
+	void update(int i, float x, float y)
+	{
+		Point& pt = m_aPoints[i];
+		int iCell = cellIndex(cellCoord(x), cellCoord(y));
+		if (pt.iCell != iCell)
+		{
+			if (pt.iCell >= 0)
+				eraseFromCell(pt.iCell, i);
+			m_aCells[iCell].push_back(i);
+			pt.iCell = iCell;
+		}
+		pt.x = x;
+		pt.y = y;
+	}
+
+	// Removes landmark `i`, e.g. when it is missing in the current view
+	void remove(int i)
+	{
+		Point& pt = m_aPoints[i];
+		if (pt.iCell >= 0)
+			eraseFromCell(pt.iCell, i);
+		pt.iCell = -1;
+	}
+
+	// Returns the landmark nearest to (x, y) inside the axis-aligned ellipse of radii (rx, ry),
+	// or NO_LANDMARK. Separate radii let callers express a pixel tolerance on a non-square pane.
+	int query(float x, float y, float rx, float ry) const
+	{
+		int cxMin = cellCoord(x - rx), cxMax = cellCoord(x + rx);
+		int cyMin = cellCoord(y - ry), cyMax = cellCoord(y + ry);
+		float invRx2 = 1.f / (rx * rx), invRy2 = 1.f / (ry * ry);
+
+		int iNearest = NO_LANDMARK;
+		float dNearest = 1.f;
+		for (int cy = cyMin; cy <= cyMax; ++cy)
+		{
+			for (int cx = cxMin; cx <= cxMax; ++cx)
+			{
+				for (int i : m_aCells[cellIndex(cx, cy)])
+				{
+					float dx = m_aPoints[i].x - x, dy = m_aPoints[i].y - y;
+					float d = dx * dx * invRx2 + dy * dy * invRy2;
+					if (d <= dNearest)
+					{
+						dNearest = d;
+						iNearest = i;
+					}
+				}
+			}
+		}
+		return iNearest;
+	}
+
+private:
+	struct Point
+	{
+		float x = 0.f;
+		float y = 0.f;
+		int iCell = -1;
+	};
+
+	int cellCoord(float v) const
+	{
+		int c = static_cast<int>(std::floor((v + m_extent) / m_cellSize));
+		return std::min(std::max(c, 0), m_nCellsPerSide - 1);
+	}
+
+	int cellIndex(int cx, int cy) const { return cy * m_nCellsPerSide + cx; }
+
+	void eraseFromCell(int iCell, int i)
+	{
+		auto& cell = m_aCells[iCell];
+		auto it = std::find(cell.begin(), cell.end(), i);
+		if (it != cell.end())
+		{
+			*it = cell.back();
+			cell.pop_back();
+		}
+	}
+
+	float m_cellSize;
+	float m_extent;
+	int m_nCellsPerSide;
+	std::vector<std::vector<int>> m_aCells;
+	std::vector<Point> m_aPoints;
+};
+
+
+#endif // LANDMARK_GRID_H
@@ -0,0 +1,204 @@
+#ifndef LANDMARK_HISTORY_H
+#define LANDMARK_HISTORY_H
+
+#include "memory_registry.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// Undo/redo of landmark edits, kept as one delta per edit (old and new position) in a ring of
+// fixed capacity, so memory is bounded and undo costs the size of the operation, not of the
+// session. An operation is a run of edits sharing a serial: a held nudge key is one edit whose
+// target keeps moving until seal(), and a group (e.g. accepting every candidate) is many edits.
+// When the ring is full the oldest whole operation is dropped. A group larger than the whole ring
+// cannot be undone; it is dropped as well and reported by overflowCount(). The default capacity
+// holds a group touching every landmark of every view (24 x 331) twice over. The change log reads
+// the same ring.
+class LandmarkHistory
+{
+public:
+	enum Source : uint8_t
+	{
+		Source_Nudge,			// moved with the keyboard
+		Source_Propagation,		// accepted propagation candidate
+		Source_Reload			// taken from an annotation file changed on disk
+	};
+
+	struct Edit
+	{
+		uint32_t op;			// operation serial, edits with the same one are undone together
+		uint16_t iView;
+		uint16_t iLandmark;
+		float from[2];			// photo pixels before and after, (0, 0) if missing
+		float to[2];
+		int64_t time;			// of the latest change, seconds since the epoch
+		Source source;
+	};
+
+	explicit LandmarkHistory(size_t capacity = 16384) :
+		m_aRing(capacity)
+	{
+		g_memoryRegistry.set("Landmarks", "edit history", MemoryRegistry::Location_Host, capacity * sizeof(Edit));
+	}
+
+	~LandmarkHistory()
+	{
+		g_memoryRegistry.release("Landmarks", "edit history");
+	}
+
+	LandmarkHistory(const LandmarkHistory&) = delete;
+	LandmarkHistory& operator=(const LandmarkHistory&) = delete;
+
+	// Records landmark `iLandmark` of `iView` moving from (xFrom, yFrom) to (xTo, yTo). A nudge
+	// extends the previous nudge of the same landmark instead while no seal() came in between.
+	// Returns false if the edit belongs to a group that outgrew the ring and is not recorded
+	bool record(int iView, int iLandmark, float xFrom, float yFrom, float xTo, float yTo, Source source)
+	{
+		m_nStored = m_nApplied;		// a new edit drops whatever could be redone
+		if (source == Source_Nudge && m_bOpen && m_nApplied > 0)
+		{
+			Edit &last = at(m_nApplied - 1);
+			if (last.source == Source_Nudge && last.iView == iView && last.iLandmark == iLandmark)
+			{
+				last.to[0] = xTo;
+				last.to[1] = yTo;
+				last.time = std::time(nullptr);
+				return true;
+			}
+		}
+		m_bOpen = source == Source_Nudge;
+
+		uint32_t op = m_bGroup ? m_groupOp : ++m_lastOp;
+		if (op == m_droppedOp)
+		{
+			++m_nOverflow;
+			return false;	// the group outgrew the ring, the rest of it cannot be undone either
+		}
+		if (m_nStored == m_aRing.size())
+		{
+			uint32_t oldest = m_aRing[m_iFirst].op;
+			size_t nDropped = 0;
+			while (m_nStored > 0 && m_aRing[m_iFirst].op == oldest)
+			{
+				m_iFirst = (m_iFirst + 1) % m_aRing.size();
+				--m_nStored;
+				++nDropped;
+			}
+			m_nApplied = m_nStored;
+			if (oldest == op)
+			{
+				m_droppedOp = op;
+				m_nOverflow = nDropped + 1;
+				return false;
+			}
+		}
+		at(m_nStored++) = { op, uint16_t(iView), uint16_t(iLandmark), { xFrom, yFrom }, { xTo, yTo }, std::time(nullptr), source };
+		m_nApplied = m_nStored;
+		return true;
+	}
+
+	// Ends the nudge being extended, e.g. once the key is released
+	void seal() { m_bOpen = false; }
+
+	// Edits recorded between the two calls form one operation
+	void beginGroup()
+	{
+		m_groupOp = ++m_lastOp;
+		m_bGroup = true;
+		m_bOpen = false;
+	}
+
+	void endGroup() { m_bGroup = false; }
+
+	bool canUndo() const { return m_nApplied > 0; }
+	bool canRedo() const { return m_nApplied < m_nStored; }
+
+	// Restores the positions from before the last operation in `aLandmarkSets`, calling
+	// onMoved(iView, iLandmark) for every landmark written. Returns false if there is none
+	bool undo(std::vector<std::vector<float>> &aLandmarkSets, const std::function<void(int, int)> &onMoved)
+	{
+		if (!canUndo())
+			return false;
+		m_bOpen = false;
+		uint32_t op = at(m_nApplied - 1).op;
+		while (m_nApplied > 0 && at(m_nApplied - 1).op == op)
+		{
+			const Edit &e = at(--m_nApplied);
+			apply(e, e.from, aLandmarkSets, onMoved);
+		}
+		return true;
+	}
+
+	// Reapplies the last undone operation, see undo()
+	bool redo(std::vector<std::vector<float>> &aLandmarkSets, const std::function<void(int, int)> &onMoved)
+	{
+		if (!canRedo())
+			return false;
+		m_bOpen = false;
+		uint32_t op = at(m_nApplied).op;
+		while (m_nApplied < m_nStored && at(m_nApplied).op == op)
+		{
+			const Edit &e = at(m_nApplied++);
+			apply(e, e.to, aLandmarkSets, onMoved);
+		}
+		return true;
+	}
+
+	// Edits of the last group that outgrew the ring, none of which can be undone; 0 if none did or
+	// since clearOverflow()
+	size_t overflowCount() const { return m_nOverflow; }
+	void clearOverflow() { m_nOverflow = 0; }
+
+	// Edits still held, oldest first; the first appliedCount() are applied, the rest undone
+	size_t size() const { return m_nStored; }
+	size_t appliedCount() const { return m_nApplied; }
+	const Edit& edit(size_t i) const { return m_aRing[(m_iFirst + i) % m_aRing.size()]; }
+
+	// One change log line, e.g. "14:02:51 view 3 landmark 17 nudged (812.0, 640.5) -> (815.0, 640.5)"
+	static std::string describe(const Edit &e)
+	{
+		std::time_t t = std::time_t(e.time);
+		char clock[16] = { 0 };
+		std::strftime(clock, sizeof(clock), "%H:%M:%S", std::localtime(&t));
+		char line[160];
+		snprintf(line, sizeof(line), "%s view %d landmark %d %s (%.1f, %.1f) -> (%.1f, %.1f)", clock, int(e.iView), int(e.iLandmark),
+			k_aSourceVerbs[e.source], e.from[0], e.from[1], e.to[0], e.to[1]);
+		return line;
+	}
+
+private:
+	Edit& at(size_t i) { return m_aRing[(m_iFirst + i) % m_aRing.size()]; }
+	const Edit& at(size_t i) const { return edit(i); }
+
+	static void apply(const Edit &e, const float *pt, std::vector<std::vector<float>> &aLandmarkSets, const std::function<void(int, int)> &onMoved)
+	{
+		if (e.iView >= aLandmarkSets.size() || size_t(e.iLandmark) * 2 + 1 >= aLandmarkSets[e.iView].size())
+			return;		// the landmark files were reloaded with fewer entries
+		aLandmarkSets[e.iView][e.iLandmark * 2] = pt[0];
+		aLandmarkSets[e.iView][e.iLandmark * 2 + 1] = pt[1];
+		if (onMoved)
+			onMoved(e.iView, e.iLandmark);
+	}
+
+	static constexpr const char *k_aSourceVerbs[] = { "nudged", "propagated", "reloaded" };
+
+	std::vector<Edit> m_aRing;
+	size_t m_iFirst = 0;		// ring index of the oldest edit
+	size_t m_nStored = 0;
+	size_t m_nApplied = 0;		// edits [0, m_nApplied) are applied, [m_nApplied, m_nStored) can be redone
+
+	uint32_t m_lastOp = 0;
+	uint32_t m_groupOp = 0;
+	uint32_t m_droppedOp = 0;	// a group that overflowed the ring, its later edits are not recorded
+	size_t m_nOverflow = 0;		// edits of that group, dropped or not recorded
+	bool m_bGroup = false;
+	bool m_bOpen = false;		// the last edit is a nudge that may still be extended
+};
+
+
+#endif // LANDMARK_HISTORY_H
@@ -0,0 +1,106 @@
+#ifndef LANDMARK_PROPAGATOR_H
+#define LANDMARK_PROPAGATOR_H
+
+#include <Eigen/Dense>
+
+#include "core/photo_cameras.h"
+#include "utils/projection_utils.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+
+// Candidate landmark positions from projecting 3D points into every view. A candidate is
+// proposed where the view's annotation is missing or further than `minOffset` from the
+// projection; the user then accepts (writing it into the landmarks) or rejects each one.
+class LandmarkPropagator
+{
+public:
+	struct Candidate
+	{
+		int iView;
+		int iLandmark;
+		Eigen::Vector2f pt;		// photo pixels
+		float offset;			// from the current annotation, -1 if it is missing
+	};
+
+	float minOffset = 2.f;	// pixels
+
+	// `cameras` must outlive this, or the next setCameras()
+	void setCameras(const PhotoCameras *cameras) { m_cameras = cameras; }
+
+	// Projects point aPoints[k] of landmark aLandmarks[k] into every view but `iSkipView`, replacing
+	// the pending candidates of those landmarks; views where `isVisible`, when set, says the point
+	// is hidden get none. Returns the number of candidates proposed
+	size_t propose(const std::vector<int> &aLandmarks, const std::vector<Eigen::Vector3f> &aPoints,
+		const std::vector<std::vector<float>> &aLandmarkSets, int iSkipView = -1,
+		const std::function<bool(size_t, const Eigen::Vector3f&)> &isVisible = nullptr)
+	{
+		TRACE_SCOPE("LandmarkPropagator::propose");
+		m_aCandidates.erase(std::remove_if(m_aCandidates.begin(), m_aCandidates.end(), [&](const Candidate &c) {
+			return std::find(aLandmarks.begin(), aLandmarks.end(), c.iLandmark) != aLandmarks.end();
+		}), m_aCandidates.end());
+		if (!m_cameras)
+			return 0;
+
+		size_t n = aPoints.size();
+		m_xs.resize(n);
+		m_ys.resize(n);
+		m_zs.resize(n);
+		for (size_t k = 0; k < n; ++k)
+		{
+			m_xs[k] = aPoints[k].x();
+			m_ys[k] = aPoints[k].y();
+			m_zs[k] = aPoints[k].z();
+		}
+		utils::projectPoints(m_cameras->aProj, m_xs.data(), m_ys.data(), m_zs.data(), n, m_aProjected);
+
+		size_t nBefore = m_aCandidates.size();
+		for (size_t iView = 0; iView < m_aProjected.size() && iView < aLandmarkSets.size(); ++iView)
+		{
+			if (int(iView) == iSkipView)
+				continue;
+			const std::vector<float> &pts = aLandmarkSets[iView];
+			for (size_t k = 0; k < n; ++k)
+			{
+				Eigen::Vector2f pt(m_aProjected[iView][k * 2], m_aProjected[iView][k * 2 + 1]);
+				size_t i = size_t(aLandmarks[k]);
+				if (pt.x() <= 0.f || pt.y() <= 0.f || pt.x() >= m_cameras->width || pt.y() >= m_cameras->height || i * 2 + 1 >= pts.size())
+					continue;	// behind the camera or outside the photo
+				Eigen::Vector2f current(pts[i * 2], pts[i * 2 + 1]);
+				float offset = current.isZero() ? -1.f : (pt - current).norm();
+				if ((offset < 0.f || offset > minOffset) && (!isVisible || isVisible(iView, aPoints[k])))
+					m_aCandidates.push_back({ int(iView), int(i), pt, offset });
+			}
+		}
+		return m_aCandidates.size() - nBefore;
+	}
+
+	const std::vector<Candidate>& candidates() const { return m_aCandidates; }
+
+	// Writes candidate `i` into its view's landmarks and drops it; returns it for follow-up updates
+	Candidate accept(size_t i, std::vector<std::vector<float>> &aLandmarkSets)
+	{
+		Candidate c = m_aCandidates[i];
+		aLandmarkSets[c.iView][c.iLandmark * 2] = c.pt.x();
+		aLandmarkSets[c.iView][c.iLandmark * 2 + 1] = c.pt.y();
+		m_aCandidates.erase(m_aCandidates.begin() + i);
+		return c;
+	}
+
+	void reject(size_t i) { m_aCandidates.erase(m_aCandidates.begin() + i); }
+	void clear() { m_aCandidates.clear(); }
+
+private:
+	const PhotoCameras *m_cameras = nullptr;
+	std::vector<Candidate> m_aCandidates;
+
+	// batch buffers, kept to avoid reallocating per propagation
+	std::vector<float> m_xs, m_ys, m_zs;
+	std::vector<std::vector<float>> m_aProjected;
+};
+
+
+#endif // LANDMARK_PROPAGATOR_H
@@ -0,0 +1,122 @@
+#ifndef LANDMARK_RAYCASTER_H
+#define LANDMARK_RAYCASTER_H
+
+#include <Eigen/Dense>
+#include <glm/glm.hpp>
+
+#include "gl/model.h"
+#include "mesh_bvh.h"
+#include "utils/parallel_utils.h"
+#include "utils/task_scheduler.h"
+#include "utils/trace.h"
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+
+// Casts the ray of a 2D landmark annotation from its camera onto the mesh, giving the surface
+// point it marks. The BVH is built on worker threads after load; until it is ready every cast
+// misses, so callers fall back to drawing the unbounded ray.
+class LandmarkRaycaster
+{
+public:
+	// `aInvTransMatrices` take camera coordinates to world, f/cx/cy are the shared intrinsics
+	void setCameras(const std::vector<Eigen::Matrix4f> &aInvTransMatrices, double f, double cx, double cy, double width, double height)
+	{
+		m_aInvTrans = aInvTransMatrices;
+		m_invF = 1. / f;
+		m_cx = width * 0.5 + cx;
+		m_cy = height * 0.5 + cy;
+	}
+
+	~LandmarkRaycaster()
+	{
+		wait();
+	}
+
+	// Starts building the BVH of `model` on the scheduler, ahead of background work since picking
+	// waits on it; `model` must stay unchanged until poll() picks the result up. A build still
+	// running for an earlier model is finished first
+	void startBuild(const Model &model)
+	{
+		wait();
+		m_bReady = false;
+		m_buildTask = utils::scheduler().submit([this, &model]() {
+			auto start = std::chrono::steady_clock::now();
+			m_bvh.build(model.meshes);
+			m_buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}, utils::TaskPriority_Normal);
+	}
+
+	// Picks up a finished build; returns true on the call that does, polled from the render loop
+	bool poll()
+	{
+		if (m_bReady || !m_buildTask.valid() || m_buildTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+		m_buildTask.get();
+		m_bReady = true;
+		return true;
+	}
+
+	bool ready() const { return m_bReady; }
+
+	// Blocks until a running build is done, e.g. before its model is deleted
+	void wait()
+	{
+		if (m_buildTask.valid())
+			m_buildTask.wait();
+	}
+
+	const MeshBvh& bvh() const { return m_bvh; }
+	float buildMs() const { return m_buildMs; }
+
+	// Camera position and direction of the ray through photo pixel (xPhoto, yPhoto) of `iView`;
+	// the direction has unit depth in camera coordinates, so hit.t is the depth of the hit
+	void ray(size_t iView, float xPhoto, float yPhoto, glm::vec3 &origin, glm::vec3 &dir) const
+	{
+		const Eigen::Matrix4f &m = m_aInvTrans[iView];
+		Eigen::Vector3f o = m.block<3, 1>(0, 3);
+		Eigen::Vector3f d = m.block<3, 3>(0, 0) * Eigen::Vector3f(float((xPhoto - m_cx) * m_invF), float((yPhoto - m_cy) * m_invF), 1.f);
+		origin = glm::vec3(o.x(), o.y(), o.z());
+		dir = glm::vec3(d.x(), d.y(), d.z());
+	}
+
+	MeshBvh::Hit castLandmark(size_t iView, float xPhoto, float yPhoto) const
+	{
+		if (!m_bReady || iView >= m_aInvTrans.size())
+			return MeshBvh::Hit();
+		glm::vec3 origin, dir;
+		ray(iView, xPhoto, yPhoto, origin, dir);
+		return m_bvh.intersect(origin, dir);
+	}
+
+	// Hits of every landmark in every view, indexed [view][landmark]; unannotated ones miss
+	std::vector<std::vector<MeshBvh::Hit>> castAll(const std::vector<std::vector<float>> &aLandmarkSets) const
+	{
+		TRACE_SCOPE("LandmarkRaycaster::castAll");
+		std::vector<std::vector<MeshBvh::Hit>> aHits(aLandmarkSets.size());
+		utils::parallelFor(aLandmarkSets.size(), utils::hardwareThreads(), [&](size_t iView) {
+			const std::vector<float> &pts = aLandmarkSets[iView];
+			aHits[iView].resize(pts.size() / 2);
+			for (size_t i = 0; i < pts.size() / 2; ++i)
+			{
+				if (pts[i * 2] == 0.f && pts[i * 2 + 1] == 0.f) continue;
+				aHits[iView][i] = castLandmark(iView, pts[i * 2], pts[i * 2 + 1]);
+			}
+		});
+		return aHits;
+	}
+
+private:
+	std::vector<Eigen::Matrix4f> m_aInvTrans;
+	double m_invF = 1., m_cx = 0., m_cy = 0.;
+
+	MeshBvh m_bvh;
+	std::future<void> m_buildTask;
+	bool m_bReady = false;
+	float m_buildMs = 0.f;
+};
+
+
+#endif // LANDMARK_RAYCASTER_H
@@ -0,0 +1,379 @@
+#ifndef LANDMARK_TRIANGULATOR_H
+#define LANDMARK_TRIANGULATOR_H
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+
+#include "core/photo_cameras.h"
+#include "utils/parallel_utils.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+
+// Triangulates every landmark from the views that annotate it and measures, per view, how far
+// the annotation lies from the reprojection of the triangulated point. A landmark needs two
+// annotated views; (0, 0) marks a missing annotation, as in the landmark files.
+//
+// Each point starts from a linear (DLT) solution and is refined by iteratively reweighted
+// least squares: rows are divided by the point depth, so the algebraic error approaches the
+// pixel error, and weighted with a Cauchy loss, so one misplaced annotation does not drag the
+// point away from the others. Triangulation runs over chunks of landmarks on all cores;
+// reprojection runs one view per task, vectorized over landmarks.
+//
+// The weighted normal equations of every landmark are cached per view, so an edit of one
+// annotation only swaps that view's rows and re-solves a 4x4 system (update()).
+class LandmarkTriangulator
+{
+public:
+	static constexpr float NO_ERROR = -1.f;
+
+	struct Landmark
+	{
+		Eigen::Vector3f point = Eigen::Vector3f::Zero();
+		bool bValid = false;	// at least two annotated views and a finite point
+		int nViews = 0;
+		int nOutliers = 0;
+		float rmsError = 0.f;	// over the inlier views, in pixels
+	};
+
+	// keeps double-precision copies of the projections, `cameras` is not referenced afterwards
+	void setCameras(const PhotoCameras &cameras)
+	{
+		double width = cameras.width, height = cameras.height;
+		// Hartley normalization: pixels to roughly [-1, 1], for a well-conditioned system
+		double s = 2. / std::max(width, height);
+		Eigen::Matrix3d N;
+		N << s, 0, -s * width * 0.5,
+			0, s, -s * height * 0.5,
+			0, 0, 1;
+		m_aProj.clear();
+		m_aNormProj.clear();
+		for (const auto &P : cameras.aProj)
+		{
+			m_aProj.push_back(P.cast<double>());
+			m_aNormProj.push_back(N * P.cast<double>());
+		}
+		m_normScale = s;
+		m_center = Eigen::Vector2d(width * 0.5, height * 0.5);
+	}
+
+	// Re-triangulates every landmark from `aLandmarkSets`, one [x0, y0, x1, y1, ...] per view
+	void solve(const std::vector<std::vector<float>> &aLandmarkSets)
+	{
+		TRACE_SCOPE("LandmarkTriangulator::solve");
+		size_t nViews = std::min(aLandmarkSets.size(), m_aProj.size());
+		size_t nLandmarks = nViews > 0 ? aLandmarkSets[0].size() / 2 : 0;
+		m_aLandmarks.assign(nLandmarks, Landmark());
+		m_aCaches.assign(nLandmarks, Cache());
+
+		const size_t CHUNK = 32;
+		utils::parallelFor((nLandmarks + CHUNK - 1) / CHUNK, utils::hardwareThreads(), [&](size_t iChunk) {
+			for (size_t i = iChunk * CHUNK; i < std::min(nLandmarks, (iChunk + 1) * CHUNK); ++i)
+				m_aLandmarks[i] = triangulate(aLandmarkSets, nViews, i, m_aCaches[i]);
+		});
+
+		// Points in SoA layout, so each view projects all of them with whole-array operations
+		Eigen::ArrayXf X(nLandmarks), Y(nLandmarks), Z(nLandmarks);
+		Eigen::Array<bool, Eigen::Dynamic, 1> valid(nLandmarks);
+		for (size_t i = 0; i < nLandmarks; ++i)
+		{
+			X[i] = m_aLandmarks[i].point.x();
+			Y[i] = m_aLandmarks[i].point.y();
+			Z[i] = m_aLandmarks[i].point.z();
+			valid[i] = m_aLandmarks[i].bValid;
+		}
+
+		m_aErrors.assign(nViews, Eigen::ArrayXf());
+		utils::parallelFor(nViews, utils::hardwareThreads(), [&](size_t iView) {
+			const Eigen::Matrix<double, 3, 4> &P = m_aProj[iView];
+			Eigen::Map<const Eigen::ArrayXf, 0, Eigen::InnerStride<2>> x(aLandmarkSets[iView].data(), nLandmarks);
+			Eigen::Map<const Eigen::ArrayXf, 0, Eigen::InnerStride<2>> y(aLandmarkSets[iView].data() + 1, nLandmarks);
+			Eigen::ArrayXf w = float(P(2, 0)) * X + float(P(2, 1)) * Y + float(P(2, 2)) * Z + float(P(2, 3));
+			Eigen::ArrayXf du = (float(P(0, 0)) * X + float(P(0, 1)) * Y + float(P(0, 2)) * Z + float(P(0, 3))) / w - x;
+			Eigen::ArrayXf dv = (float(P(1, 0)) * X + float(P(1, 1)) * Y + float(P(1, 2)) * Z + float(P(1, 3))) / w - y;
+			Eigen::Array<bool, Eigen::Dynamic, 1> annotated = (x != 0.f) || (y != 0.f);
+			m_aErrors[iView] = (valid && annotated).select((du.square() + dv.square()).sqrt(), NO_ERROR);
+		});
+
+		updateStatistics();
+	}
+
+	// Re-estimates landmark `iLandmark` after its annotation in `iView` changed. Only that view's
+	// rows of the cached normal equations are replaced and reweighted; the other views keep the
+	// weights of the last full solve. The landmark's errors in every view are then refreshed,
+	// one projection per view.
+	void update(const std::vector<std::vector<float>> &aLandmarkSets, size_t iView, size_t iLandmark)
+	{
+		TRACE_SCOPE("LandmarkTriangulator::update");
+		if (iLandmark >= m_aLandmarks.size() || iView >= m_aErrors.size())
+			return;
+		Landmark &lm = m_aLandmarks[iLandmark];
+		Cache &cache = m_aCaches[iLandmark];
+		float x = aLandmarkSets[iView][iLandmark * 2], y = aLandmarkSets[iView][iLandmark * 2 + 1];
+		bool bAnnotated = x != 0.f || y != 0.f;
+		int nOldOutliers = lm.nOutliers;	// triangulate() below starts the landmark over
+
+		// A view appearing or disappearing changes the start; solve this landmark from scratch
+		if (!lm.bValid || bAnnotated != (cache.aScales[iView] > 0.))
+		{
+			lm = triangulate(aLandmarkSets, m_aErrors.size(), iLandmark, cache);
+		}
+		else
+		{
+			Eigen::Vector2d pt(x, y);
+			Observation o{ &m_aProj[iView], &m_aNormProj[iView], pt, (pt - m_center) * m_normScale, 1., 1. };
+			Eigen::Matrix4d others = cache.normalEq - cache.aScales[iView] * cache.aRows[iView];
+			Eigen::Matrix4d rows = dltRows(o, 1.);
+			Eigen::Vector4d X = lm.point.cast<double>().homogeneous();
+			double scale = 0.;
+			for (int iter = 0; iter < INCREMENTAL_ITERATIONS; ++iter)
+			{
+				scale = irlsScale(o, X, robustScale);
+				Eigen::Vector4d Xh;
+				if (!solveDlt(others + scale * rows, Xh))
+					break;
+				X = Xh;
+			}
+			cache.aRows[iView] = rows;
+			cache.aScales[iView] = scale;
+			cache.normalEq = others + scale * rows;
+			lm.point = X.head<3>().cast<float>();
+		}
+
+		for (size_t v = 0; v < m_aErrors.size(); ++v)
+		{
+			float xv = aLandmarkSets[v][iLandmark * 2], yv = aLandmarkSets[v][iLandmark * 2 + 1];
+			m_aErrors[v][iLandmark] = lm.bValid && (xv != 0.f || yv != 0.f) ? 
+				float((reproject(v, iLandmark).cast<double>() - Eigen::Vector2d(xv, yv)).norm()) : NO_ERROR;
+		}
+		m_nOutliers -= nOldOutliers;
+		updateStatistics(iLandmark);
+		m_nOutliers += lm.nOutliers;
+	}
+
+	// Recounts outliers and inlier RMS after `outlierThreshold` changes
+	void updateStatistics()
+	{
+		m_nOutliers = 0;
+		for (size_t i = 0; i < m_aLandmarks.size(); ++i)
+		{
+			updateStatistics(i);
+			m_nOutliers += m_aLandmarks[i].nOutliers;
+		}
+	}
+
+	// Distance in pixels between the annotation and the reprojected point, or NO_ERROR
+	float error(size_t iView, size_t iLandmark) const
+	{
+		if (iView >= m_aErrors.size() || iLandmark >= size_t(m_aErrors[iView].size()))
+			return NO_ERROR;
+		return m_aErrors[iView][iLandmark];
+	}
+
+	bool isOutlier(size_t iView, size_t iLandmark) const
+	{
+		return error(iView, iLandmark) > outlierThreshold;
+	}
+
+	// Photo pixel position of the triangulated landmark in `iView`
+	Eigen::Vector2f reproject(size_t iView, size_t iLandmark) const
+	{
+		Eigen::Vector3d p = m_aProj[iView] * m_aLandmarks[iLandmark].point.cast<double>().homogeneous();
+		return Eigen::Vector2f(float(p.x() / p.z()), float(p.y() / p.z()));
+	}
+
+	const std::vector<Landmark>& landmarks() const { return m_aLandmarks; }
+	size_t outlierCount() const { return m_nOutliers; }
+
+	size_t outlierCount(size_t iView) const
+	{
+		return iView < m_aErrors.size() ? size_t((m_aErrors[iView] > outlierThreshold).count()) : 0;
+	}
+
+	float outlierThreshold = 10.f;	// pixels
+	float robustScale = 3.f;		// pixels, where the Cauchy weight halves
+
+private:
+	static const int MAX_IRLS_ITERATIONS = 16;
+	static const int INCREMENTAL_ITERATIONS = 3;
+	static constexpr double INITIAL_ROBUST_SCALE = 256.;	// pixels
+
+	struct Observation
+	{
+		const Eigen::Matrix<double, 3, 4> *P;
+		const Eigen::Matrix<double, 3, 4> *normP;
+		Eigen::Vector2d pt;			// pixels
+		Eigen::Vector2d normPt;		// N * pt
+		double weight;
+		double depth;
+	};
+
+	// Normal equations of a landmark as last solved, for incremental updates
+	struct Cache
+	{
+		Eigen::Matrix4d normalEq = Eigen::Matrix4d::Zero();	// sum of aScales[v] * aRows[v]
+		std::vector<Eigen::Matrix4d> aRows;		// per view, unweighted DLT rows
+		std::vector<double> aScales;			// per view, weight / depth^2; 0 when not annotated
+	};
+
+	void updateStatistics(size_t iLandmark)
+	{
+		Landmark &lm = m_aLandmarks[iLandmark];
+		lm.nOutliers = 0;
+		double sumSq = 0.;
+		int nInliers = 0;
+		for (const auto &errors : m_aErrors)
+		{
+			float e = errors[iLandmark];
+			if (e == NO_ERROR)
+				continue;
+			if (e > outlierThreshold)
+				++lm.nOutliers;
+			else
+			{
+				sumSq += double(e) * e;
+				++nInliers;
+			}
+		}
+		lm.rmsError = nInliers > 0 ? float(std::sqrt(sumSq / nInliers)) : 0.f;
+	}
+
+	// Cauchy weight over squared depth for `o` at the point `X`; updates o.weight and o.depth
+	static double irlsScale(Observation &o, const Eigen::Vector4d &X, double robustScale)
+	{
+		Eigen::Vector3d p = *o.P * X;
+		double r = (p.head<2>() / p.z() - o.pt).norm() / robustScale;
+		o.weight = 1. / (1. + r * r);
+		o.depth = std::max(std::abs(p.z()), 1e-12);
+		return o.weight / (o.depth * o.depth);
+	}
+
+	// Normal-equation contribution of the DLT rows x * P3 - P1 and y * P3 - P2, times `weight`
+	static Eigen::Matrix4d dltRows(const Observation &o, double weight)
+	{
+		const Eigen::Matrix<double, 3, 4> &Pn = *o.normP;
+		Eigen::RowVector4d r0 = o.normPt.x() * Pn.row(2) - Pn.row(0);
+		Eigen::RowVector4d r1 = o.normPt.y() * Pn.row(2) - Pn.row(1);
+		return weight * (r0.transpose() * r0 + r1.transpose() * r1);
+	}
+
+	// Point minimizing the algebraic error, false at infinity
+	static bool solveDlt(const Eigen::Matrix4d &AtA, Eigen::Vector4d &X)
+	{
+		Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> solver(AtA);
+		X = solver.eigenvectors().col(0);	// eigenvalues ascend
+		if (!(std::abs(X.w()) > 1e-12))
+			return false;
+		X /= X.w();
+		return X.allFinite();
+	}
+
+	static double medianError(const std::vector<Observation> &obs, const Eigen::Vector4d &X, std::vector<double> &aErrors)
+	{
+		for (size_t k = 0; k < obs.size(); ++k)
+		{
+			Eigen::Vector3d p = *obs[k].P * X;
+			aErrors[k] = p.z() > 0. ? (p.head<2>() / p.z() - obs[k].pt).norm() : std::numeric_limits<double>::infinity();
+		}
+		std::nth_element(aErrors.begin(), aErrors.begin() + aErrors.size() / 2, aErrors.end());
+		return aErrors[aErrors.size() / 2];
+	}
+
+	Landmark triangulate(const std::vector<std::vector<float>> &aLandmarkSets, size_t nViews, size_t iLandmark, Cache &cache) const
+	{
+		cache.normalEq.setZero();
+		cache.aRows.assign(nViews, Eigen::Matrix4d::Zero());
+		cache.aScales.assign(nViews, 0.);
+
+		std::vector<Observation> obs;
+		std::vector<size_t> aViews;
+		obs.reserve(nViews);
+		for (size_t v = 0; v < nViews; ++v)
+		{
+			float x = aLandmarkSets[v][iLandmark * 2], y = aLandmarkSets[v][iLandmark * 2 + 1];
+			if (x == 0.f && y == 0.f)
+				continue;
+			Eigen::Vector2d pt(x, y);
+			obs.push_back({ &m_aProj[v], &m_aNormProj[v], pt, (pt - m_center) * m_normScale, 1., 1. });
+			aViews.push_back(v);
+		}
+
+		Landmark lm;
+		lm.nViews = int(obs.size());
+		if (obs.size() < 2)
+			return lm;
+
+		// Linear start: the plain DLT or, when one annotation is far off, the DLT without it;
+		// whichever has the lowest median reprojection error
+		std::vector<Eigen::Matrix4d> aRows(obs.size());
+		Eigen::Matrix4d AtA = Eigen::Matrix4d::Zero();
+		for (size_t k = 0; k < obs.size(); ++k)
+		{
+			aRows[k] = dltRows(obs[k], 1.);
+			AtA += aRows[k];
+		}
+		Eigen::Vector4d X;
+		if (!solveDlt(AtA, X))
+			return lm;
+		std::vector<double> aErrors(obs.size());
+		double bestScore = medianError(obs, X, aErrors);
+		for (size_t k = 0; obs.size() > 2 && k < obs.size(); ++k)
+		{
+			Eigen::Vector4d Xk;
+			if (!solveDlt(AtA - aRows[k], Xk))
+				continue;
+			double score = medianError(obs, Xk, aErrors);
+			if (score < bestScore)
+			{
+				bestScore = score;
+				X = Xk;
+			}
+		}
+
+		// IRLS; rows divided by the depth approximate pixel residuals. The Cauchy scale starts
+		// wide and halves down to `robustScale`, so inliers are not rejected early.
+		for (int iter = 0; iter < MAX_IRLS_ITERATIONS; ++iter)
+		{
+			double scale = std::max(double(robustScale), INITIAL_ROBUST_SCALE / double(1 << std::min(iter, 30)));
+			AtA.setZero();
+			for (size_t k = 0; k < obs.size(); ++k)
+				AtA += irlsScale(obs[k], X, scale) * aRows[k];
+			Eigen::Vector4d Xh;
+			if (!solveDlt(AtA, Xh))
+				return lm;
+			bool bConverged = scale == robustScale && (Xh - X).head<3>().norm() <= 1e-6 * std::max(1., X.head<3>().norm());
+			X = Xh;
+			if (bConverged)
+				break;
+		}
+
+		if (!X.allFinite())
+			return lm;
+		lm.point = X.head<3>().cast<float>();
+		lm.bValid = true;
+
+		for (size_t k = 0; k < obs.size(); ++k)
+		{
+			cache.aRows[aViews[k]] = aRows[k];
+			cache.aScales[aViews[k]] = irlsScale(obs[k], X, robustScale);
+			cache.normalEq += cache.aScales[aViews[k]] * aRows[k];
+		}
+		return lm;
+	}
+
+	std::vector<Eigen::Matrix<double, 3, 4>> m_aProj;
+	std::vector<Eigen::Matrix<double, 3, 4>> m_aNormProj;	// N * P
+	double m_normScale = 1.;
+	Eigen::Vector2d m_center = Eigen::Vector2d::Zero();
+	std::vector<Landmark> m_aLandmarks;
+	std::vector<Cache> m_aCaches;
+	std::vector<Eigen::ArrayXf> m_aErrors;	// per view, per landmark
+	size_t m_nOutliers = 0;
+};
+
+
+#endif // LANDMARK_TRIANGULATOR_H
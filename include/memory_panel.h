@@ -0,0 +1,86 @@
+#ifndef MEMORY_PANEL_H
+#define MEMORY_PANEL_H
+
+#include "imgui.h"
+
+#include "memory_registry.h"
+
+#include <string>
+
+
+// The memory window (F5): totals per resource class, each expandable into its resources.
+// Draws from a snapshot, so the registry is not locked while ImGui lays out the table.
+class MemoryPanel
+{
+public:
+	void draw(const MemoryRegistry &registry, bool *pOpen)
+	{
+		if (!*pOpen)
+			return;
+		if (!ImGui::Begin("Memory (F5)", pOpen))
+		{
+			ImGui::End();
+			return;
+		}
+
+		registry.snapshot(m_classes, m_entries);
+		size_t host = 0, gpu = 0;
+		for (auto &c : m_classes)
+		{
+			host += c.second.bytes[MemoryRegistry::Location_Host];
+			gpu += c.second.bytes[MemoryRegistry::Location_Gpu];
+		}
+		ImGui::Text("Host %.1f MiB, GPU %.1f MiB", mib(host), mib(gpu));
+
+		if (ImGui::BeginTable("memory", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Resource");
+			ImGui::TableSetupColumn("Host (MiB)");
+			ImGui::TableSetupColumn("GPU (MiB)");
+			ImGui::TableSetupColumn("Peak host/GPU");
+			ImGui::TableHeadersRow();
+			for (auto &c : m_classes)
+			{
+				const MemoryRegistry::ClassTotals &totals = c.second;
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				bool bOpen = ImGui::TreeNodeEx(c.first.c_str(), 0);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f", mib(totals.bytes[MemoryRegistry::Location_Host]));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f", mib(totals.bytes[MemoryRegistry::Location_Gpu]));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f / %.2f", mib(totals.peak[MemoryRegistry::Location_Host]), mib(totals.peak[MemoryRegistry::Location_Gpu]));
+				if (!bOpen)
+					continue;
+				for (auto it = m_entries.lower_bound({ c.first, std::string() });
+					it != m_entries.end() && it->first.first == c.first; ++it)
+				{
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(it->first.second.c_str());
+					ImGui::TableNextColumn();
+					if (it->second.location == MemoryRegistry::Location_Host)
+						ImGui::Text("%.3f", mib(it->second.bytes));
+					ImGui::TableNextColumn();
+					if (it->second.location == MemoryRegistry::Location_Gpu)
+						ImGui::Text("%.3f", mib(it->second.bytes));
+					ImGui::TableNextColumn();
+				}
+				ImGui::TreePop();
+			}
+			ImGui::EndTable();
+		}
+		ImGui::End();
+	}
+
+private:
+	static float mib(size_t bytes) { return bytes / (1024.f * 1024.f); }
+
+	// kept between frames, assigning over them reuses their nodes
+	MemoryRegistry::Classes m_classes;
+	MemoryRegistry::Entries m_entries;
+};
+
+
+#endif // MEMORY_PANEL_H
@@ -0,0 +1,132 @@
+#ifndef MEMORY_REGISTRY_H
+#define MEMORY_REGISTRY_H
+
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+
+// Bytes held per resource, grouped by class (photos, meshes, landmarks, staging, ...) and by
+// where they live. Owners report their allocations with set() and release(); sizes of GPU
+// resources are what was requested from GL, the driver may pad them.
+// Thread-safe, since staging buffers are reported from worker threads.
+class MemoryRegistry
+{
+public:
+	enum Location
+	{
+		Location_Host = 0,
+		Location_Gpu = 1
+	};
+
+	struct Entry
+	{
+		Location location = Location_Host;
+		size_t bytes = 0;
+	};
+
+	struct ClassTotals
+	{
+		size_t bytes[2] = { 0, 0 };
+		size_t peak[2] = { 0, 0 };
+	};
+
+	typedef std::map<std::string, ClassTotals> Classes;
+	typedef std::map<std::pair<std::string, std::string>, Entry> Entries;	// by class and name
+
+	// Sets the size of a resource, replacing any earlier value
+	void set(const std::string &resourceClass, const std::string &name, Location location, size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Entry &entry = m_entries[{ resourceClass, name }];
+		ClassTotals &totals = m_classes[resourceClass];
+		totals.bytes[entry.location] -= entry.bytes;
+		entry.location = location;
+		entry.bytes = bytes;
+		totals.bytes[location] += bytes;
+		totals.peak[location] = std::max(totals.peak[location], totals.bytes[location]);
+	}
+
+	void release(const std::string &resourceClass, const std::string &name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_entries.find({ resourceClass, name });
+		if (it == m_entries.end())
+			return;
+		m_classes[resourceClass].bytes[it->second.location] -= it->second.bytes;
+		m_entries.erase(it);
+	}
+
+	size_t total(Location location) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t sum = 0;
+		for (auto &c : m_classes)
+			sum += c.second.bytes[location];
+		return sum;
+	}
+
+	// Copies of the totals and of every live resource, taken together, e.g. for a panel to draw
+	void snapshot(Classes &classes, Entries &entries) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		classes = m_classes;
+		entries = m_entries;
+	}
+
+	// Per-class current and peak bytes followed by every live resource
+	bool writeJson(const std::string &path) const
+	{
+		std::ofstream out(path);
+		if (!out)
+		{
+			std::cerr << "[Error] Cannot write memory report to " << path << std::endl;
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const char *locations[] = { "host", "gpu" };
+		out << "{\n  \"classes\": {";
+		bool bFirst = true;
+		for (auto &c : m_classes)
+		{
+			out << (bFirst ? "" : ",") << "\n    ";
+			trace_utils::writeJsonString(out, c.first);
+			out << ": { "
+				<< "\"host_bytes\": " << c.second.bytes[Location_Host] << ", \"gpu_bytes\": " << c.second.bytes[Location_Gpu]
+				<< ", \"peak_host_bytes\": " << c.second.peak[Location_Host] << ", \"peak_gpu_bytes\": " << c.second.peak[Location_Gpu] << " }";
+			bFirst = false;
+		}
+		out << "\n  },\n  \"resources\": [";
+		bFirst = true;
+		for (auto &e : m_entries)
+		{
+			out << (bFirst ? "" : ",") << "\n    { \"class\": ";
+			trace_utils::writeJsonString(out, e.first.first);
+			out << ", \"name\": ";
+			trace_utils::writeJsonString(out, e.first.second);
+			out << ", \"location\": \"" << locations[e.second.location] << "\", \"bytes\": " << e.second.bytes << " }";
+			bFirst = false;
+		}
+		out << "\n  ]\n}\n";
+		std::cout << "Memory report written to " << path << std::endl;
+		return true;
+	}
+
+private:
+	mutable std::mutex m_mutex;
+	Entries m_entries;
+	Classes m_classes;
+};
+
+inline MemoryRegistry g_memoryRegistry;
+
+
+#endif // MEMORY_REGISTRY_H
@@ -0,0 +1,573 @@
+#ifndef MESH_BVH_H
+#define MESH_BVH_H
+
+#include <glm/glm.hpp>
+
+#include <emmintrin.h>	// SSE2, part of the x86-64 baseline
+
+#include "gl/mesh.h"
+#include "utils/parallel_utils.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+
+// Bounding volume hierarchy over the triangles of a model, for casting rays onto the surface.
+// Built as a binary SAH tree from binned centroids (large ranges binned in parallel, subtrees
+// built on worker threads), then collapsed to four children per node so one SSE slab test
+// covers all of them; each leaf holds four triangles intersected together.
+class MeshBvh
+{
+public:
+	static const unsigned int NO_HIT = ~0u;
+
+	struct Hit
+	{
+		float t = std::numeric_limits<float>::infinity();	// in units of the ray direction
+		unsigned int iMesh = NO_HIT;
+		unsigned int iTriangle = NO_HIT;	// within the mesh
+		glm::vec3 point = glm::vec3(0.f);
+
+		bool valid() const { return iTriangle != NO_HIT; }
+	};
+
+	void build(const std::vector<Mesh> &meshes, unsigned int nThreads = utils::hardwareThreads())
+	{
+		TRACE_SCOPE("MeshBvh::build");
+		m_aNodes.clear();
+		m_aTris.clear();
+		m_aMeshOffsets.assign(1, 0);
+		for (const Mesh &mesh : meshes)
+			m_aMeshOffsets.push_back(m_aMeshOffsets.back() + uint32_t(mesh.indices.size() / 3));
+		uint32_t nTris = m_aMeshOffsets.back();
+		if (nTris == 0)
+			return;
+
+		// triangle bounds, partitioned in place so every pass reads them in order
+		m_aPrims.resize(nTris);
+		utils::parallelFor((nTris + CHUNK - 1) / CHUNK, nThreads, [&](size_t iChunk) {
+			for (uint32_t i = uint32_t(iChunk * CHUNK); i < std::min<size_t>(nTris, (iChunk + 1) * CHUNK); ++i)
+			{
+				PrimRef &prim = m_aPrims[i];
+				for (int k = 0; k < 3; ++k)
+					prim.bounds.grow(vertex(meshes, i, k));
+				prim.id = i;
+			}
+		});
+
+		std::vector<BuildNode> aNodes = buildBinary(nTris, nThreads);
+		m_aNodes.reserve(aNodes.size() / 2 + 1);
+		m_aTris.reserve(nTris / MAX_LEAF_SIZE + 1);
+		m_depth = 0;
+		collapse(aNodes, 0, meshes, 1);
+
+		m_bounds = aNodes[0].bounds;
+		std::vector<PrimRef>().swap(m_aPrims);
+	}
+
+	bool empty() const { return m_aNodes.empty(); }
+	size_t triangleCount() const { return m_aMeshOffsets.back(); }
+	size_t nodeCount() const { return m_aNodes.size(); }
+	int depth() const { return m_depth; }
+	glm::vec3 boundsMin() const { return m_bounds.min; }
+	glm::vec3 boundsMax() const { return m_bounds.max; }
+
+	// Nearest hit of origin + t * dir with 0 < t < tMax; both triangle sides count
+	Hit intersect(const glm::vec3 &origin, const glm::vec3 &dir, float tMax = std::numeric_limits<float>::infinity()) const
+	{
+		Hit hit;
+		if (m_aNodes.empty())
+			return hit;
+
+		// keep the reciprocals finite so empty slabs never produce 0 * inf
+		glm::vec3 d = dir;
+		for (int k = 0; k < 3; ++k)
+			if (std::abs(d[k]) < 1e-20f)
+				d[k] = std::copysign(1e-20f, d[k]);
+		__m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+		__m128 dx = _mm_set1_ps(d.x), dy = _mm_set1_ps(d.y), dz = _mm_set1_ps(d.z);
+		__m128 idx = _mm_set1_ps(1.f / d.x), idy = _mm_set1_ps(1.f / d.y), idz = _mm_set1_ps(1.f / d.z);
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+		float tBest = tMax;
+		uint32_t iBest = NO_HIT;
+		// a lopsided build can nest deeper than the fixed stack holds, the excess spills to the heap
+		int32_t aStack[STACK_SIZE];
+		std::vector<int32_t> aSpill;
+		int top = 0;
+		aStack[top++] = 0;
+		while (top > 0 || !aSpill.empty())
+		{
+			int32_t iNode;
+			if (!aSpill.empty())
+			{
+				iNode = aSpill.back();
+				aSpill.pop_back();
+			}
+			else
+				iNode = aStack[--top];
+			if (iNode < 0)
+			{
+				// Moller-Trumbore on four triangles
+				const Tri4 &tri = m_aTris[~iNode];
+				__m128 e1x = _mm_load_ps(tri.e1[0]), e1y = _mm_load_ps(tri.e1[1]), e1z = _mm_load_ps(tri.e1[2]);
+				__m128 e2x = _mm_load_ps(tri.e2[0]), e2y = _mm_load_ps(tri.e2[1]), e2z = _mm_load_ps(tri.e2[2]);
+				__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+				__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+				__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+				__m128 det = dot(e1x, e1y, e1z, px, py, pz);
+				__m128 inv = _mm_div_ps(one, det);
+				__m128 sx = _mm_sub_ps(ox, _mm_load_ps(tri.v0[0]));
+				__m128 sy = _mm_sub_ps(oy, _mm_load_ps(tri.v0[1]));
+				__m128 sz = _mm_sub_ps(oz, _mm_load_ps(tri.v0[2]));
+				__m128 u = _mm_mul_ps(dot(sx, sy, sz, px, py, pz), inv);
+				__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+				__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+				__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+				__m128 v = _mm_mul_ps(dot(dx, dy, dz, qx, qy, qz), inv);
+				__m128 t = _mm_mul_ps(dot(e2x, e2y, e2z, qx, qy, qz), inv);
+
+				// padding lanes have zero edges, so a zero determinant rejects them too
+				__m128 ok = _mm_cmpgt_ps(_mm_and_ps(det, absMask), zero);
+				ok = _mm_and_ps(ok, _mm_cmpge_ps(u, zero));
+				ok = _mm_and_ps(ok, _mm_cmpge_ps(v, zero));
+				ok = _mm_and_ps(ok, _mm_cmple_ps(_mm_add_ps(u, v), one));
+				ok = _mm_and_ps(ok, _mm_cmpgt_ps(t, zero));
+				ok = _mm_and_ps(ok, _mm_cmplt_ps(t, _mm_set1_ps(tBest)));
+				int mask = _mm_movemask_ps(ok);
+				if (mask)
+				{
+					alignas(16) float aT[4];
+					_mm_store_ps(aT, t);
+					for (int k = 0; k < 4; ++k)
+					{
+						if ((mask & (1 << k)) && aT[k] < tBest)
+						{
+							tBest = aT[k];
+							iBest = tri.id[k];
+						}
+					}
+				}
+				continue;
+			}
+
+			// slab test against the four child boxes
+			const Node4 &node = m_aNodes[iNode];
+			__m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), idx);
+			__m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), idx);
+			__m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), idy);
+			__m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), idy);
+			__m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), idz);
+			__m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), idz);
+			__m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)), _mm_max_ps(_mm_min_ps(tz0, tz1), zero));
+			__m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)),
+				_mm_min_ps(_mm_max_ps(tz0, tz1), _mm_set1_ps(tBest)));
+			int mask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) & ((1 << node.count) - 1);
+			if (!mask)
+				continue;
+
+			// push the hit children farthest first, so the nearest is visited next
+			alignas(16) float aNear[4];
+			_mm_store_ps(aNear, tNear);
+			int aOrder[4], n = 0;
+			for (int k = 0; k < 4; ++k)
+			{
+				if (!(mask & (1 << k)))
+					continue;
+				int j = n++;
+				for (; j > 0 && aNear[aOrder[j - 1]] < aNear[k]; --j)
+					aOrder[j] = aOrder[j - 1];
+				aOrder[j] = k;
+			}
+			for (int k = 0; k < n; ++k)
+			{
+				if (top < STACK_SIZE)
+					aStack[top++] = node.child[aOrder[k]];
+				else
+					aSpill.push_back(node.child[aOrder[k]]);
+			}
+		}
+
+		if (iBest != NO_HIT)
+		{
+			hit.t = tBest;
+			hit.iMesh = uint32_t(std::upper_bound(m_aMeshOffsets.begin(), m_aMeshOffsets.end(), iBest) - m_aMeshOffsets.begin() - 1);
+			hit.iTriangle = iBest - m_aMeshOffsets[hit.iMesh];
+			hit.point = origin + dir * tBest;
+		}
+		return hit;
+	}
+
+private:
+	static const int BINS = 16;
+	static const uint32_t MAX_LEAF_SIZE = 4;	// one Tri4
+	static const size_t CHUNK = 16384;			// triangles per parallel task
+	static const int STACK_SIZE = 256;			// 3 per level of the 4-wide tree, enough for 85 levels
+
+	struct Bounds
+	{
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+		void grow(const glm::vec3 &p) { grow(p, p); }
+		void grow(const Bounds &b) { grow(b.min, b.max); }
+		void grow(const glm::vec3 &lo, const glm::vec3 &hi)
+		{
+			min.x = std::min(min.x, lo.x); min.y = std::min(min.y, lo.y); min.z = std::min(min.z, lo.z);
+			max.x = std::max(max.x, hi.x); max.y = std::max(max.y, hi.y); max.z = std::max(max.z, hi.z);
+		}
+		float area() const
+		{
+			glm::vec3 e = glm::max(max - min, glm::vec3(0.f));
+			return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+		}
+	};
+
+	struct PrimRef
+	{
+		Bounds bounds;
+		uint32_t id;
+
+		float centroid(int axis) const { return (bounds.min[axis] + bounds.max[axis]) * 0.5f; }
+	};
+
+	struct BuildNode
+	{
+		Bounds bounds;
+		uint32_t left = 0, right = 0;	// children of an inner node
+		uint32_t first = 0, count = 0;	// m_aPrims range of a leaf, count > 0
+	};
+
+	// range of m_aPrims still to be split into the subtree rooted at `node`
+	struct BuildTask
+	{
+		uint32_t node, begin, end;
+	};
+
+	struct Bin
+	{
+		Bounds bounds;
+		uint32_t count = 0;
+	};
+
+	struct alignas(16) Node4
+	{
+		float minX[4], minY[4], minZ[4], maxX[4], maxY[4], maxZ[4];
+		int32_t child[4];	// inner node index, or ~Tri4 index for a leaf
+		int count;
+	};
+
+	struct alignas(16) Tri4
+	{
+		float v0[3][4], e1[3][4], e2[3][4];	// SoA over the four triangles, unused lanes are zero
+		uint32_t id[4];
+	};
+
+	glm::vec3 vertex(const std::vector<Mesh> &meshes, uint32_t iTri, int k) const
+	{
+		size_t iMesh = std::upper_bound(m_aMeshOffsets.begin(), m_aMeshOffsets.end(), iTri) - m_aMeshOffsets.begin() - 1;
+		const Mesh &mesh = meshes[iMesh];
+		return mesh.vertices[mesh.indices[(iTri - m_aMeshOffsets[iMesh]) * 3 + k]].position_;
+	}
+
+	static __m128 dot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+	}
+
+	// Splits ranges larger than one subtree task serially with parallel binning, then builds
+	// the remaining subtrees on worker threads and stitches them into one node array
+	std::vector<BuildNode> buildBinary(uint32_t nTris, unsigned int nThreads)
+	{
+		uint32_t subtreeSize = std::max<uint32_t>(4096, nTris / (4 * nThreads));
+		std::vector<BuildNode> aNodes(1);
+		std::vector<BuildTask> aFrontier = { { 0, 0, nTris } }, aSubtrees;
+		while (!aFrontier.empty())
+		{
+			BuildTask task = aFrontier.back();
+			aFrontier.pop_back();
+			if (task.end - task.begin <= subtreeSize)
+			{
+				aSubtrees.push_back(task);
+				continue;
+			}
+			uint32_t mid = split(task.begin, task.end, aNodes[task.node].bounds, nThreads);
+			uint32_t iLeft = uint32_t(aNodes.size());
+			aNodes.resize(aNodes.size() + 2);
+			aNodes[task.node].left = iLeft;
+			aNodes[task.node].right = iLeft + 1;
+			aFrontier.push_back({ iLeft, task.begin, mid });
+			aFrontier.push_back({ iLeft + 1, mid, task.end });
+		}
+
+		std::vector<std::vector<BuildNode>> aSubtreeNodes(aSubtrees.size());
+		utils::parallelFor(aSubtrees.size(), nThreads, [&](size_t i) {
+			TRACE_SCOPE("MeshBvh subtree");
+			std::vector<BuildNode> &aLocal = aSubtreeNodes[i];
+			aLocal.resize(1);
+			std::vector<BuildTask> aStack = { { 0, aSubtrees[i].begin, aSubtrees[i].end } };
+			while (!aStack.empty())
+			{
+				BuildTask task = aStack.back();
+				aStack.pop_back();
+				uint32_t mid = split(task.begin, task.end, aLocal[task.node].bounds, 1);
+				if (mid == task.begin)
+				{
+					aLocal[task.node].first = task.begin;
+					aLocal[task.node].count = task.end - task.begin;
+					continue;
+				}
+				uint32_t iLeft = uint32_t(aLocal.size());
+				aLocal.resize(aLocal.size() + 2);
+				aLocal[task.node].left = iLeft;
+				aLocal[task.node].right = iLeft + 1;
+				aStack.push_back({ iLeft, task.begin, mid });
+				aStack.push_back({ iLeft + 1, mid, task.end });
+			}
+		});
+
+		// local node 0 takes the place of the frontier node, the others are appended
+		for (size_t i = 0; i < aSubtrees.size(); ++i)
+		{
+			std::vector<BuildNode> &aLocal = aSubtreeNodes[i];
+			uint32_t offset = uint32_t(aNodes.size()) - 1, iRoot = aSubtrees[i].node;
+			auto remap = [&](uint32_t k) { return k == 0 ? iRoot : offset + k; };
+			for (BuildNode &node : aLocal)
+			{
+				if (node.count == 0)
+				{
+					node.left = remap(node.left);
+					node.right = remap(node.right);
+				}
+			}
+			aNodes[iRoot] = aLocal[0];
+			aNodes.insert(aNodes.end(), aLocal.begin() + 1, aLocal.end());
+			std::vector<BuildNode>().swap(aLocal);
+		}
+		return aNodes;
+	}
+
+	// Computes the bounds of m_aPrims[begin, end) and partitions it at its best binned SAH split;
+	// returns the split position, or `begin` if the range should stay a leaf
+	uint32_t split(uint32_t begin, uint32_t end, Bounds &bounds, unsigned int nThreads)
+	{
+		uint32_t count = end - begin;
+		size_t nChunks = nThreads > 1 ? (count + CHUNK - 1) / CHUNK : 1;
+		auto chunkRange = [&](size_t iChunk, uint32_t &first, uint32_t &last) {
+			first = begin + uint32_t(iChunk * count / nChunks);
+			last = begin + uint32_t((iChunk + 1) * count / nChunks);
+		};
+
+		// node and centroid bounds; small ranges skip the per-chunk storage
+		auto measure = [&](uint32_t first, uint32_t last, Bounds &b, Bounds &c) {
+			for (uint32_t i = first; i < last; ++i)
+			{
+				const Bounds &prim = m_aPrims[i].bounds;
+				b.grow(prim);
+				c.grow((prim.min + prim.max) * 0.5f);
+			}
+		};
+		Bounds centroids;
+		bounds = Bounds();
+		if (nChunks == 1)
+		{
+			measure(begin, end, bounds, centroids);
+		}
+		else
+		{
+			std::vector<Bounds> aChunkBounds(nChunks), aChunkCentroids(nChunks);
+			utils::parallelFor(nChunks, nThreads, [&](size_t iChunk) {
+				uint32_t first, last;
+				chunkRange(iChunk, first, last);
+				measure(first, last, aChunkBounds[iChunk], aChunkCentroids[iChunk]);
+			});
+			for (size_t i = 0; i < nChunks; ++i)
+			{
+				bounds.grow(aChunkBounds[i]);
+				centroids.grow(aChunkCentroids[i]);
+			}
+		}
+		// a leaf tests up to four triangles at the cost of one
+		if (count <= MAX_LEAF_SIZE)
+			return begin;
+
+		// bin centroids along all three axes
+		glm::vec3 extent = centroids.max - centroids.min;
+		glm::vec3 binScale(0.f);
+		for (int axis = 0; axis < 3; ++axis)
+			binScale[axis] = extent[axis] > 0.f ? BINS * (1.f - 1e-5f) / extent[axis] : 0.f;
+		auto bin = [&](uint32_t first, uint32_t last, Bin *aBins) {
+			for (uint32_t i = first; i < last; ++i)
+			{
+				const PrimRef &prim = m_aPrims[i];
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					Bin &b = aBins[axis * BINS + binIndex(prim.centroid(axis), centroids.min[axis], binScale[axis])];
+					b.bounds.grow(prim.bounds);
+					++b.count;
+				}
+			}
+		};
+		Bin aBins[3 * BINS];
+		if (nChunks == 1)
+		{
+			bin(begin, end, aBins);
+		}
+		else
+		{
+			std::vector<Bin> aChunkBins(nChunks * 3 * BINS);
+			utils::parallelFor(nChunks, nThreads, [&](size_t iChunk) {
+				uint32_t first, last;
+				chunkRange(iChunk, first, last);
+				bin(first, last, &aChunkBins[iChunk * 3 * BINS]);
+			});
+			for (size_t iChunk = 0; iChunk < nChunks; ++iChunk)
+			{
+				for (int i = 0; i < 3 * BINS; ++i)
+				{
+					aBins[i].bounds.grow(aChunkBins[iChunk * 3 * BINS + i].bounds);
+					aBins[i].count += aChunkBins[iChunk * 3 * BINS + i].count;
+				}
+			}
+		}
+
+		// sweep for the cheapest split, counting triangles in leaf-sized groups
+		auto groups = [](uint32_t n) { return float((n + MAX_LEAF_SIZE - 1) / MAX_LEAF_SIZE); };
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1, bestBin = 0;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (binScale[axis] == 0.f)
+				continue;
+			const Bin *aAxisBins = &aBins[axis * BINS];
+			float aRightCost[BINS];
+			Bounds right;
+			uint32_t nRight = 0;
+			for (int i = BINS - 1; i > 0; --i)
+			{
+				right.grow(aAxisBins[i].bounds);
+				nRight += aAxisBins[i].count;
+				aRightCost[i] = nRight ? right.area() * groups(nRight) : 0.f;
+			}
+			Bounds left;
+			uint32_t nLeft = 0;
+			for (int i = 0; i < BINS - 1; ++i)
+			{
+				left.grow(aAxisBins[i].bounds);
+				nLeft += aAxisBins[i].count;
+				if (nLeft == 0 || nLeft == count)
+					continue;
+				float cost = left.area() * groups(nLeft) + aRightCost[i + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = i;
+				}
+			}
+		}
+
+		// coincident centroids: split by count
+		if (bestAxis < 0)
+			return begin + count / 2;
+
+		float minC = centroids.min[bestAxis], scale = binScale[bestAxis];
+		PrimRef *pMid = std::partition(m_aPrims.data() + begin, m_aPrims.data() + end, [&](const PrimRef &prim) {
+			return binIndex(prim.centroid(bestAxis), minC, scale) <= bestBin;
+		});
+		return uint32_t(pMid - m_aPrims.data());
+	}
+
+	static int binIndex(float c, float minC, float scale)
+	{
+		return std::min(BINS - 1, int((c - minC) * scale));
+	}
+
+	// Collapses the binary subtree at `iNode` into 4-wide nodes: children with the largest
+	// surface area are opened until four remain; returns the index of the new node
+	int32_t collapse(const std::vector<BuildNode> &aNodes, uint32_t iNode, const std::vector<Mesh> &meshes, int depth)
+	{
+		m_depth = std::max(m_depth, depth);
+		uint32_t aChildren[4];
+		int n = 0;
+		if (aNodes[iNode].count > 0)
+		{
+			aChildren[n++] = iNode;
+		}
+		else
+		{
+			aChildren[n++] = aNodes[iNode].left;
+			aChildren[n++] = aNodes[iNode].right;
+			while (n < 4)
+			{
+				int iOpen = -1;
+				float maxArea = -1.f;
+				for (int k = 0; k < n; ++k)
+				{
+					const BuildNode &child = aNodes[aChildren[k]];
+					if (child.count == 0 && child.bounds.area() > maxArea)
+					{
+						maxArea = child.bounds.area();
+						iOpen = k;
+					}
+				}
+				if (iOpen < 0)
+					break;
+				uint32_t iOpened = aChildren[iOpen];
+				aChildren[iOpen] = aNodes[iOpened].left;
+				aChildren[n++] = aNodes[iOpened].right;
+			}
+		}
+
+		int32_t index = int32_t(m_aNodes.size());
+		m_aNodes.emplace_back();
+		Node4 node = {};
+		node.count = n;
+		for (int k = 0; k < n; ++k)
+		{
+			const BuildNode &child = aNodes[aChildren[k]];
+			node.minX[k] = child.bounds.min.x; node.maxX[k] = child.bounds.max.x;
+			node.minY[k] = child.bounds.min.y; node.maxY[k] = child.bounds.max.y;
+			node.minZ[k] = child.bounds.min.z; node.maxZ[k] = child.bounds.max.z;
+			node.child[k] = child.count > 0 ? ~packLeaf(child, meshes) : collapse(aNodes, aChildren[k], meshes, depth + 1);
+		}
+		m_aNodes[index] = node;
+		return index;
+	}
+
+	int32_t packLeaf(const BuildNode &leaf, const std::vector<Mesh> &meshes)
+	{
+		Tri4 tri = {};
+		for (uint32_t k = 0; k < leaf.count; ++k)
+		{
+			uint32_t iTri = m_aPrims[leaf.first + k].id;
+			glm::vec3 v0 = vertex(meshes, iTri, 0), e1 = vertex(meshes, iTri, 1) - v0, e2 = vertex(meshes, iTri, 2) - v0;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				tri.v0[axis][k] = v0[axis];
+				tri.e1[axis][k] = e1[axis];
+				tri.e2[axis][k] = e2[axis];
+			}
+			tri.id[k] = iTri;
+		}
+		m_aTris.push_back(tri);
+		return int32_t(m_aTris.size() - 1);
+	}
+
+	std::vector<Node4> m_aNodes;		// m_aNodes[0] is the root
+	std::vector<Tri4> m_aTris;
+	std::vector<uint32_t> m_aMeshOffsets = { 0 };	// first global triangle of each mesh, then the total
+	Bounds m_bounds;
+	int m_depth = 0;
+
+	// build state, released once the tree is done
+	std::vector<PrimRef> m_aPrims;
+};
+
+
+#endif // MESH_BVH_H
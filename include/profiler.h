@@ -0,0 +1,334 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include "imgui.h"
+
+#include "gl/draw_stats.h"
+#include "utils/task_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// Frame profiler: CPU and GPU time per named pass, GL counters and a rolling frame-time history.
+// GPU times come from GL_TIME_ELAPSED queries in two alternating sets, so a set is read back two
+// frames after it was issued instead of stalling on the current one. Queries cannot nest, so
+// passes are sequential: beginning a pass ends the previous one.
+class FrameProfiler
+{
+public:
+	static const int MAX_PASSES = 16;
+	static const int HISTORY = 256;
+
+	struct FrameRecord
+	{
+		uint64_t frame = 0;
+		float frameMs = 0.f;
+		float cpuMs[MAX_PASSES] = {};
+		float gpuMs[MAX_PASSES] = {};	// negative until the query result is read back
+		unsigned int drawCalls = 0;
+		unsigned int stateChanges = 0;
+	};
+
+	FrameProfiler() = default;
+	FrameProfiler(const FrameProfiler&) = delete;
+	FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+	~FrameProfiler()
+	{
+		release();
+	}
+
+	// Closes the previous frame and starts the next one; call once at the top of the main loop
+	void beginFrame()
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (m_bInFrame)
+		{
+			endPass();
+			FrameRecord& rec = record(m_frame);
+			rec.frameMs = std::chrono::duration<float, std::milli>(now - m_frameStart).count();
+			rec.drawCalls = g_drawStats.drawCalls;
+			rec.stateChanges = g_drawStats.stateChanges;
+			++m_frame;
+		}
+		g_drawStats = DrawStats();
+		m_frameStart = now;
+		m_bInFrame = enabled;
+		if (!enabled)
+		{
+			std::memset(m_bIssued, 0, sizeof(m_bIssued));
+			return;
+		}
+
+		if (m_aQueries[0][0] == 0)
+			glGenQueries(2 * MAX_PASSES, &m_aQueries[0][0]);
+		collectQueries(m_frame % 2);
+
+		FrameRecord& rec = record(m_frame);
+		rec = FrameRecord();
+		rec.frame = m_frame;
+		std::fill(rec.gpuMs, rec.gpuMs + MAX_PASSES, -1.f);
+	}
+
+	void beginPass(const char* name)
+	{
+		if (!m_bInFrame)
+			return;
+		endPass();
+
+		int iPass = passIndex(name);
+		if (iPass < 0)
+			return;
+		m_iActivePass = iPass;
+		m_passStart = std::chrono::steady_clock::now();
+
+		int iSet = m_frame % 2;
+		if (!m_bIssued[iSet][iPass])
+		{
+			glBeginQuery(GL_TIME_ELAPSED, m_aQueries[iSet][iPass]);
+			m_bIssued[iSet][iPass] = true;
+			m_queryFrames[iSet] = m_frame;
+			m_bQueryOpen = true;
+		}
+	}
+
+	void endPass()
+	{
+		if (m_iActivePass < 0)
+			return;
+		if (m_bQueryOpen)
+			glEndQuery(GL_TIME_ELAPSED);
+		record(m_frame).cpuMs[m_iActivePass] +=
+			std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_passStart).count();
+		m_iActivePass = -1;
+		m_bQueryOpen = false;
+	}
+
+	// RAII pass for blocks with several exits
+	struct Scope
+	{
+		Scope(FrameProfiler& profiler, const char* name) : m_profiler(profiler) { m_profiler.beginPass(name); }
+		~Scope() { m_profiler.endPass(); }
+		FrameProfiler& m_profiler;
+	};
+
+	// HUD window; the last frame whose GPU timings are complete is two frames back
+	void drawGui()
+	{
+		if (!enabled)
+			return;
+		ImGui::SetNextWindowBgAlpha(0.75f);
+		if (!ImGui::Begin("Profiler (F3)", &enabled, ImGuiWindowFlags_AlwaysAutoResize))
+		{
+			ImGui::End();
+			return;
+		}
+
+		if (m_frame < 2)
+		{
+			ImGui::Text("Collecting...");
+			ImGui::End();
+			return;
+		}
+		const FrameRecord& rec = record(m_frame - 2);
+		ImGui::Text("Frame %.2f ms (%.0f fps)", rec.frameMs, rec.frameMs > 0.f ? 1000.f / rec.frameMs : 0.f);
+		ImGui::Text("Draw calls: %u  State changes: %u", rec.drawCalls, rec.stateChanges);
+
+		if (ImGui::BeginTable("passes", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Pass");
+			ImGui::TableSetupColumn("CPU (ms)");
+			ImGui::TableSetupColumn("GPU (ms)");
+			ImGui::TableHeadersRow();
+			for (size_t i = 0; i < m_aPassNames.size(); ++i)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(m_aPassNames[i].c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", rec.cpuMs[i]);
+				ImGui::TableNextColumn();
+				if (rec.gpuMs[i] >= 0.f)
+					ImGui::Text("%.3f", rec.gpuMs[i]);
+				else
+					ImGui::TextDisabled("-");
+			}
+			ImGui::EndTable();
+		}
+
+		drawWorkers();
+
+		// Rolling frame times, oldest first
+		size_t n = std::min<uint64_t>(m_frame, HISTORY);
+		std::vector<float> aFrameMs(n);
+		float sum = 0.f, maxMs = 0.f;
+		for (size_t i = 0; i < n; ++i)
+		{
+			aFrameMs[i] = record(m_frame - n + i).frameMs;
+			sum += aFrameMs[i];
+			maxMs = std::max(maxMs, aFrameMs[i]);
+		}
+		char overlay[64];
+		snprintf(overlay, sizeof(overlay), "avg %.2f ms  max %.2f ms", sum / n, maxMs);
+		ImGui::PlotHistogram("##frametimes", aFrameMs.data(), static_cast<int>(n), 0, overlay, 0.f, maxMs * 1.1f, ImVec2(320.f, 80.f));
+
+		if (ImGui::Button("Dump CSV (F4)"))
+			dumpCsv("profile.csv");
+		ImGui::End();
+	}
+
+	// Writes the rolling history, one row per frame; GPU columns are empty where not yet read back
+	bool dumpCsv(const std::string& path) const
+	{
+		std::ofstream out(path);
+		if (!out)
+		{
+			std::cerr << "[Error] Cannot write profile to " << path << std::endl;
+			return false;
+		}
+		out << "frame,frame_ms,draw_calls,state_changes";
+		for (auto& name : m_aPassNames)
+			out << "," << name << "_cpu_ms," << name << "_gpu_ms";
+		out << "\n";
+
+		size_t n = std::min<uint64_t>(m_frame, HISTORY);
+		for (size_t i = 0; i < n; ++i)
+		{
+			const FrameRecord& rec = record(m_frame - n + i);
+			out << rec.frame << "," << rec.frameMs << "," << rec.drawCalls << "," << rec.stateChanges;
+			for (size_t p = 0; p < m_aPassNames.size(); ++p)
+			{
+				out << "," << rec.cpuMs[p] << ",";
+				if (rec.gpuMs[p] >= 0.f)
+					out << rec.gpuMs[p];
+			}
+			out << "\n";
+		}
+		std::cout << "Profile of " << n << " frames written to " << path << std::endl;
+		return true;
+	}
+
+	void release()
+	{
+		if (m_aQueries[0][0] == 0)
+			return;
+		glDeleteQueries(2 * MAX_PASSES, &m_aQueries[0][0]);
+		std::memset(m_aQueries, 0, sizeof(m_aQueries));
+	}
+
+	bool enabled = false;
+
+private:
+	// Scheduler workers: share of the last half second spent running tasks, tasks run and stolen
+	// since start, and what waits in each queue by priority; the last row is the shared queue
+	void drawWorkers()
+	{
+		auto now = std::chrono::steady_clock::now();
+		float elapsedUs = std::chrono::duration<float, std::micro>(now - m_workerSampleTime).count();
+		if (m_aWorkerStats.empty() || elapsedUs >= 5e5f)
+		{
+			std::vector<utils::TaskScheduler::WorkerStats> aStats = utils::scheduler().stats();
+			m_aWorkerBusy.assign(aStats.size(), 0.f);
+			for (size_t i = 0; i < aStats.size() && i < m_aWorkerStats.size(); ++i)
+				m_aWorkerBusy[i] = std::min((aStats[i].busyUs - m_aWorkerStats[i].busyUs) / elapsedUs, 1.f);
+			m_aWorkerStats = aStats;
+			m_workerSampleTime = now;
+		}
+
+		if (!ImGui::BeginTable("workers", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+			return;
+		ImGui::TableSetupColumn("Worker");
+		ImGui::TableSetupColumn("Busy");
+		ImGui::TableSetupColumn("Run");
+		ImGui::TableSetupColumn("Stolen");
+		ImGui::TableSetupColumn("Queued I/N/B");
+		ImGui::TableHeadersRow();
+		for (size_t i = 0; i < m_aWorkerStats.size(); ++i)
+		{
+			const utils::TaskScheduler::WorkerStats &w = m_aWorkerStats[i];
+			bool bShared = i + 1 == m_aWorkerStats.size();
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (bShared)
+				ImGui::TextUnformatted("shared");
+			else
+				ImGui::Text("%zu", i);
+			ImGui::TableNextColumn();
+			if (bShared)
+				ImGui::TextDisabled("-");
+			else
+				ImGui::Text("%.0f%%", m_aWorkerBusy[i] * 100.f);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)w.executed);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)w.stolen);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu/%zu/%zu", w.aQueued[utils::TaskPriority_Interactive], w.aQueued[utils::TaskPriority_Normal], 
+				w.aQueued[utils::TaskPriority_Background]);
+		}
+		ImGui::EndTable();
+	}
+
+	FrameRecord& record(uint64_t frame) { return m_aRecords[frame % HISTORY]; }
+	const FrameRecord& record(uint64_t frame) const { return m_aRecords[frame % HISTORY]; }
+
+	int passIndex(const char* name)
+	{
+		for (size_t i = 0; i < m_aPassNames.size(); ++i)
+			if (m_aPassNames[i] == name)
+				return static_cast<int>(i);
+		if (m_aPassNames.size() == MAX_PASSES)
+			return -1;
+		m_aPassNames.push_back(name);
+		return static_cast<int>(m_aPassNames.size() - 1);
+	}
+
+	// Reads back the set about to be reused; results still pending are dropped
+	void collectQueries(int iSet)
+	{
+		FrameRecord& rec = record(m_queryFrames[iSet]);
+		for (int i = 0; i < MAX_PASSES; ++i)
+		{
+			if (!m_bIssued[iSet][i])
+				continue;
+			m_bIssued[iSet][i] = false;
+			GLint available = 0;
+			glGetQueryObjectiv(m_aQueries[iSet][i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available || rec.frame != m_queryFrames[iSet])
+				continue;
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(m_aQueries[iSet][i], GL_QUERY_RESULT, &ns);
+			rec.gpuMs[i] = ns * 1e-6f;
+		}
+	}
+
+	std::vector<std::string> m_aPassNames;
+	FrameRecord m_aRecords[HISTORY];
+	uint64_t m_frame = 0;
+	bool m_bInFrame = false;
+
+	int m_iActivePass = -1;
+	bool m_bQueryOpen = false;
+	std::chrono::steady_clock::time_point m_frameStart, m_passStart;
+
+	std::vector<utils::TaskScheduler::WorkerStats> m_aWorkerStats;
+	std::vector<float> m_aWorkerBusy;
+	std::chrono::steady_clock::time_point m_workerSampleTime;
+
+	GLuint m_aQueries[2][MAX_PASSES] = {};
+	bool m_bIssued[2][MAX_PASSES] = {};
+	uint64_t m_queryFrames[2] = {};
+};
+
+
+#endif // PROFILER_H
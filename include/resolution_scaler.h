@@ -0,0 +1,47 @@
+#ifndef RESOLUTION_SCALER_H
+#define RESOLUTION_SCALER_H
+
+#include <algorithm>
+#include <cmath>
+
+
+// Dynamic resolution for the 3D panes: while the camera moves, the render scale follows the
+// smoothed frame time towards `budgetMs`; when it stops, full resolution is requested so the
+// pane can be re-rendered sharp. Only frames spent moving feed the average, as idle frames
+// are cheap blits of a cached pane.
+class ResolutionScaler
+{
+public:
+	// Scale to render this frame at, from the duration of the previous one
+	float update(float frameMs, bool bMoving)
+	{
+		if (!bEnabled || !bMoving)
+			return 1.f;
+		m_avgMs = m_avgMs > 0.f ? m_avgMs + (frameMs - m_avgMs) * 0.2f : frameMs;
+
+		// the cost is mostly fill, so it goes with the pixel count, i.e. scale squared
+		if (m_avgMs > budgetMs * 1.1f || m_avgMs < budgetMs * 0.7f)
+		{
+			float target = m_scale * std::sqrt(budgetMs / std::max(m_avgMs, 0.1f));
+			m_scale = std::min(std::max(m_scale + (target - m_scale) * 0.25f, minScale), 1.f);
+		}
+		// coarse steps, so the target size does not change every frame
+		return std::round(m_scale * STEPS) / STEPS;
+	}
+
+	// Current moving scale, for display
+	float scale() const { return m_scale; }
+
+	bool bEnabled = true;
+	float budgetMs = 33.3f;
+	float minScale = 0.35f;
+
+private:
+	static constexpr float STEPS = 20.f;
+
+	float m_scale = 1.f;
+	float m_avgMs = 0.f;
+};
+
+
+#endif // RESOLUTION_SCALER_H
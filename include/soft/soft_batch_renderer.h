@@ -0,0 +1,201 @@
+#ifndef SOFT_BATCH_RENDERER_H
+#define SOFT_BATCH_RENDERER_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "data_manager.h"
+#include "camera.h"
+#include "gl/render_manager.h"
+#include "soft/soft_rasterizer.h"
+#include "utils/image_writer.h"
+#include "utils/parallel_utils.h"
+#include "utils/photo_utils.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+// BatchRenderer on the CPU: the same images and file names, drawn by soft::Rasterizer, so QA
+// runs on machines without any OpenGL driver. The model is lit per vertex with the model.fs
+// terms and rendered once per project, as its camera does not depend on the view.
+class SoftBatchRenderer
+{
+public:
+	static const int NUM_CAMERA = 24;	// lights in model.fs
+
+	SoftBatchRenderer(ImageWriter &writer, int maxSize = 1024) :
+		m_writer(writer),
+		m_maxSize(maxSize)
+	{
+	}
+
+	// Writes <outDir>/view_XX_landmarks.png and view_XX_model.png for every view
+	void renderProject(DataManager &dataManager, const std::filesystem::path &outDir)
+	{
+		TRACE_SCOPE("SoftBatchRenderer::renderProject");
+		std::filesystem::create_directories(outDir);
+
+		m_modelRaster.resize(m_maxSize, m_maxSize * 3 / 4);
+		Camera cam;
+		m_mViewProj = glm::perspective(glm::radians(cam.Zoom), float(m_modelRaster.width) / m_modelRaster.height, 0.1f, 5000.0f)
+			* cam.GetViewMatrix();
+		renderMesh(dataManager, cam.Position);
+
+		for (unsigned int iView = 0; iView < dataManager.getFaces() && iView < dataManager.getTextures().size(); ++iView)
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "view_%02u", iView);
+			std::string sPrefix = (outDir / name).string();
+			renderLandmarks(dataManager, iView, sPrefix + "_landmarks.png");
+			renderModel(dataManager, iView, sPrefix + "_model.png");
+		}
+	}
+
+private:
+	void renderLandmarks(DataManager &dataManager, unsigned int iView, const std::string &path)
+	{
+		TRACE_SCOPE("SoftBatchRenderer::renderLandmarks");
+		const Texture &tex = dataManager.getTextures()[iView];
+		float faceWidth = dataManager.getWidth(), faceHeight = dataManager.getHeight();
+		const std::vector<float> &photoPts = dataManager.getLandmarkCoordsSets()[iView];
+		std::vector<float> scrPts = photo_utils::PhotoPts2ScrPts(photoPts, faceHeight, faceWidth, k_aRotTypes[iView]);
+
+		float scale = m_maxSize / std::max(faceWidth, faceHeight);
+		m_photoRaster.resize(int(faceHeight * scale), int(faceWidth * scale));
+		m_photoRaster.clear(glm::vec4(0.f, 0.f, 0.f, 1.f));
+		glm::mat4 viewProj = glm::ortho(-1.f, 1.f, -1.f, 1.f, 0.1f, 100.f)
+			* glm::lookAt(glm::vec3(0.f, 0.f, 5.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+
+		const float pointSize = 0.004f;
+		for (size_t i = 0; i < photoPts.size() / 2; ++i)
+		{
+			if (photoPts[i * 2] == 0.f && photoPts[i * 2 + 1] == 0.f) continue;
+			glm::mat4 quadModel = glm::translate(glm::mat4(1.f), glm::vec3(scrPts[i * 2], scrPts[i * 2 + 1], 0.f));
+			quadModel = glm::scale(quadModel, glm::vec3(pointSize * faceWidth / faceHeight, pointSize, 1.1f));
+			drawQuad(m_photoRaster, viewProj * quadModel, RotateType_No, glm::vec4(1.f, 0.f, 0.f, 1.f), nullptr);
+		}
+
+		// the texture must outlive the flush; a missing photo stays black as with GL
+		std::optional<soft::Texture2D> photo;
+		if (tex.data)
+		{
+			photo.emplace(tex.data, tex.width, tex.height, tex.channels);
+			drawQuad(m_photoRaster, viewProj, k_aRotTypes[iView], glm::vec4(1.f), &*photo);
+		}
+		m_photoRaster.flush();
+		readBack(m_photoRaster, path);
+	}
+
+	void renderModel(DataManager &dataManager, unsigned int iView, const std::string &path)
+	{
+		TRACE_SCOPE("SoftBatchRenderer::renderModel");
+		m_modelRaster.restore(m_meshSnapshot);
+
+		double invF = 1. / dataManager.getF();
+		double faceWidth = dataManager.getWidth(), faceHeight = dataManager.getHeight();
+		const std::vector<float> &photoPts = dataManager.getLandmarkCoordsSets()[iView];
+		glm::mat4 mvp = m_mViewProj * glm::make_mat4(dataManager.getInvTransMatrices()[iView].data());
+		glm::vec4 origin = mvp * glm::vec4(0.f, 0.f, 0.f, 1.f);
+		const float strength = 200.f;	// line.vs
+		for (size_t i = 0; i < photoPts.size() / 2; ++i)
+		{
+			if (photoPts[i * 2] == 0.f && photoPts[i * 2 + 1] == 0.f) continue;
+			float x = (photoPts[i * 2] - faceWidth * 0.5 - dataManager.getCx()) * invF;
+			float y = (photoPts[i * 2 + 1] - faceHeight * 0.5 - dataManager.getCy()) * invF;
+			m_modelRaster.drawLine(origin, mvp * glm::vec4(x * strength, y * strength, strength, 1.f), glm::vec4(1.f));
+		}
+		m_modelRaster.flush();
+		readBack(m_modelRaster, path);
+	}
+
+	// Rasterizes the lit mesh into m_meshSnapshot
+	void renderMesh(DataManager &dataManager, const glm::vec3 &viewPos)
+	{
+		TRACE_SCOPE("SoftBatchRenderer::renderMesh");
+		m_modelRaster.clear(glm::vec4(0.f, 0.f, 0.f, 1.f));
+
+		// unset lightPosArr entries are zero in GL too
+		glm::vec3 aLights[NUM_CAMERA] = {};
+		const std::vector<Eigen::Vector3f> &aCamPositions = dataManager.getCamPositions();
+		for (size_t i = 0; i < aCamPositions.size() && i < NUM_CAMERA; ++i)
+			aLights[i] = glm::vec3(aCamPositions[i].x(), aCamPositions[i].y(), aCamPositions[i].z());
+
+		std::vector<soft::Vertex> aVertices;
+		for (const Mesh &mesh : dataManager.getModel()->meshes)
+		{
+			aVertices.resize(mesh.vertices.size());
+			const size_t CHUNK = 4096;
+			utils::parallelFor((aVertices.size() + CHUNK - 1) / CHUNK, utils::hardwareThreads(), [&](size_t iChunk) {
+				for (size_t i = iChunk * CHUNK; i < std::min(aVertices.size(), (iChunk + 1) * CHUNK); ++i)
+				{
+					const Vertex &v = mesh.vertices[i];
+					aVertices[i].clip = m_mViewProj * glm::vec4(v.position_, 1.f);
+					aVertices[i].color = glm::vec4(shade(v.position_, v.normal_, glm::vec3(v.color_), aLights, viewPos), 1.f);
+					aVertices[i].uv = glm::vec2(0.f);
+				}
+			});
+			m_modelRaster.drawTriangles(aVertices, mesh.indices);
+		}
+		m_modelRaster.flush();
+		m_modelRaster.save(m_meshSnapshot);
+	}
+
+	// model.fs, averaged over its fixed number of point lights
+	static glm::vec3 shade(const glm::vec3 &pos, const glm::vec3 &normal, const glm::vec3 &color, const glm::vec3 *aLights, const glm::vec3 &viewPos)
+	{
+		glm::vec3 norm = glm::normalize(normal);
+		glm::vec3 viewDir = glm::normalize(viewPos - pos);
+		float light = 0.f;
+		for (int i = 0; i < NUM_CAMERA; ++i)
+		{
+			glm::vec3 lightDir = glm::normalize(aLights[i] - pos);
+			float diff = std::max(glm::dot(norm, lightDir), 0.f);
+			glm::vec3 reflectDir = glm::reflect(-lightDir, norm);
+			float spec = std::pow(std::max(glm::dot(viewDir, reflectDir), 0.f), 32.f);
+			light += 0.2f + diff + 0.4f * spec;
+		}
+		return light / NUM_CAMERA * color;
+	}
+
+	// RenderManager::RenderQuad with quad.vs/quad.fs: `color` is PureColor, or modulates `texture`
+	static void drawQuad(soft::Rasterizer &raster, const glm::mat4 &mvp, RotateType rotateType, const glm::vec4 &color, const soft::Texture2D *texture)
+	{
+		static const std::vector<unsigned int> aStripIndices = { 0, 1, 2, 2, 1, 3 };
+		static const std::vector<unsigned int> aListIndices = { 0, 1, 2, 3, 4, 5 };
+		int first = rotateType == RotateType_CW ? 4 : rotateType == RotateType_CCW ? 10 : 0;
+		int count = rotateType == RotateType_No ? 4 : 6;
+
+		std::vector<soft::Vertex> aVertices(count);
+		for (int i = 0; i < count; ++i)
+		{
+			const float *v = &RenderManager::k_aQuadVertices[(first + i) * 5];
+			aVertices[i] = { mvp * glm::vec4(v[0], v[1], v[2], 1.f), color, glm::vec2(v[3], v[4]) };
+		}
+		raster.drawTriangles(aVertices, rotateType == RotateType_No ? aStripIndices : aListIndices, texture);
+	}
+
+	void readBack(const soft::Rasterizer &raster, const std::string &path)
+	{
+		std::vector<uint8_t> pixels;
+		raster.readRgb(pixels);
+		m_writer.write(path, raster.width, raster.height, 3, std::move(pixels), true);
+	}
+
+	ImageWriter &m_writer;
+	int m_maxSize;
+	glm::mat4 m_mViewProj = glm::mat4(1.f);
+	soft::Rasterizer m_photoRaster;
+	soft::Rasterizer m_modelRaster;
+	soft::Rasterizer::Snapshot m_meshSnapshot;
+};
+
+
+#endif // SOFT_BATCH_RENDERER_H
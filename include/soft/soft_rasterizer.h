@@ -0,0 +1,465 @@
+#ifndef SOFT_RASTERIZER_H
+#define SOFT_RASTERIZER_H
+
+#include <glm/glm.hpp>
+
+#include <emmintrin.h>	// SSE2, part of the x86-64 baseline
+
+#include "utils/parallel_utils.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace soft
+{
+
+
+// RGBA8 texture with a box-filtered mip chain, sampled bilinearly with GL_REPEAT wrapping.
+// Row 0 is t = 0, as for data passed to glTexImage2D.
+class Texture2D
+{
+public:
+	Texture2D(const unsigned char *data, int width, int height, int channels)
+	{
+		std::vector<uint32_t> level(size_t(width) * height);
+		for (size_t i = 0; i < level.size(); ++i)
+		{
+			const unsigned char *p = data + i * channels;
+			uint32_t r = p[0], g = channels > 1 ? p[1] : r, b = channels > 2 ? p[2] : r, a = channels > 3 ? p[3] : 255;
+			level[i] = r | (g << 8) | (b << 16) | (a << 24);
+		}
+		m_aLevels.push_back({ width, height, std::move(level) });
+
+		while (width > 1 || height > 1)
+		{
+			const Level &src = m_aLevels.back();
+			int w = std::max(width / 2, 1), h = std::max(height / 2, 1);
+			Level dst{ w, h, std::vector<uint32_t>(size_t(w) * h) };
+			for (int y = 0; y < h; ++y)
+			{
+				int y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+				for (int x = 0; x < w; ++x)
+				{
+					int x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+					uint32_t texels[4] = { src.texel(x0, y0), src.texel(x1, y0), src.texel(x0, y1), src.texel(x1, y1) };
+					uint32_t out = 0;
+					for (int c = 0; c < 32; c += 8)
+					{
+						uint32_t sum = 2;
+						for (uint32_t t : texels)
+							sum += (t >> c) & 0xff;
+						out |= (sum / 4) << c;
+					}
+					dst.texels[size_t(y) * w + x] = out;
+				}
+			}
+			m_aLevels.push_back(std::move(dst));
+			width = w;
+			height = h;
+		}
+	}
+
+	int levels() const { return static_cast<int>(m_aLevels.size()); }
+	int width() const { return m_aLevels[0].width; }
+	int height() const { return m_aLevels[0].height; }
+
+	glm::vec4 sample(float u, float v, int iLevel) const
+	{
+		const Level &level = m_aLevels[std::min(std::max(iLevel, 0), levels() - 1)];
+		float x = u * level.width - 0.5f, y = v * level.height - 0.5f;
+		float xf = std::floor(x), yf = std::floor(y);
+		float fx = x - xf, fy = y - yf;
+		int x0 = wrap(int(xf), level.width), x1 = wrap(int(xf) + 1, level.width);
+		int y0 = wrap(int(yf), level.height), y1 = wrap(int(yf) + 1, level.height);
+		glm::vec4 top = unpack(level.texel(x0, y0)) * (1.f - fx) + unpack(level.texel(x1, y0)) * fx;
+		glm::vec4 bottom = unpack(level.texel(x0, y1)) * (1.f - fx) + unpack(level.texel(x1, y1)) * fx;
+		return top * (1.f - fy) + bottom * fy;
+	}
+
+private:
+	struct Level
+	{
+		int width, height;
+		std::vector<uint32_t> texels;
+		uint32_t texel(int x, int y) const { return texels[size_t(y) * width + x]; }
+	};
+
+	static int wrap(int i, int n) { i %= n; return i < 0 ? i + n : i; }
+	static glm::vec4 unpack(uint32_t t)
+	{
+		return glm::vec4(float(t & 0xff), float((t >> 8) & 0xff), float((t >> 16) & 0xff), float(t >> 24)) / 255.f;
+	}
+
+	std::vector<Level> m_aLevels;
+};
+
+
+// Post-vertex-shader input: clip-space position and the attributes to interpolate
+struct Vertex
+{
+	glm::vec4 clip;
+	glm::vec4 color;
+	glm::vec2 uv;
+};
+
+
+// Tile-based triangle rasterizer following GL conventions: clip-space input, near-plane
+// clipping, pixel centers at +0.5, top-left fill rule, GL_LESS depth test, no culling and
+// perspective-correct attributes. Draws are only set up and queued; flush() bins the
+// triangles into 64x64 tiles and rasterizes tiles in parallel, four pixels at a time with SSE
+// edge functions. Triangles keep their submission order within a tile, so results are
+// deterministic. Rows are stored bottom-up, like the default framebuffer.
+class Rasterizer
+{
+public:
+	static const int TILE_SIZE = 64;
+
+	explicit Rasterizer(unsigned int nThreads = utils::hardwareThreads())
+		: m_nThreads(nThreads)
+	{
+	}
+
+	void resize(int w, int h)
+	{
+		width = w;
+		height = h;
+		m_stride = (w + 3) & ~3;	// whole SSE groups per row
+		m_aColor.assign(size_t(m_stride) * h, 0);
+		m_aDepth.assign(size_t(m_stride) * h, 1.f);
+		m_nTilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+		m_nTilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+		m_aTris.clear();
+	}
+
+	void clear(const glm::vec4 &color)
+	{
+		std::fill(m_aColor.begin(), m_aColor.end(), pack(color));
+		std::fill(m_aDepth.begin(), m_aDepth.end(), 1.f);
+		m_aTris.clear();
+	}
+
+	// Color and depth, to render a shared background once and draw per-image overlays on top
+	struct Snapshot
+	{
+		std::vector<uint32_t> color;
+		std::vector<float> depth;
+	};
+
+	void save(Snapshot &snapshot) const
+	{
+		snapshot.color = m_aColor;
+		snapshot.depth = m_aDepth;
+	}
+
+	void restore(const Snapshot &snapshot)
+	{
+		m_aColor = snapshot.color;
+		m_aDepth = snapshot.depth;
+		m_aTris.clear();
+	}
+
+	// Queues an indexed triangle list; `texture` multiplies the interpolated color when set
+	void drawTriangles(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, const Texture2D *texture = nullptr)
+	{
+		TRACE_SCOPE("Rasterizer::drawTriangles");
+		const size_t nTris = indices.size() / 3;
+		const size_t CHUNK = 16384;
+		const size_t nChunks = (nTris + CHUNK - 1) / CHUNK;
+		std::vector<std::vector<Triangle>> aChunkTris(nChunks);
+		utils::parallelFor(nChunks, m_nThreads, [&](size_t iChunk) {
+			for (size_t t = iChunk * CHUNK; t < std::min(nTris, (iChunk + 1) * CHUNK); ++t)
+				setupClipTriangle(vertices[indices[t * 3]], vertices[indices[t * 3 + 1]], vertices[indices[t * 3 + 2]], texture, aChunkTris[iChunk]);
+		});
+		for (auto &tris : aChunkTris)
+			m_aTris.insert(m_aTris.end(), tris.begin(), tris.end());
+	}
+
+	// Queues a line as a screen-aligned quad `lineWidth` pixels wide
+	void drawLine(const glm::vec4 &clip0, const glm::vec4 &clip1, const glm::vec4 &color, float lineWidth = 1.5f)
+	{
+		glm::vec4 a = clip0, b = clip1;
+		float da = a.z + a.w, db = b.z + b.w;	// distance to the near plane
+		if (da < 0.f && db < 0.f)
+			return;
+		if (da < 0.f)
+			a = a + (b - a) * (da / (da - db));
+		else if (db < 0.f)
+			b = b + (a - b) * (db / (db - da));
+
+		ScreenVertex sa = toScreen({ a, color, glm::vec2(0.f) }), sb = toScreen({ b, color, glm::vec2(0.f) });
+		glm::vec2 d(sb.x - sa.x, sb.y - sa.y);
+		float len = glm::length(d);
+		if (len < 1e-6f)
+			return;
+		glm::vec2 n = glm::vec2(-d.y, d.x) * (0.5f * lineWidth / len);
+		ScreenVertex q[4] = { sa, sa, sb, sb };
+		q[0].x -= n.x; q[0].y -= n.y;
+		q[1].x += n.x; q[1].y += n.y;
+		q[2].x += n.x; q[2].y += n.y;
+		q[3].x -= n.x; q[3].y -= n.y;
+		setupScreenTriangle(q[0], q[1], q[2], nullptr, m_aTris);
+		setupScreenTriangle(q[0], q[2], q[3], nullptr, m_aTris);
+	}
+
+	// Rasterizes everything queued since the last flush
+	void flush()
+	{
+		TRACE_SCOPE("Rasterizer::flush");
+		const size_t nTiles = size_t(m_nTilesX) * m_nTilesY;
+		const size_t nBins = std::max<size_t>(1, std::min<size_t>(m_nThreads, (m_aTris.size() + 4095) / 4096));
+		const size_t binChunk = (m_aTris.size() + nBins - 1) / nBins;
+
+		// Each binning task covers a contiguous range of triangles, so reading the bins in task
+		// order keeps the submission order
+		std::vector<std::vector<std::vector<uint32_t>>> aBins(nBins, std::vector<std::vector<uint32_t>>(nTiles));
+		utils::parallelFor(nBins, m_nThreads, [&](size_t iBin) {
+			for (size_t t = iBin * binChunk; t < std::min(m_aTris.size(), (iBin + 1) * binChunk); ++t)
+			{
+				const Triangle &tri = m_aTris[t];
+				for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ++ty)
+					for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; ++tx)
+						aBins[iBin][size_t(ty) * m_nTilesX + tx].push_back(static_cast<uint32_t>(t));
+			}
+		});
+
+		utils::parallelFor(nTiles, m_nThreads, [&](size_t iTile) {
+			int tileX0 = int(iTile % m_nTilesX) * TILE_SIZE, tileY0 = int(iTile / m_nTilesX) * TILE_SIZE;
+			int tileX1 = std::min(tileX0 + TILE_SIZE, width) - 1, tileY1 = std::min(tileY0 + TILE_SIZE, height) - 1;
+			for (auto &bins : aBins)
+				for (uint32_t t : bins[iTile])
+					rasterize(m_aTris[t], tileX0, tileY0, tileX1, tileY1);
+		});
+		m_aTris.clear();
+	}
+
+	// Tightly packed RGB rows, bottom-up like glReadPixels
+	void readRgb(std::vector<uint8_t> &out) const
+	{
+		out.resize(size_t(width) * height * 3);
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				uint32_t c = m_aColor[size_t(y) * m_stride + x];
+				uint8_t *p = &out[(size_t(y) * width + x) * 3];
+				p[0] = c & 0xff;
+				p[1] = (c >> 8) & 0xff;
+				p[2] = (c >> 16) & 0xff;
+			}
+		}
+	}
+
+	// Tightly packed window-space depth, bottom-up like glReadPixels(GL_DEPTH_COMPONENT)
+	void readDepth(std::vector<float> &out) const
+	{
+		out.resize(size_t(width) * height);
+		for (int y = 0; y < height; ++y)
+			std::copy_n(&m_aDepth[size_t(y) * m_stride], width, &out[size_t(y) * width]);
+	}
+
+	int width = 0;
+	int height = 0;
+
+private:
+	// Window coordinates; attributes are premultiplied by 1/w for perspective correction
+	struct ScreenVertex
+	{
+		float x, y, z, invW;
+		glm::vec4 color;
+		glm::vec2 uv;
+	};
+
+	struct Triangle
+	{
+		ScreenVertex v[3];
+		const Texture2D *texture;
+		int mipLevel;
+		int minX, minY, maxX, maxY;
+	};
+
+	static uint32_t pack(const glm::vec4 &c)
+	{
+		auto channel = [](float f) { return uint32_t(std::min(std::max(f, 0.f), 1.f) * 255.f + 0.5f); };
+		return channel(c.x) | (channel(c.y) << 8) | (channel(c.z) << 16) | (channel(c.w) << 24);
+	}
+
+	ScreenVertex toScreen(const Vertex &v) const
+	{
+		float invW = 1.f / v.clip.w;
+		ScreenVertex s;
+		s.x = (v.clip.x * invW * 0.5f + 0.5f) * width;
+		s.y = (v.clip.y * invW * 0.5f + 0.5f) * height;
+		s.z = v.clip.z * invW * 0.5f + 0.5f;
+		s.invW = invW;
+		s.color = v.color * invW;
+		s.uv = v.uv * invW;
+		return s;
+	}
+
+	// Clips against the near plane (z >= -w) and sets up the resulting one or two triangles
+	void setupClipTriangle(const Vertex &v0, const Vertex &v1, const Vertex &v2, const Texture2D *texture, std::vector<Triangle> &out) const
+	{
+		const Vertex *in[3] = { &v0, &v1, &v2 };
+		float d[3];
+		int nInside = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			d[i] = in[i]->clip.z + in[i]->clip.w;
+			nInside += d[i] >= 0.f;
+		}
+		if (nInside == 0)
+			return;
+		if (nInside == 3)
+		{
+			setupScreenTriangle(toScreen(v0), toScreen(v1), toScreen(v2), texture, out);
+			return;
+		}
+
+		Vertex poly[4];
+		int n = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			const Vertex &a = *in[i], &b = *in[(i + 1) % 3];
+			float da = d[i], db = d[(i + 1) % 3];
+			if (da >= 0.f)
+				poly[n++] = a;
+			if ((da >= 0.f) != (db >= 0.f))
+			{
+				float t = da / (da - db);
+				poly[n++] = { a.clip + (b.clip - a.clip) * t, a.color + (b.color - a.color) * t, a.uv + (b.uv - a.uv) * t };
+			}
+		}
+		for (int i = 1; i + 1 < n; ++i)
+			setupScreenTriangle(toScreen(poly[0]), toScreen(poly[i]), toScreen(poly[i + 1]), texture, out);
+	}
+
+	void setupScreenTriangle(ScreenVertex a, ScreenVertex b, ScreenVertex c, const Texture2D *texture, std::vector<Triangle> &out) const
+	{
+		float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+		if (!(std::abs(area) > 1e-8f))	// also drops NaNs
+			return;
+		if (area < 0.f)
+			std::swap(b, c);
+
+		Triangle tri;
+		tri.v[0] = a;
+		tri.v[1] = b;
+		tri.v[2] = c;
+		tri.texture = texture;
+		tri.minX = std::max(0, int(std::floor(std::min({ a.x, b.x, c.x }))));
+		tri.minY = std::max(0, int(std::floor(std::min({ a.y, b.y, c.y }))));
+		tri.maxX = std::min(width - 1, int(std::ceil(std::max({ a.x, b.x, c.x }))));
+		tri.maxY = std::min(height - 1, int(std::ceil(std::max({ a.y, b.y, c.y }))));
+		if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+			return;
+
+		// One mip level per triangle from its texel-to-pixel area ratio, enough for the
+		// photo quads, which are drawn without perspective
+		tri.mipLevel = 0;
+		if (texture)
+		{
+			glm::vec2 uv0 = a.uv / a.invW, uv1 = b.uv / b.invW, uv2 = c.uv / c.invW;
+			float texArea = std::abs((uv1.x - uv0.x) * (uv2.y - uv0.y) - (uv2.x - uv0.x) * (uv1.y - uv0.y))
+				* texture->width() * texture->height();
+			float lod = 0.5f * std::log2(std::max(texArea / std::abs(area), 1e-8f));
+			tri.mipLevel = std::max(0, int(lod + 0.5f));
+		}
+		out.push_back(tri);
+	}
+
+	void rasterize(const Triangle &tri, int tileX0, int tileY0, int tileX1, int tileY1)
+	{
+		int x0 = std::max(tri.minX, tileX0) & ~3, x1 = std::min(tri.maxX, tileX1);
+		int y0 = std::max(tri.minY, tileY0), y1 = std::min(tri.maxY, tileY1);
+		if (x0 > x1 || y0 > y1)
+			return;
+
+		// Edge i is opposite vertex i: E(p) = A * x + B * y + C, positive inside
+		const ScreenVertex *v = tri.v;
+		float A[3], B[3], C[3];
+		bool bTopLeft[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			const ScreenVertex &p = v[(i + 1) % 3], &q = v[(i + 2) % 3];
+			A[i] = p.y - q.y;
+			B[i] = q.x - p.x;
+			C[i] = -(A[i] * p.x + B[i] * p.y);
+			bTopLeft[i] = A[i] > 0.f || (A[i] == 0.f && B[i] < 0.f);
+		}
+		float invArea = 1.f / (C[0] + C[1] + C[2]);
+
+		const __m128 xOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		__m128 vA[3];
+		for (int i = 0; i < 3; ++i)
+			vA[i] = _mm_set1_ps(A[i]);
+		const __m128 vZ0 = _mm_set1_ps(v[0].z), vDz1 = _mm_set1_ps(v[1].z - v[0].z), vDz2 = _mm_set1_ps(v[2].z - v[0].z);
+		const __m128 vInvArea = _mm_set1_ps(invArea);
+		const __m128i vWidth = _mm_set1_epi32(width);
+		const __m128i laneX = _mm_setr_epi32(0, 1, 2, 3);
+
+		for (int y = y0; y <= y1; ++y)
+		{
+			float py = y + 0.5f;
+			float* depthRow = &m_aDepth[size_t(y) * m_stride];
+			uint32_t* colorRow = &m_aColor[size_t(y) * m_stride];
+			for (int x = x0; x <= x1; x += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps(float(x)), xOffsets);
+				__m128 e[3];
+				__m128 mask = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_add_epi32(_mm_set1_epi32(x), laneX), vWidth));
+				for (int i = 0; i < 3; ++i)
+				{
+					e[i] = _mm_add_ps(_mm_mul_ps(vA[i], px), _mm_set1_ps(B[i] * py + C[i]));
+					mask = _mm_and_ps(mask, bTopLeft[i] ? _mm_cmpge_ps(e[i], zero) : _mm_cmpgt_ps(e[i], zero));
+				}
+				if (_mm_movemask_ps(mask) == 0)
+					continue;
+
+				// Barycentric weights of vertices 1 and 2; depth is affine in window space
+				__m128 w1 = _mm_mul_ps(e[1], vInvArea), w2 = _mm_mul_ps(e[2], vInvArea);
+				__m128 z = _mm_add_ps(vZ0, _mm_add_ps(_mm_mul_ps(w1, vDz1), _mm_mul_ps(w2, vDz2)));
+				__m128 depth = _mm_loadu_ps(depthRow + x);
+				mask = _mm_and_ps(mask, _mm_cmplt_ps(z, depth));
+				int bits = _mm_movemask_ps(mask);
+				if (bits == 0)
+					continue;
+				_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, depth)));
+
+				alignas(16) float aW1[4], aW2[4];
+				_mm_store_ps(aW1, w1);
+				_mm_store_ps(aW2, w2);
+				for (int k = 0; k < 4; ++k)
+				{
+					if (!(bits & (1 << k)))
+						continue;
+					float b1 = aW1[k], b2 = aW2[k], b0 = 1.f - b1 - b2;
+					float w = 1.f / (b0 * v[0].invW + b1 * v[1].invW + b2 * v[2].invW);
+					glm::vec4 color = (v[0].color * b0 + v[1].color * b1 + v[2].color * b2) * w;
+					if (tri.texture)
+					{
+						glm::vec2 uv = (v[0].uv * b0 + v[1].uv * b1 + v[2].uv * b2) * w;
+						color *= tri.texture->sample(uv.x, uv.y, tri.mipLevel);
+					}
+					colorRow[x + k] = pack(color);
+				}
+			}
+		}
+	}
+
+	unsigned int m_nThreads;
+	int m_stride = 0;
+	int m_nTilesX = 0;
+	int m_nTilesY = 0;
+	std::vector<uint32_t> m_aColor;	// RGBA8, m_stride texels per row
+	std::vector<float> m_aDepth;
+	std::vector<Triangle> m_aTris;
+};
+
+
+}
+
+#endif // SOFT_RASTERIZER_H
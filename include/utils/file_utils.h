@@ -1,6 +1,8 @@
 #ifndef FILE_UTILS_H
 #define FILE_UTILS_H
 
+#include <cstdint>
+#include <filesystem>
 #include <string>
 
 namespace file_utils
@@ -18,6 +20,26 @@ namespace file_utils
 		return std::stoi(str);
 	}
 
+	// Size and modification time of a file, which the caches derived from it are checked against;
+	// both stay 0 if it cannot be read
+	struct FileStamp
+	{
+		uint64_t size = 0;
+		int64_t time = 0;
+	};
+
+	static FileStamp Stamp(const std::string &path)
+	{
+		FileStamp stamp;
+		std::error_code ec;
+		uint64_t size = std::filesystem::file_size(path, ec);
+		if (ec)
+			return stamp;
+		stamp.size = size;
+		stamp.time = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+		return stamp;
+	}
+
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace utils
+{
+
+
+// Reports files written, created or moved into watched directories, through inotify on Linux
+// and not at all elsewhere. Events are coalesced per file and a file is only reported once it
+// has been quiet for a while, so a writer still busy with it is not read halfway. Nothing
+// blocks: poll() is meant to be called once per frame from the render loop.
+class FileWatcher
+{
+public:
+	FileWatcher()
+	{
+#ifdef __linux__
+		m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+	}
+
+	~FileWatcher()
+	{
+#ifdef __linux__
+		if (m_fd >= 0)
+			close(m_fd);
+#endif
+	}
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	bool available() const { return m_fd >= 0; }
+
+	// Files are reported as `dir` + "/" + name; watch a file through its directory, which also
+	// catches writers that replace it by renaming a temporary over it
+	bool watch(const std::string &dir)
+	{
+#ifdef __linux__
+		if (m_fd < 0)
+			return false;
+		int wd = inotify_add_watch(m_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE);
+		if (wd < 0)
+			return false;
+		m_aDirs[wd] = dir;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	// Paths with no event in the last `quietMs`, each once however many events it had
+	std::vector<std::string> poll(int quietMs = 300)
+	{
+		auto now = std::chrono::steady_clock::now();
+#ifdef __linux__
+		alignas(inotify_event) char buffer[4096];
+		ssize_t n;
+		while (m_fd >= 0 && (n = read(m_fd, buffer, sizeof(buffer))) > 0)
+		{
+			for (char *p = buffer; p < buffer + n; p += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(p)->len)
+			{
+				const inotify_event *e = reinterpret_cast<const inotify_event*>(p);
+				auto itDir = m_aDirs.find(e->wd);
+				if (e->len == 0 || (e->mask & IN_ISDIR) || itDir == m_aDirs.end())
+					continue;
+				m_aPending[itDir->second + "/" + e->name] = now;
+			}
+		}
+#endif
+		std::vector<std::string> aReady;
+		for (auto it = m_aPending.begin(); it != m_aPending.end(); )
+		{
+			if (now - it->second < std::chrono::milliseconds(quietMs))
+			{
+				++it;
+				continue;
+			}
+			aReady.push_back(it->first);
+			it = m_aPending.erase(it);
+		}
+		return aReady;
+	}
+
+private:
+	int m_fd = -1;
+	std::unordered_map<int, std::string> m_aDirs;	// by watch descriptor
+	std::map<std::string, std::chrono::steady_clock::time_point> m_aPending;	// last event per path
+};
+
+
+}
+
+#endif // FILE_WATCHER_H
@@ -0,0 +1,130 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "stb_image_write.h"
+
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Encodes and writes PNG files on a pool of threads, so the renderer only pays for the
+// read-back. The queue is bounded: write() blocks while `maxQueued` images are pending,
+// which caps the memory held by frames waiting for an encoder.
+class ImageWriter
+{
+public:
+	explicit ImageWriter(unsigned int nThreads = std::max(2u, std::thread::hardware_concurrency()) - 1, size_t maxQueued = 16)
+		: m_maxQueued(maxQueued)
+	{
+		for (unsigned int i = 0; i < nThreads; ++i)
+			m_aThreads.emplace_back([this, i]() { run(i); });
+	}
+
+	ImageWriter(const ImageWriter&) = delete;
+	ImageWriter& operator=(const ImageWriter&) = delete;
+
+	~ImageWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStop = true;
+		}
+		m_cvWork.notify_all();
+		for (auto& t : m_aThreads)
+			t.join();
+	}
+
+	// Queues tightly packed pixels for `path`; rows are bottom-up as read from GL when `bFlipY`
+	void write(const std::string& path, int width, int height, int channels, std::vector<uint8_t> pixels, bool bFlipY)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cvSpace.wait(lock, [this]() { return m_jobs.size() < m_maxQueued; });
+		m_jobs.push_back({ path, width, height, channels, bFlipY, std::move(pixels) });
+		++m_nPending;
+		lock.unlock();
+		m_cvWork.notify_one();
+	}
+
+	// Blocks until every queued image is written; returns the number of failures so far
+	size_t wait()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cvDone.wait(lock, [this]() { return m_nPending == 0; });
+		return m_nFailed;
+	}
+
+private:
+	struct Job
+	{
+		std::string path;
+		int width, height, channels;
+		bool bFlipY;
+		std::vector<uint8_t> pixels;
+	};
+
+	void run(unsigned int iThread)
+	{
+		trace_utils::setThreadName("image writer " + std::to_string(iThread));
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cvWork.wait(lock, [this]() { return m_bStop || !m_jobs.empty(); });
+				if (m_jobs.empty())
+					return;
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+			m_cvSpace.notify_one();
+
+			bool bOk;
+			{
+				TRACE_SCOPE("Encode PNG");
+				size_t rowBytes = size_t(job.width) * job.channels;
+				if (job.bFlipY)
+				{
+					std::vector<uint8_t> row(rowBytes);
+					for (int y = 0; y < job.height / 2; ++y)
+					{
+						uint8_t* top = &job.pixels[y * rowBytes];
+						uint8_t* bottom = &job.pixels[(job.height - 1 - y) * rowBytes];
+						std::memcpy(row.data(), top, rowBytes);
+						std::memcpy(top, bottom, rowBytes);
+						std::memcpy(bottom, row.data(), rowBytes);
+					}
+				}
+				bOk = stbi_write_png(job.path.c_str(), job.width, job.height, job.channels, job.pixels.data(), int(rowBytes)) != 0;
+			}
+			if (!bOk)
+				std::cerr << "[Error] Failed to write " << job.path << std::endl;
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_nFailed += !bOk;
+			if (--m_nPending == 0)
+				m_cvDone.notify_all();
+		}
+	}
+
+	std::vector<std::thread> m_aThreads;
+	std::deque<Job> m_jobs;
+	size_t m_maxQueued;
+	size_t m_nPending = 0;
+	size_t m_nFailed = 0;
+	bool m_bStop = false;
+	std::mutex m_mutex;
+	std::condition_variable m_cvWork, m_cvSpace, m_cvDone;
+};
+
+
+#endif // IMAGE_WRITER_H
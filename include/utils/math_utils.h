@@ -7,6 +7,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cmath>
+#include <limits>
+
 namespace utils
 {
 
@@ -35,6 +38,43 @@ Eigen::Matrix<T, 4, 4> scale(const Eigen::Matrix<T, 4, 4>& m, T sx, T sy, T sz)
 }
 
 
+// Casts a ray from window coordinates (origin at top-left) through the inverse of `proj * view`.
+// Returns the ray origin on the near plane and its normalized direction in world space.
+inline void unproject(float xWin, float yWin, float width, float height,
+    const glm::mat4& proj, const glm::mat4& view,
+    Eigen::Vector3f& origin, Eigen::Vector3f& dir)
+{
+    glm::mat4 invProjView = glm::inverse(proj * view);
+    float xNdc = 2.f * xWin / width - 1.f;
+    float yNdc = 1.f - 2.f * yWin / height;
+    glm::vec4 nearPt = invProjView * glm::vec4(xNdc, yNdc, -1.f, 1.f);
+    glm::vec4 farPt = invProjView * glm::vec4(xNdc, yNdc, 1.f, 1.f);
+    nearPt /= nearPt.w;
+    farPt /= farPt.w;
+    origin = Eigen::Vector3f(nearPt.x, nearPt.y, nearPt.z);
+    dir = (Eigen::Vector3f(farPt.x, farPt.y, farPt.z) - origin).normalized();
+}
+
+
+// Intersects a world-space ray with a quad spanning [-1, 1] x [-1, 1] on the plane z = zQuad
+// of its local frame, where `invModel` maps world space into that frame.
+// On hit, `t` holds the distance along the ray, which an affine transform preserves.
+template <typename T>
+bool intersectQuad(const Eigen::Matrix<T, 4, 4>& invModel, 
+    const Eigen::Matrix<T, 3, 1>& origin, const Eigen::Matrix<T, 3, 1>& dir, T zQuad, T& t)
+{
+    Eigen::Matrix<T, 3, 1> o = invModel.template block<3, 3>(0, 0) * origin + invModel.template block<3, 1>(0, 3);
+    Eigen::Matrix<T, 3, 1> d = invModel.template block<3, 3>(0, 0) * dir;
+    if (std::abs(d.z()) < std::numeric_limits<T>::epsilon())
+        return false;
+    t = (zQuad - o.z()) / d.z();
+    if (t <= T(0))
+        return false;
+    Eigen::Matrix<T, 3, 1> p = o + t * d;
+    return std::abs(p.x()) <= T(1) && std::abs(p.y()) <= T(1);
+}
+
+
 } 
 
 
@@ -0,0 +1,253 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace mesh_utils
+{
+
+
+// Average cache miss ratio (transformed vertices per triangle) of a FIFO post-transform cache
+inline float computeAcmr(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16)
+{
+	if (indices.empty())
+		return 0.f;
+	std::vector<unsigned int> stamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	size_t misses = 0;
+	for (unsigned int v : indices)
+	{
+		if (time - stamps[v] > cacheSize)
+		{
+			stamps[v] = time++;
+			++misses;
+		}
+	}
+	return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+
+// Reorders triangles for post-transform cache reuse (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+inline void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	const int CACHE_SIZE = 32;
+	const size_t nTris = indices.size() / 3;
+	if (nTris == 0)
+		return;
+
+	auto vertexScore = [&](int cachePos, unsigned int valence) {
+		if (valence == 0)
+			return -1.f;
+		float score = 0.f;
+		if (cachePos >= 0)
+			score = cachePos < 3 ? 0.75f : std::pow(1.f - float(cachePos - 3) / (CACHE_SIZE - 3), 1.5f);
+		return score + 2.f / std::sqrt(static_cast<float>(valence));
+	};
+
+	// Live triangles per vertex (CSR, shrinking as triangles are emitted)
+	std::vector<unsigned int> valence(vertexCount, 0), adjOffsets(vertexCount + 1, 0), adjTris(nTris * 3);
+	for (size_t i = 0; i < nTris * 3; ++i)
+		++valence[indices[i]];
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjOffsets[v + 1] = adjOffsets[v] + valence[v];
+	{
+		std::vector<unsigned int> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+		for (size_t i = 0; i < nTris * 3; ++i)
+			adjTris[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<int> cachePos(vertexCount, -1);
+	std::vector<float> vScore(vertexCount), tScore(nTris);
+	std::vector<char> emitted(nTris, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		vScore[v] = vertexScore(-1, valence[v]);
+	for (size_t t = 0; t < nTris; ++t)
+		tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+
+	std::vector<unsigned int> result;
+	result.reserve(nTris * 3);
+	std::vector<unsigned int> cache, newCache;
+	size_t nextUnemitted = 0;
+	size_t best = std::max_element(tScore.begin(), tScore.end()) - tScore.begin();
+
+	while (true)
+	{
+		if (best == SIZE_MAX)
+		{
+			while (nextUnemitted < nTris && emitted[nextUnemitted])
+				++nextUnemitted;
+			if (nextUnemitted == nTris)
+				break;
+			best = nextUnemitted;
+		}
+
+		const unsigned int* tri = &indices[best * 3];
+		emitted[best] = 1;
+		result.insert(result.end(), tri, tri + 3);
+
+		// Drop the triangle from its vertices' live lists
+		for (int k = 0; k < 3; ++k)
+		{
+			unsigned int v = tri[k];
+			unsigned int* begin = &adjTris[adjOffsets[v]];
+			unsigned int* end = begin + valence[v];
+			*std::find(begin, end, static_cast<unsigned int>(best)) = end[-1];
+			--valence[v];
+		}
+
+		// New LRU cache: the triangle's vertices first, then the previous contents
+		newCache.assign(tri, tri + 3);
+		for (unsigned int v : cache)
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache.push_back(v);
+		for (size_t i = CACHE_SIZE; i < newCache.size(); ++i)
+		{
+			cachePos[newCache[i]] = -1;
+			vScore[newCache[i]] = vertexScore(-1, valence[newCache[i]]);
+		}
+		if (newCache.size() > size_t(CACHE_SIZE))
+			newCache.resize(CACHE_SIZE);
+		cache.swap(newCache);
+
+		// Rescore cached vertices and their live triangles, remembering the best one
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			cachePos[cache[i]] = static_cast<int>(i);
+			vScore[cache[i]] = vertexScore(static_cast<int>(i), valence[cache[i]]);
+		}
+		best = SIZE_MAX;
+		float bestScore = -1.f;
+		for (unsigned int v : cache)
+		{
+			for (unsigned int a = adjOffsets[v]; a < adjOffsets[v] + valence[v]; ++a)
+			{
+				unsigned int t = adjTris[a];
+				tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+				if (tScore[t] > bestScore)
+				{
+					bestScore = tScore[t];
+					best = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+
+// Reorders clusters of a cache-optimized index buffer so outward-facing surfaces tend to be
+// drawn first, reducing overdraw without breaking cache locality inside a cluster.
+// Clusters start wherever the FIFO cache simulation misses all three vertices of a triangle.
+inline void optimizeOverdraw(std::vector<unsigned int>& indices, const float* positions, size_t vertexCount,
+	size_t strideBytes, unsigned int cacheSize = 16)
+{
+	auto pos = [&](unsigned int v) -> glm::vec3 {
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * strideBytes);
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+	const size_t nTris = indices.size() / 3;
+	if (nTris == 0)
+		return;
+
+	std::vector<size_t> clusterStarts;
+	std::vector<unsigned int> stamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	for (size_t t = 0; t < nTris; ++t)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			unsigned int v = indices[t * 3 + k];
+			if (time - stamps[v] > cacheSize)
+			{
+				stamps[v] = time++;
+				++misses;
+			}
+		}
+		if (t == 0 || misses == 3)
+			clusterStarts.push_back(t);
+	}
+	clusterStarts.push_back(nTris);
+
+	// Area-weighted centroid and normal per cluster
+	struct Cluster
+	{
+		size_t begin, end;
+		glm::vec3 centroid, normal;
+		float sortKey;
+	};
+	std::vector<Cluster> clusters;
+	glm::vec3 meshCentroid(0.f);
+	float meshArea = 0.f;
+	for (size_t c = 0; c + 1 < clusterStarts.size(); ++c)
+	{
+		Cluster cl{ clusterStarts[c], clusterStarts[c + 1], glm::vec3(0.f), glm::vec3(0.f), 0.f };
+		float area = 0.f;
+		for (size_t t = cl.begin; t < cl.end; ++t)
+		{
+			glm::vec3 p0 = pos(indices[t * 3]), p1 = pos(indices[t * 3 + 1]), p2 = pos(indices[t * 3 + 2]);
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float a = glm::length(n);
+			cl.normal += n;
+			cl.centroid += (p0 + p1 + p2) * (a / 3.f);
+			area += a;
+		}
+		if (area > 0.f)
+			cl.centroid = cl.centroid / area;
+		meshCentroid += cl.centroid * area;
+		meshArea += area;
+		clusters.push_back(cl);
+	}
+	if (meshArea > 0.f)
+		meshCentroid = meshCentroid / meshArea;
+
+	for (auto& cl : clusters)
+	{
+		float len = glm::length(cl.normal);
+		cl.sortKey = len > 0.f ? glm::dot(cl.centroid - meshCentroid, cl.normal / len) : 0.f;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const Cluster& l, const Cluster& r) { return l.sortKey > r.sortKey; });
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (auto& cl : clusters)
+		result.insert(result.end(), indices.begin() + cl.begin * 3, indices.begin() + cl.end * 3);
+	indices.swap(result);
+}
+
+
+// Reorders vertices by first use in the index buffer for fetch locality and remaps the indices;
+// unreferenced vertices are moved to the end
+template <typename V>
+void optimizeVertexFetch(std::vector<V>& vertices, std::vector<unsigned int>& indices)
+{
+	const unsigned int UNUSED = ~0u;
+	std::vector<unsigned int> remap(vertices.size(), UNUSED);
+	unsigned int next = 0;
+	for (unsigned int& v : indices)
+	{
+		if (remap[v] == UNUSED)
+			remap[v] = next++;
+		v = remap[v];
+	}
+	for (auto& r : remap)
+		if (r == UNUSED)
+			r = next++;
+
+	std::vector<V> reordered(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+		reordered[remap[i]] = vertices[i];
+	vertices.swap(reordered);
+}
+
+
+}
+
+#endif // MESH_OPTIMIZE_H
@@ -0,0 +1,263 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace mesh_utils
+{
+
+
+// Symmetric 4x4 error quadric (Garland & Heckbert), stored as its upper triangle plus the
+// accumulated area weight, so that evaluate() returns a mean squared distance.
+struct Quadric
+{
+	double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+	double a11 = 0, a12 = 0, a13 = 0;
+	double a22 = 0, a23 = 0;
+	double a33 = 0;
+	double w = 0;
+
+	static Quadric fromPlane(double a, double b, double c, double d, double weight)
+	{
+		Quadric q;
+		q.a00 = weight * a * a; q.a01 = weight * a * b; q.a02 = weight * a * c; q.a03 = weight * a * d;
+		q.a11 = weight * b * b; q.a12 = weight * b * c; q.a13 = weight * b * d;
+		q.a22 = weight * c * c; q.a23 = weight * c * d;
+		q.a33 = weight * d * d;
+		q.w = weight;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric& o)
+	{
+		a00 += o.a00; a01 += o.a01; a02 += o.a02; a03 += o.a03;
+		a11 += o.a11; a12 += o.a12; a13 += o.a13;
+		a22 += o.a22; a23 += o.a23;
+		a33 += o.a33;
+		w += o.w;
+		return *this;
+	}
+
+	double evaluate(const glm::vec3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double e = a00 * x * x + a11 * y * y + a22 * z * z + a33
+			+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z + a03 * x + a13 * y + a23 * z);
+		return w > 0 ? std::max(e, 0.0) / w : 0.0;
+	}
+};
+
+
+struct SimplifyLevel
+{
+	std::vector<unsigned int> indices;
+	// root of the largest collapse cost so far: an area-weighted RMS distance from the original
+	// surface of the worst collapse, in position units, not a bound on the max distance
+	float error;
+};
+
+
+// Simplifies a triangle mesh by repeated half-edge collapses ordered by quadric error, and
+// snapshots the index buffer each time it falls below the next entry of `targetIndexCounts`
+// (which must be decreasing). Collapses only move vertices onto existing ones, so every level
+// indexes the original vertex buffer. Border and non-manifold edges are kept intact.
+// Stops early once no collapse is possible, so fewer levels than targets may be returned.
+inline std::vector<SimplifyLevel> simplify(const float* positions, size_t vertexCount, size_t strideBytes,
+	const std::vector<unsigned int>& indices, const std::vector<size_t>& targetIndexCounts)
+{
+	auto pos = [&](unsigned int v) -> glm::vec3 {
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * strideBytes);
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+	auto edgeKey = [](uint64_t a, uint64_t b) { return a < b ? (a << 32) | b : (b << 32) | a; };
+
+	std::vector<SimplifyLevel> levels;
+	std::vector<unsigned int> tris = indices;
+
+	// Per-vertex quadrics from area-weighted face planes
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t + 2 < tris.size(); t += 3)
+	{
+		glm::vec3 p0 = pos(tris[t]), p1 = pos(tris[t + 1]), p2 = pos(tris[t + 2]);
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float len = glm::length(n);
+		if (len <= 0.f)
+			continue;
+		n = n / len;
+		Quadric q = Quadric::fromPlane(n.x, n.y, n.z, -glm::dot(n, p0), 0.5 * len);
+		quadrics[tris[t]] += q;
+		quadrics[tris[t + 1]] += q;
+		quadrics[tris[t + 2]] += q;
+	}
+
+	// Lock vertices on borders (edge used once) and non-manifold edges (used more than twice)
+	std::vector<char> locked(vertexCount, 0);
+	{
+		std::vector<uint64_t> edges;
+		edges.reserve(tris.size());
+		for (size_t t = 0; t + 2 < tris.size(); t += 3)
+			for (int k = 0; k < 3; ++k)
+				edges.push_back(edgeKey(tris[t + k], tris[t + (k + 1) % 3]));
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t j = i;
+			while (j < edges.size() && edges[j] == edges[i])
+				++j;
+			if (j - i != 2)
+			{
+				locked[edges[i] >> 32] = 1;
+				locked[edges[i] & 0xffffffffu] = 1;
+			}
+			i = j;
+		}
+	}
+
+	struct Collapse
+	{
+		double cost;
+		unsigned int from;
+		unsigned int to;
+	};
+
+	std::vector<unsigned int> adjOffsets(vertexCount + 1), adjTris;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<char> touched(vertexCount);
+	std::vector<uint64_t> edges;
+	std::vector<Collapse> collapses;
+	double maxError = 0.0;
+
+	for (size_t iTarget = 0; iTarget < targetIndexCounts.size(); )
+	{
+		size_t target = targetIndexCounts[iTarget];
+		if (tris.size() <= target)
+		{
+			levels.push_back({ tris, static_cast<float>(std::sqrt(maxError)) });
+			++iTarget;
+			continue;
+		}
+
+		// Vertex -> triangle adjacency of the current mesh (CSR)
+		std::fill(adjOffsets.begin(), adjOffsets.end(), 0);
+		for (unsigned int v : tris)
+			++adjOffsets[v + 1];
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjOffsets[v + 1] += adjOffsets[v];
+		adjTris.resize(tris.size());
+		{
+			std::vector<unsigned int> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+			for (size_t i = 0; i < tris.size(); ++i)
+				adjTris[fill[tris[i]]++] = static_cast<unsigned int>(i / 3);
+		}
+
+		// Candidate collapses, each edge in its cheaper unlocked direction
+		edges.clear();
+		for (size_t t = 0; t + 2 < tris.size(); t += 3)
+			for (int k = 0; k < 3; ++k)
+				edges.push_back(edgeKey(tris[t + k], tris[t + (k + 1) % 3]));
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		collapses.clear();
+		for (uint64_t e : edges)
+		{
+			unsigned int a = static_cast<unsigned int>(e >> 32), b = static_cast<unsigned int>(e & 0xffffffffu);
+			Quadric q = quadrics[a];
+			q += quadrics[b];
+			double costAB = locked[a] ? HUGE_VAL : q.evaluate(pos(b));
+			double costBA = locked[b] ? HUGE_VAL : q.evaluate(pos(a));
+			if (costAB == HUGE_VAL && costBA == HUGE_VAL)
+				continue;
+			if (costAB <= costBA)
+				collapses.push_back({ costAB, a, b });
+			else
+				collapses.push_back({ costBA, b, a });
+		}
+		if (collapses.empty())
+			break;
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+		// Greedy independent collapses; each removes about two triangles
+		for (size_t v = 0; v < vertexCount; ++v)
+			remap[v] = static_cast<unsigned int>(v);
+		std::fill(touched.begin(), touched.end(), 0);
+		size_t trisToRemove = (tris.size() - target) / 3;
+		size_t trisRemoved = 0;
+		size_t nCollapsed = 0;
+
+		for (const Collapse& c : collapses)
+		{
+			if (trisRemoved >= trisToRemove)
+				break;
+			if (touched[c.from] || touched[c.to])
+				continue;
+
+			// Reject collapses that would flip a surviving triangle around `from`
+			glm::vec3 pTo = pos(c.to);
+			bool bFlips = false;
+			size_t nDegenerate = 0;
+			for (unsigned int k = adjOffsets[c.from]; k < adjOffsets[c.from + 1] && !bFlips; ++k)
+			{
+				const unsigned int* tri = &tris[adjTris[k] * 3];
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)
+				{
+					++nDegenerate;
+					continue;
+				}
+				glm::vec3 p[3], q[3];
+				for (int j = 0; j < 3; ++j)
+				{
+					p[j] = pos(tri[j]);
+					q[j] = tri[j] == c.from ? pTo : p[j];
+				}
+				glm::vec3 nBefore = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 nAfter = glm::cross(q[1] - q[0], q[2] - q[0]);
+				bFlips = glm::dot(nBefore, nAfter) <= 0.f;
+			}
+			if (bFlips)
+				continue;
+
+			// Freeze the one-ring so later flip checks in this pass see final positions
+			for (unsigned int k = adjOffsets[c.from]; k < adjOffsets[c.from + 1]; ++k)
+			{
+				const unsigned int* tri = &tris[adjTris[k] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+			touched[c.to] = 1;
+
+			remap[c.from] = c.to;
+			quadrics[c.to] += quadrics[c.from];
+			maxError = std::max(maxError, c.cost);
+			trisRemoved += nDegenerate;
+			++nCollapsed;
+		}
+		if (nCollapsed == 0)
+			break;
+
+		// Apply the remap and drop triangles that collapsed to a line or point
+		size_t nWrite = 0;
+		for (size_t t = 0; t + 2 < tris.size(); t += 3)
+		{
+			unsigned int a = remap[tris[t]], b = remap[tris[t + 1]], c = remap[tris[t + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			tris[nWrite++] = a;
+			tris[nWrite++] = b;
+			tris[nWrite++] = c;
+		}
+		tris.resize(nWrite);
+	}
+
+	return levels;
+}
+
+
+}
+
+#endif // MESH_SIMPLIFY_H
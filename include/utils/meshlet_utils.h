@@ -0,0 +1,216 @@
+#ifndef MESHLET_UTILS_H
+#define MESHLET_UTILS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace mesh_utils
+{
+
+
+// A cluster of triangles stored as a contiguous range of the index buffer, with
+// bounds for CPU culling: a bounding sphere and a cone containing all face normals
+struct Meshlet
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneAxis;
+	float coneCutoff;	// 1 disables cone culling
+};
+
+
+// Splits the triangles into meshlets of at most `maxVertices` unique vertices and `maxTriangles`
+// triangles, growing each one across shared vertices, then rewrites `indices` so every meshlet
+// is a contiguous range. Triangles keep their relative input order inside a meshlet.
+inline std::vector<Meshlet> buildMeshlets(const float* positions, size_t vertexCount, size_t strideBytes,
+	std::vector<unsigned int>& indices, size_t maxVertices = 64, size_t maxTriangles = 124)
+{
+	auto pos = [&](unsigned int v) -> glm::vec3 {
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * strideBytes);
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+
+	const size_t nTris = indices.size() / 3;
+
+	// Vertex -> triangle adjacency (CSR)
+	std::vector<unsigned int> adjOffsets(vertexCount + 1, 0), adjTris(nTris * 3);
+	for (size_t i = 0; i < nTris * 3; ++i)
+		++adjOffsets[indices[i] + 1];
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjOffsets[v + 1] += adjOffsets[v];
+	{
+		std::vector<unsigned int> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+		for (size_t i = 0; i < nTris * 3; ++i)
+			adjTris[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> reordered;
+	reordered.reserve(nTris * 3);
+	std::vector<char> emitted(nTris, 0);
+	std::vector<unsigned int> meshletVerts, meshletTris, candidates;
+
+	auto newVertexCount = [&](unsigned int t) {
+		int n = 0;
+		for (int k = 0; k < 3; ++k)
+			n += std::find(meshletVerts.begin(), meshletVerts.end(), indices[t * 3 + k]) == meshletVerts.end();
+		return n;
+	};
+
+	for (size_t seed = 0; seed < nTris; ++seed)
+	{
+		if (emitted[seed])
+			continue;
+
+		meshletVerts.clear();
+		meshletTris.clear();
+		glm::vec3 vertSum(0.f);
+		candidates.assign(1, static_cast<unsigned int>(seed));
+
+		while (meshletTris.size() < maxTriangles)
+		{
+			// Among the first few live candidates, take the one adding the fewest vertices,
+			// breaking ties by distance to the meshlet centroid to keep clusters compact
+			const size_t SCAN = 64;
+			glm::vec3 centroid = meshletVerts.empty() ? glm::vec3(0.f) : vertSum / static_cast<float>(meshletVerts.size());
+			size_t iBest = SIZE_MAX;
+			int bestNew = 4;
+			float bestDist = std::numeric_limits<float>::max();
+			for (size_t i = 0, nScanned = 0; i < candidates.size() && nScanned < SCAN; )
+			{
+				unsigned int t = candidates[i];
+				if (emitted[t])
+				{
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				int n = newVertexCount(t);
+				glm::vec3 d = (pos(indices[t * 3]) + pos(indices[t * 3 + 1]) + pos(indices[t * 3 + 2])) / 3.f - centroid;
+				float dist = glm::dot(d, d);
+				if (n < bestNew || (n == bestNew && dist < bestDist))
+				{
+					bestNew = n;
+					bestDist = dist;
+					iBest = i;
+				}
+				++i;
+				++nScanned;
+			}
+			if (iBest == SIZE_MAX || meshletVerts.size() + bestNew > maxVertices)
+				break;
+
+			unsigned int t = candidates[iBest];
+			candidates[iBest] = candidates.back();
+			candidates.pop_back();
+			emitted[t] = 1;
+			meshletTris.push_back(t);
+			for (int k = 0; k < 3; ++k)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (std::find(meshletVerts.begin(), meshletVerts.end(), v) != meshletVerts.end())
+					continue;
+				meshletVerts.push_back(v);
+				vertSum += pos(v);
+				for (unsigned int a = adjOffsets[v]; a < adjOffsets[v + 1]; ++a)
+					if (!emitted[adjTris[a]])
+						candidates.push_back(adjTris[a]);
+			}
+		}
+
+		// Emit in input order and compute bounds
+		std::sort(meshletTris.begin(), meshletTris.end());
+		Meshlet m;
+		m.indexOffset = static_cast<unsigned int>(reordered.size());
+		m.indexCount = static_cast<unsigned int>(meshletTris.size() * 3);
+
+		glm::vec3 bbMin(std::numeric_limits<float>::max()), bbMax(-std::numeric_limits<float>::max());
+		for (unsigned int v : meshletVerts)
+		{
+			bbMin = glm::min(bbMin, pos(v));
+			bbMax = glm::max(bbMax, pos(v));
+		}
+		m.center = (bbMin + bbMax) * 0.5f;
+		m.radius = 0.f;
+		for (unsigned int v : meshletVerts)
+			m.radius = std::max(m.radius, glm::length(pos(v) - m.center));
+
+		std::vector<glm::vec3> normals;
+		normals.reserve(meshletTris.size());
+		glm::vec3 axis(0.f);
+		for (unsigned int t : meshletTris)
+		{
+			glm::vec3 p0 = pos(indices[t * 3]), p1 = pos(indices[t * 3 + 1]), p2 = pos(indices[t * 3 + 2]);
+			reordered.insert(reordered.end(), { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] });
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float len = glm::length(n);
+			if (len <= 0.f)
+				continue;
+			normals.push_back(n / len);
+			axis += n / len;
+		}
+
+		// Cone cutoff as in meshoptimizer: cull when dot(center - eye, axis) >= cutoff * |center - eye| + radius
+		m.coneAxis = glm::vec3(0.f, 0.f, 1.f);
+		m.coneCutoff = 1.f;
+		float axisLen = glm::length(axis);
+		if (axisLen > 0.f)
+		{
+			axis = axis / axisLen;
+			float minDot = 1.f;
+			for (auto& n : normals)
+				minDot = std::min(minDot, glm::dot(n, axis));
+			if (minDot > 0.1f)
+			{
+				m.coneAxis = axis;
+				m.coneCutoff = std::sqrt(1.f - minDot * minDot);
+			}
+		}
+		meshlets.push_back(m);
+	}
+
+	indices.swap(reordered);
+	return meshlets;
+}
+
+
+// Frustum planes (a, b, c, d) with inward normals, extracted from a projection-view matrix
+inline void extractFrustumPlanes(const glm::mat4& projView, glm::vec4 planes[6])
+{
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; ++i)
+		row[i] = glm::vec4(projView[0][i], projView[1][i], projView[2][i], projView[3][i]);
+	planes[0] = row[3] + row[0];
+	planes[1] = row[3] - row[0];
+	planes[2] = row[3] + row[1];
+	planes[3] = row[3] - row[1];
+	planes[4] = row[3] + row[2];
+	planes[5] = row[3] - row[2];
+	for (int i = 0; i < 6; ++i)
+		planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+}
+
+
+// True if the meshlet is entirely outside the frustum or faces away from the eye
+inline bool cullMeshlet(const Meshlet& m, const glm::vec4 planes[6], const glm::vec3& eye)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		if (glm::dot(glm::vec3(planes[i]), m.center) + planes[i].w < -m.radius)
+			return true;
+	}
+	glm::vec3 toCenter = m.center - eye;
+	return glm::dot(toCenter, m.coneAxis) >= m.coneCutoff * glm::length(toCenter) + m.radius;
+}
+
+
+}
+
+#endif // MESHLET_UTILS_H
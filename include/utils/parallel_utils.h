@@ -0,0 +1,30 @@
+#ifndef PARALLEL_UTILS_H
+#define PARALLEL_UTILS_H
+
+#include "utils/task_scheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace utils
+{
+
+
+inline unsigned int hardwareThreads()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+// Runs fn(iTask) for every task on up to `nThreads` threads, the caller included, drawn from
+// the shared scheduler at the caller's priority
+template <typename F>
+void parallelFor(size_t nTasks, unsigned int nThreads, F fn)
+{
+	scheduler().parallelFor(nTasks, nThreads, fn);
+}
+
+
+}
+
+#endif // PARALLEL_UTILS_H
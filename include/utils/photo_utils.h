@@ -0,0 +1,45 @@
+#ifndef PHOTO_UTILS_H
+#define PHOTO_UTILS_H
+
+#include <glm/glm.hpp>
+
+#include "config.h"
+
+#include <iostream>
+#include <vector>
+
+namespace photo_utils
+{
+
+
+// Photo pixel coordinates to the [-1, 1] square the rotated photo quad is drawn on
+inline glm::vec2 PhotoPt2ScrPt(float xPhoto, float yPhoto, float height, float width, RotateType rotateType)
+{
+	if (rotateType == RotateType_CCW)
+		return glm::vec2(yPhoto / height * 2 - 1.0f, xPhoto / width * 2 - 1.0f);
+	else if (rotateType == RotateType_CW)
+		return glm::vec2(yPhoto / height * 2 - 1.0f, 1.f - xPhoto / width * 2);
+	return glm::vec2(0.f, 0.f);
+}
+
+
+inline std::vector<float> PhotoPts2ScrPts(const std::vector<float>& photoPts, float height, float width, RotateType rotateType)
+{
+	std::vector<float> scrPts;
+	scrPts.reserve(photoPts.size());
+	for (int i = 0; i < photoPts.size() / 2; ++i)
+	{
+		if (rotateType != RotateType_CCW && rotateType != RotateType_CW)
+			std::cerr << "[ERROR] Wrong rotate type at point: " << i << std::endl;
+
+		glm::vec2 scrPt = PhotoPt2ScrPt(photoPts.at(i * 2), photoPts.at(i * 2 + 1), height, width, rotateType);
+		scrPts.push_back(scrPt.x);
+		scrPts.push_back(scrPt.y);
+	}
+	return scrPts;
+}
+
+
+}
+
+#endif // PHOTO_UTILS_H
@@ -0,0 +1,61 @@
+#ifndef PROJECTION_UTILS_H
+#define PROJECTION_UTILS_H
+
+#include <Eigen/Dense>
+
+#include <emmintrin.h>	// SSE2, part of the x86-64 baseline
+
+#include "utils/parallel_utils.h"
+
+#include <vector>
+
+namespace utils
+{
+
+
+// Projects the n points (xs[i], ys[i], zs[i]) through every matrix of `aProj`: aPts[v] gets
+// x0, y0, x1, y1, ... in photo pixels, like the landmark sets, with (0, 0) for a point behind
+// camera v. Four points per SSE step, views on worker threads.
+inline void projectPoints(const std::vector<Eigen::Matrix<float, 3, 4>> &aProj, const float *xs, const float *ys, const float *zs,
+	size_t n, std::vector<std::vector<float>> &aPts)
+{
+	aPts.resize(aProj.size());
+	utils::parallelFor(aProj.size(), utils::hardwareThreads(), [&](size_t iView) {
+		const Eigen::Matrix<float, 3, 4> &P = aProj[iView];
+		std::vector<float> &pts = aPts[iView];
+		pts.resize(n * 2);
+
+		__m128 aRows[3][4];
+		for (int r = 0; r < 3; ++r)
+			for (int c = 0; c < 4; ++c)
+				aRows[r][c] = _mm_set1_ps(P(r, c));
+		const __m128 zero = _mm_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(xs + i), y = _mm_loadu_ps(ys + i), z = _mm_loadu_ps(zs + i);
+			__m128 h[3];
+			for (int r = 0; r < 3; ++r)
+				h[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(aRows[r][0], x), _mm_mul_ps(aRows[r][1], y)),
+					_mm_add_ps(_mm_mul_ps(aRows[r][2], z), aRows[r][3]));
+			__m128 front = _mm_cmpgt_ps(h[2], zero);
+			__m128 inv = _mm_div_ps(_mm_set1_ps(1.f), h[2]);
+			__m128 u = _mm_and_ps(_mm_mul_ps(h[0], inv), front);
+			__m128 v = _mm_and_ps(_mm_mul_ps(h[1], inv), front);
+			_mm_storeu_ps(&pts[i * 2], _mm_unpacklo_ps(u, v));
+			_mm_storeu_ps(&pts[i * 2 + 4], _mm_unpackhi_ps(u, v));
+		}
+		for (; i < n; ++i)
+		{
+			Eigen::Vector3f h = P * Eigen::Vector4f(xs[i], ys[i], zs[i], 1.f);
+			pts[i * 2] = h.z() > 0.f ? h.x() / h.z() : 0.f;
+			pts[i * 2 + 1] = h.z() > 0.f ? h.y() / h.z() : 0.f;
+		}
+	});
+}
+
+
+}
+
+#endif // PROJECTION_UTILS_H
@@ -0,0 +1,306 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils
+{
+
+
+enum TaskPriority
+{
+	TaskPriority_Interactive = 0,	// what the user is looking at or waiting on
+	TaskPriority_Normal = 1,		// loading and analysis the next interaction needs
+	TaskPriority_Background = 2,	// precomputation nobody waits on yet
+	TaskPriority_Count = 3
+};
+
+
+// Cancels a group of tasks: queued ones are dropped, which breaks their futures, and running
+// ones may poll cancelled() to stop early. A default token is never cancelled
+class CancelToken
+{
+public:
+	static CancelToken create()
+	{
+		CancelToken token;
+		token.m_pFlag = std::make_shared<std::atomic<bool>>(false);
+		return token;
+	}
+
+	void cancel() const { if (m_pFlag) m_pFlag->store(true); }
+	bool cancelled() const { return m_pFlag && m_pFlag->load(std::memory_order_relaxed); }
+
+private:
+	std::shared_ptr<std::atomic<bool>> m_pFlag;
+};
+
+
+// One pool of worker threads shared by every parallel stage, so nested and concurrent stages
+// divide the cores instead of each spawning its own threads. Each worker owns a deque per
+// priority: it pushes and pops its own tasks at the back and steals from the front of the
+// others'. Tasks submitted from outside the pool go to a shared queue. A worker looking for
+// work takes the most urgent priority available anywhere, so interactive tasks overtake queued
+// background ones; running tasks are never interrupted.
+class TaskScheduler
+{
+public:
+	struct WorkerStats
+	{
+		size_t aQueued[TaskPriority_Count] = {};
+		uint64_t executed = 0;
+		uint64_t stolen = 0;		// of those, taken from another worker's deque
+		uint64_t cancelled = 0;		// dropped from this queue without running
+		uint64_t busyUs = 0;		// running tasks included, up to the call to stats()
+	};
+
+	explicit TaskScheduler(unsigned int nWorkers)
+	{
+		m_aWorkers.resize(nWorkers + 1);
+		for (auto &pWorker : m_aWorkers)
+			pWorker.reset(new Worker());
+		for (unsigned int i = 0; i < nWorkers; ++i)
+			m_aWorkers[i]->thread = std::thread([this, i]() { run(i); });
+	}
+
+	~TaskScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_bStop = true;
+		}
+		m_wake.notify_all();
+		for (auto &pWorker : m_aWorkers)
+		{
+			if (pWorker->thread.joinable())
+				pWorker->thread.join();
+		}
+	}
+
+	TaskScheduler(const TaskScheduler&) = delete;
+	TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+	unsigned int workerCount() const { return unsigned(m_aWorkers.size() - 1); }
+
+	// Priority of the task running on this thread; threads outside the pool count as interactive
+	static TaskPriority currentPriority() { return t_priority; }
+
+	// Runs fn() on a worker; the future is broken if `token` is cancelled before it starts
+	template <typename F>
+	auto submit(F fn, TaskPriority priority = TaskPriority_Normal, CancelToken token = CancelToken()) -> std::future<decltype(fn())>
+	{
+		using R = decltype(fn());
+		auto pTask = std::make_shared<std::packaged_task<R()>>(std::move(fn));
+		std::future<R> result = pTask->get_future();
+		push({ [pTask]() { (*pTask)(); }, priority, std::move(token) });
+		return result;
+	}
+
+	// Runs fn(iTask) for every task on up to `nThreads` threads, the caller included, at the
+	// caller's priority. Returns once all are done; the caller works through the indices
+	// itself and only waits for the ones helpers are still running, so nesting is safe.
+	template <typename F>
+	void parallelFor(size_t nTasks, unsigned int nThreads, F &fn)
+	{
+		if (nTasks == 0)
+			return;
+		struct State
+		{
+			std::atomic<size_t> next{ 0 };
+			std::atomic<size_t> done{ 0 };
+		};
+		// helpers that start late claim no index and never touch fn, only the shared state
+		auto pState = std::make_shared<State>();
+		F *pFn = &fn;
+		auto loop = [pState, pFn, nTasks]() {
+			size_t nDone = 0;
+			for (size_t i = pState->next++; i < nTasks; i = pState->next++, ++nDone)
+				(*pFn)(i);
+			if (nDone)
+				pState->done += nDone;
+		};
+		size_t nHelpers = std::min<size_t>({ size_t(std::max(nThreads, 1u)), nTasks, size_t(workerCount()) + 1 }) - 1;
+		for (size_t i = 0; i < nHelpers; ++i)
+			push({ loop, t_priority, CancelToken() });
+		loop();
+		while (pState->done.load() < nTasks)
+			std::this_thread::yield();
+	}
+
+	// Per worker, then the shared queue of tasks submitted from outside the pool
+	std::vector<WorkerStats> stats() const
+	{
+		std::vector<WorkerStats> aStats(m_aWorkers.size());
+		for (size_t i = 0; i < m_aWorkers.size(); ++i)
+		{
+			Worker &w = *m_aWorkers[i];
+			{
+				std::lock_guard<std::mutex> lock(w.mutex);
+				for (int p = 0; p < TaskPriority_Count; ++p)
+					aStats[i].aQueued[p] = w.aQueues[p].size();
+				aStats[i].busyUs = w.busyUs;
+				if (w.taskStartUs >= 0)
+					aStats[i].busyUs += uint64_t(std::max<int64_t>(nowUs() - w.taskStartUs, 0));
+			}
+			aStats[i].executed = w.executed.load();
+			aStats[i].stolen = w.stolen.load();
+			aStats[i].cancelled = w.cancelled.load();
+		}
+		return aStats;
+	}
+
+private:
+	struct Task
+	{
+		std::function<void()> fn;
+		TaskPriority priority;
+		CancelToken token;
+	};
+
+	struct Worker
+	{
+		mutable std::mutex mutex;
+		std::deque<Task> aQueues[TaskPriority_Count];
+		std::atomic<uint64_t> executed{ 0 }, stolen{ 0 }, cancelled{ 0 };
+		// under `mutex`, so stats() sees a running task either in busyUs or by its start, never both
+		uint64_t busyUs = 0;
+		int64_t taskStartUs = -1;	// of the running task, -1 while idle
+		std::thread thread;
+	};
+
+	void push(Task task)
+	{
+		// a worker keeps its own subtasks, everyone else goes through the shared queue
+		Worker &w = *m_aWorkers[t_iWorker >= 0 ? size_t(t_iWorker) : m_aWorkers.size() - 1];
+		{
+			std::lock_guard<std::mutex> lock(w.mutex);
+			w.aQueues[task.priority].push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			++m_nQueued;
+		}
+		m_wake.notify_one();
+	}
+
+	bool pop(Worker &w, int priority, bool bBack, Task &task)
+	{
+		std::lock_guard<std::mutex> lock(w.mutex);
+		std::deque<Task> &queue = w.aQueues[priority];
+		if (queue.empty())
+			return false;
+		if (bBack)
+		{
+			task = std::move(queue.back());
+			queue.pop_back();
+		}
+		else
+		{
+			task = std::move(queue.front());
+			queue.pop_front();
+		}
+		--m_nQueued;
+		return true;
+	}
+
+	// the most urgent task: own deque first, then the shared queue, then the other workers
+	bool find(size_t iSelf, Task &task, bool &bStolen)
+	{
+		size_t nWorkers = m_aWorkers.size() - 1;
+		for (int p = 0; p < TaskPriority_Count; ++p)
+		{
+			bStolen = false;
+			if (pop(*m_aWorkers[iSelf], p, true, task) || pop(*m_aWorkers[nWorkers], p, false, task))
+				return true;
+			bStolen = true;
+			for (size_t k = 1; k < nWorkers; ++k)
+			{
+				if (pop(*m_aWorkers[(iSelf + k) % nWorkers], p, false, task))
+					return true;
+			}
+		}
+		return false;
+	}
+
+	void run(size_t iSelf)
+	{
+		t_iWorker = int(iSelf);
+		trace_utils::setThreadName("worker " + std::to_string(iSelf));
+		Worker &self = *m_aWorkers[iSelf];
+		for (;;)
+		{
+			Task task;
+			bool bStolen = false;
+			if (find(iSelf, task, bStolen))
+			{
+				if (task.token.cancelled())
+				{
+					++self.cancelled;
+					continue;
+				}
+				{
+					std::lock_guard<std::mutex> lock(self.mutex);
+					self.taskStartUs = nowUs();
+				}
+				t_priority = task.priority;
+				task.fn();
+				t_priority = TaskPriority_Interactive;
+				{
+					std::lock_guard<std::mutex> lock(self.mutex);
+					self.busyUs += uint64_t(std::max<int64_t>(nowUs() - self.taskStartUs, 0));
+					self.taskStartUs = -1;
+				}
+				++self.executed;
+				if (bStolen)
+					++self.stolen;
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_wake.wait(lock, [this]() { return m_bStop || m_nQueued.load() > 0; });
+			if (m_bStop && m_nQueued.load() <= 0)
+				return;	// after draining the queues, so queued tasks still run
+		}
+	}
+
+	static int64_t nowUs()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	std::vector<std::unique_ptr<Worker>> m_aWorkers;	// the last one only holds the shared queue
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	std::atomic<int64_t> m_nQueued{ 0 };	// may dip below zero while a push is between its two steps
+	bool m_bStop = false;
+
+	static inline thread_local int t_iWorker = -1;
+	static inline thread_local TaskPriority t_priority = TaskPriority_Interactive;
+};
+
+
+// The process-wide pool, one worker per core but the one running the caller of parallelFor
+inline TaskScheduler& scheduler()
+{
+	static TaskScheduler s_scheduler(std::max(2u, std::thread::hardware_concurrency()) - 1);
+	return s_scheduler;
+}
+
+
+}
+
+#endif // TASK_SCHEDULER_H
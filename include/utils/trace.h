@@ -0,0 +1,190 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Scoped trace zones exported as Chrome trace JSON (chrome://tracing, Perfetto).
+// Each thread appends to its own chain of fixed-size blocks, so recording takes no lock; a block
+// is published with a release store of its count and never moves, so the exporter can read while
+// threads keep recording. With tracing disabled a zone costs one relaxed atomic load.
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) trace_utils::Zone TRACE_CONCAT(traceZone_, __LINE__)(name)
+
+namespace trace_utils
+{
+
+
+struct Event
+{
+	const char* name;	// must outlive the trace, normally a string literal
+	uint64_t beginUs;
+	uint64_t durUs;
+};
+
+struct Block
+{
+	static const size_t CAPACITY = 4096;
+	Event events[CAPACITY];
+	std::atomic<size_t> count{ 0 };
+	std::atomic<Block*> next{ nullptr };
+};
+
+struct ThreadBuffer
+{
+	uint32_t tid = 0;
+	std::string name;
+	Block* head = nullptr;
+	Block* tail = nullptr;	// only touched by the owning thread
+	ThreadBuffer* next = nullptr;
+};
+
+inline std::atomic<bool> g_bEnabled{ false };
+inline std::atomic<ThreadBuffer*> g_pThreads{ nullptr };
+inline std::atomic<uint32_t> g_nextTid{ 1 };
+inline const std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+
+inline uint64_t nowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+// The calling thread's buffer, registered on first use; buffers live until the process exits
+inline ThreadBuffer* threadBuffer()
+{
+	thread_local ThreadBuffer* pBuffer = nullptr;
+	if (pBuffer == nullptr)
+	{
+		pBuffer = new ThreadBuffer();
+		pBuffer->tid = g_nextTid++;
+		pBuffer->name = "thread " + std::to_string(pBuffer->tid);
+		pBuffer->head = pBuffer->tail = new Block();
+		pBuffer->next = g_pThreads.load();
+		while (!g_pThreads.compare_exchange_weak(pBuffer->next, pBuffer))
+			;
+	}
+	return pBuffer;
+}
+
+// Call before the thread records anything that should show under this name
+inline void setThreadName(const std::string& name)
+{
+	threadBuffer()->name = name;
+}
+
+inline void record(const char* name, uint64_t beginUs, uint64_t endUs)
+{
+	ThreadBuffer* pBuffer = threadBuffer();
+	Block* pBlock = pBuffer->tail;
+	size_t n = pBlock->count.load(std::memory_order_relaxed);
+	if (n == Block::CAPACITY)
+	{
+		Block* pNew = new Block();
+		pBlock->next.store(pNew, std::memory_order_release);
+		pBuffer->tail = pBlock = pNew;
+		n = 0;
+	}
+	pBlock->events[n] = { name, beginUs, endUs - beginUs };
+	pBlock->count.store(n + 1, std::memory_order_release);
+}
+
+class Zone
+{
+public:
+	explicit Zone(const char* name)
+	{
+		if (g_bEnabled.load(std::memory_order_relaxed))
+		{
+			m_name = name;
+			m_beginUs = nowUs();
+		}
+	}
+
+	~Zone()
+	{
+		if (m_name != nullptr)
+			record(m_name, m_beginUs, nowUs());
+	}
+
+	Zone(const Zone&) = delete;
+	Zone& operator=(const Zone&) = delete;
+
+private:
+	const char* m_name = nullptr;
+	uint64_t m_beginUs = 0;
+};
+
+inline void setEnabled(bool bEnabled)
+{
+	g_bEnabled.store(bEnabled, std::memory_order_relaxed);
+}
+
+inline bool isEnabled()
+{
+	return g_bEnabled.load(std::memory_order_relaxed);
+}
+
+inline void writeJsonString(std::ostream& out, const std::string& s)
+{
+	out << '"';
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20)
+			out << ' ';
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+// Writes every event recorded so far, in the Chrome trace event format
+inline bool writeChromeTrace(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cerr << "[Error] Cannot write trace to " << path << std::endl;
+		return false;
+	}
+
+	size_t nEvents = 0;
+	bool bFirst = true;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (ThreadBuffer* pBuffer = g_pThreads.load(); pBuffer != nullptr; pBuffer = pBuffer->next)
+	{
+		out << (bFirst ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << pBuffer->tid
+			<< ",\"args\":{\"name\":";
+		writeJsonString(out, pBuffer->name);
+		out << "}}";
+		bFirst = false;
+
+		for (Block* pBlock = pBuffer->head; pBlock != nullptr; pBlock = pBlock->next.load(std::memory_order_acquire))
+		{
+			size_t n = pBlock->count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < n; ++i)
+			{
+				const Event& e = pBlock->events[i];
+				out << ",\n{\"name\":";
+				writeJsonString(out, e.name);
+				out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << pBuffer->tid
+					<< ",\"ts\":" << e.beginUs << ",\"dur\":" << e.durUs << "}";
+			}
+			nEvents += n;
+		}
+	}
+	out << "\n]}\n";
+	std::cout << "Trace of " << nEvents << " events written to " << path << std::endl;
+	return true;
+}
+
+
+}
+
+#endif // TRACE_H
@@ -0,0 +1,268 @@
+#ifndef VERTEX_COLOR_BAKER_H
+#define VERTEX_COLOR_BAKER_H
+
+#include <Eigen/Dense>
+#include <glm/glm.hpp>
+
+#include "gl/model.h"
+#include "core/photo_cameras.h"
+#include "core/texture.h"
+#include "memory_registry.h"
+#include "utils/file_utils.h"
+#include "utils/parallel_utils.h"
+#include "utils/trace.h"
+#include "view_depth_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Colors every vertex from the photos it is visible in: each vertex is projected into all views,
+// occluded ones are dropped with a depth map per view, and the remaining bilinear samples are
+// weighted by how squarely the surface faces the camera. Views are baked one after another with
+// the vertices split across threads; photos are retiled first so a vertex chunk, which is compact
+// on the surface after optimization, reads a few cache-friendly tiles instead of scattered rows.
+class VertexColorBaker
+{
+public:
+	float minFacing = 0.2f;		// cosine between normal and view direction below which a view is skipped
+	float sharpness = 4.f;		// exponent of that cosine in the blend weight
+	bool bBestOnly = false;		// take the best-facing view alone instead of blending
+
+	// Bakes the colors of every vertex of `model`, meshes one after another, into colors(), from
+	// photo i taken by camera i; vertices no photo sees keep their own color. Photos without
+	// decoded pixels are skipped
+	void bake(const Model &model, const PhotoCameras &cameras, const std::vector<Texture> &aTextures)
+	{
+		TRACE_SCOPE("VertexColorBaker::bake");
+		m_aMeshOffsets.clear();
+		m_aPositions.clear();
+		m_aNormals.clear();
+		for (const Mesh &mesh : model.meshes)
+		{
+			m_aMeshOffsets.push_back(m_aPositions.size());
+			for (const Vertex &v : mesh.vertices)
+			{
+				m_aPositions.push_back(Eigen::Vector3f(v.position_.x, v.position_.y, v.position_.z));
+				m_aNormals.push_back(Eigen::Vector3f(v.normal_.x, v.normal_.y, v.normal_.z).normalized());
+			}
+		}
+		size_t n = m_aPositions.size();
+		std::vector<Eigen::Vector4f> aSums(n, Eigen::Vector4f::Zero());	// rgb * weight, weight
+		g_memoryRegistry.set("Staging", "color bake sums", MemoryRegistry::Location_Host, n * sizeof(Eigen::Vector4f));
+
+		m_depth.setCameras(&cameras);
+		m_depth.setModel(&model);
+		const size_t CHUNK = 4096;
+		for (size_t iView = 0; iView < cameras.views() && iView < aTextures.size(); ++iView)
+		{
+			if (!aTextures[iView].data)
+				continue;
+			retile(aTextures[iView]);
+			std::shared_ptr<const ViewDepthCache::DepthMap> depthMap = m_depth.map(iView);
+			const Eigen::Matrix<float, 3, 4> &P = cameras.aProj[iView];
+			const Eigen::Vector3f &C = cameras.aCenters[iView];
+			float width = cameras.width, height = cameras.height;
+			float sx = m_photo.width / width, sy = m_photo.height / height;
+
+			utils::parallelFor((n + CHUNK - 1) / CHUNK, utils::hardwareThreads(), [&](size_t iChunk) {
+				for (size_t i = iChunk * CHUNK; i < std::min(n, (iChunk + 1) * CHUNK); ++i)
+				{
+					const Eigen::Vector3f &X = m_aPositions[i];
+					Eigen::Vector3f h = P * X.homogeneous();
+					if (h.z() <= 0.f)
+						continue;
+					float x = h.x() / h.z(), y = h.y() / h.z();
+					if (x < 0.f || y < 0.f || x >= width || y >= height)
+						continue;
+					float facing = m_aNormals[i].dot((C - X).normalized());
+					if (facing < minFacing || !depthMap->sees(x, y, h.z(), m_depth.relTolerance))
+						continue;
+					float weight = std::pow(facing, sharpness);
+					Eigen::Vector4f &sum = aSums[i];
+					if (bBestOnly && weight <= sum.w())
+						continue;
+					Eigen::Vector3f rgb = m_photo.sample(x * sx - 0.5f, y * sy - 0.5f);
+					if (bBestOnly)
+						sum << rgb, weight;
+					else
+						sum += Eigen::Vector4f(rgb.x() * weight, rgb.y() * weight, rgb.z() * weight, weight);
+				}
+			});
+		}
+		m_depth.invalidate();
+		m_photo = TiledImage();
+		g_memoryRegistry.release("Staging", "color bake tiles");
+
+		m_aColors.resize(n * 4);
+		m_nBaked = 0;
+		size_t iMesh = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			while (iMesh + 1 < m_aMeshOffsets.size() && i >= m_aMeshOffsets[iMesh + 1])
+				++iMesh;
+			Eigen::Vector3f rgb;
+			if (aSums[i].w() > 0.f)
+			{
+				rgb = bBestOnly ? aSums[i].head<3>() : Eigen::Vector3f(aSums[i].head<3>() / aSums[i].w());
+				++m_nBaked;
+			}
+			else
+			{
+				const glm::vec4 &c = model.meshes[iMesh].vertices[i - m_aMeshOffsets[iMesh]].color_;
+				rgb = Eigen::Vector3f(c.x, c.y, c.z) * 255.f;
+			}
+			for (int k = 0; k < 3; ++k)
+				m_aColors[i * 4 + k] = uint8_t(std::lround(std::min(std::max(rgb[k], 0.f), 255.f)));
+			m_aColors[i * 4 + 3] = 255;
+		}
+		g_memoryRegistry.release("Staging", "color bake sums");
+		std::vector<Eigen::Vector3f>().swap(m_aPositions);
+		std::vector<Eigen::Vector3f>().swap(m_aNormals);
+	}
+
+	// RGBA8 per vertex, the meshes' vertices one after another
+	const std::vector<uint8_t>& colors() const { return m_aColors; }
+	size_t bakedCount() const { return m_nBaked; }
+
+	// Identifies the model and photos a color cache was baked from, and the vertex count it holds.
+	// The model is stamped like its mesh cache, so an edit that keeps the vertex count still misses
+	struct CacheHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+		uint64_t vertexCount;
+		uint64_t modelSize;
+		int64_t modelTime;
+		uint64_t photoStamp;	// FNV-1a of every photo's size and time
+	};
+
+	// bump version when the bake or the layout changes
+	static CacheHeader cacheHeader(const std::string &modelPath, const std::vector<std::string> &aPhotoPaths, uint64_t vertexCount)
+	{
+		CacheHeader header = { { 'F', 'M', 'V', 'C', 'O', 'L', 'R', '\0' }, 2, 0, vertexCount, 0, 0, 14695981039346656037ull };
+		file_utils::FileStamp model = file_utils::Stamp(modelPath);
+		header.modelSize = model.size;
+		header.modelTime = model.time;
+		for (const std::string &path : aPhotoPaths)
+		{
+			file_utils::FileStamp photo = file_utils::Stamp(path);
+			uint64_t aValues[2] = { photo.size, uint64_t(photo.time) };
+			const unsigned char *bytes = reinterpret_cast<const unsigned char*>(aValues);
+			for (size_t i = 0; i < sizeof(aValues); ++i)
+				header.photoStamp = (header.photoStamp ^ bytes[i]) * 1099511628211ull;
+		}
+		return header;
+	}
+
+	// loads colors() from a cache written by saveCache() with the same header
+	bool loadCache(const std::string &cachePath, const CacheHeader &expected)
+	{
+		std::ifstream in(cachePath, std::ios::binary);
+		if (!in)
+			return false;
+		CacheHeader header;
+		in.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!in || memcmp(&header, &expected, sizeof(header)) != 0)
+		{
+			std::cout << "Color cache " << cachePath << " is stale." << std::endl;
+			return false;
+		}
+		std::vector<uint8_t> aColors(header.vertexCount * 4);
+		in.read(reinterpret_cast<char*>(aColors.data()), aColors.size());
+		if (!in)
+			return false;
+		m_aColors.swap(aColors);
+		m_nBaked = 0;
+		return true;
+	}
+
+	bool saveCache(const std::string &cachePath, const CacheHeader &header) const
+	{
+		std::ofstream out(cachePath, std::ios::binary);
+		if (!out)
+			return false;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(m_aColors.data()), m_aColors.size());
+		return bool(out);
+	}
+
+private:
+	// RGBA8 photo stored in 32 x 32 texel tiles
+	struct TiledImage
+	{
+		static constexpr int TILE = 32;
+		int width = 0, height = 0, tilesX = 0;
+		std::vector<uint8_t> texels;
+
+		// offset of texel (x, y), clamped to the edge
+		size_t offset(int x, int y) const
+		{
+			x = std::min(std::max(x, 0), width - 1);
+			y = std::min(std::max(y, 0), height - 1);
+			size_t iTile = size_t(y / TILE) * tilesX + x / TILE;
+			return (iTile * TILE * TILE + (y % TILE) * TILE + x % TILE) * 4;
+		}
+
+		const uint8_t* texel(int x, int y) const { return &texels[offset(x, y)]; }
+
+		// bilinear rgb in 0..255 at texel coordinates, texel centers on integers
+		Eigen::Vector3f sample(float x, float y) const
+		{
+			int x0 = int(std::floor(x)), y0 = int(std::floor(y));
+			float fx = x - x0, fy = y - y0;
+			const uint8_t *a = texel(x0, y0), *b = texel(x0 + 1, y0), *c = texel(x0, y0 + 1), *d = texel(x0 + 1, y0 + 1);
+			Eigen::Vector3f rgb;
+			for (int k = 0; k < 3; ++k)
+				rgb[k] = (a[k] * (1.f - fx) + b[k] * fx) * (1.f - fy) + (c[k] * (1.f - fx) + d[k] * fx) * fy;
+			return rgb;
+		}
+	};
+
+	// converts a decoded photo, rows top-down with 1 to 4 channels, into m_photo
+	void retile(const Texture &tex)
+	{
+		TRACE_SCOPE("VertexColorBaker::retile");
+		const int TILE = TiledImage::TILE;
+		m_photo.width = tex.width;
+		m_photo.height = tex.height;
+		m_photo.tilesX = (tex.width + TILE - 1) / TILE;
+		int tilesY = (tex.height + TILE - 1) / TILE;
+		m_photo.texels.resize(size_t(m_photo.tilesX) * tilesY * TILE * TILE * 4);
+		g_memoryRegistry.set("Staging", "color bake tiles", MemoryRegistry::Location_Host, m_photo.texels.size());
+		int nChannels = tex.channels;
+		utils::parallelFor(size_t(tilesY), utils::hardwareThreads(), [&](size_t iTileRow) {
+			for (int y = int(iTileRow) * TILE; y < std::min(tex.height, int(iTileRow + 1) * TILE); ++y)
+			{
+				const unsigned char *src = tex.data + size_t(y) * tex.width * nChannels;
+				for (int x = 0; x < tex.width; ++x, src += nChannels)
+				{
+					uint8_t *dst = &m_photo.texels[m_photo.offset(x, y)];
+					dst[0] = src[0];
+					dst[1] = src[nChannels >= 3 ? 1 : 0];
+					dst[2] = src[nChannels >= 3 ? 2 : 0];
+					dst[3] = 255;
+				}
+			}
+		});
+	}
+
+	ViewDepthCache m_depth{ 1024 };
+
+	TiledImage m_photo;
+	std::vector<size_t> m_aMeshOffsets;
+	std::vector<Eigen::Vector3f> m_aPositions, m_aNormals;
+
+	std::vector<uint8_t> m_aColors;
+	size_t m_nBaked = 0;
+};
+
+
+#endif // VERTEX_COLOR_BAKER_H
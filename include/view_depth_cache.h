@@ -0,0 +1,348 @@
+#ifndef VIEW_DEPTH_CACHE_H
+#define VIEW_DEPTH_CACHE_H
+
+#include <Eigen/Dense>
+#include <glm/glm.hpp>
+
+#include "core/photo_cameras.h"
+#include "gl/model.h"
+#include "memory_registry.h"
+#include "soft/soft_rasterizer.h"
+#include "utils/parallel_utils.h"
+#include "utils/task_scheduler.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Depth of the mesh as seen by each calibrated camera, rasterized on the CPU at reduced
+// resolution. Answers "is X visible in view v" and 2D to 3D unprojection with one lookup
+// instead of a ray cast. Depth is the camera-space depth of the projection matrices (the w
+// they divide by), row y of a map covering photo rows [y, y + 1) / scale.
+// Thread-safe. visibility() and unproject() never rasterize on the calling thread: a view not
+// rendered yet is queued on the scheduler at background priority and reported as unknown until
+// it is done, so the GUI never waits on a map. map() renders on the caller instead, for batch
+// work that needs every view. Maps are handed out shared, so one in use outlives invalidate().
+class ViewDepthCache
+{
+public:
+	static constexpr float NO_SURFACE = std::numeric_limits<float>::infinity();
+
+	struct DepthMap
+	{
+		int width = 0, height = 0;
+		float scale = 0.f;			// map texels per photo pixel
+		std::vector<float> depth;	// NO_SURFACE where the mesh is not seen
+
+		float at(float xPhoto, float yPhoto) const
+		{
+			int x = int(std::floor(xPhoto * scale)), y = int(std::floor(yPhoto * scale));
+			if (x < 0 || y < 0 || x >= width || y >= height)
+				return NO_SURFACE;
+			return depth[size_t(y) * width + x];
+		}
+
+		// True if a point `d` deep at photo pixel (xPhoto, yPhoto) is no further than `relTolerance`
+		// behind the surface; the 2x2 texels around it are checked, so silhouettes err towards visible
+		bool sees(float xPhoto, float yPhoto, float d, float relTolerance) const
+		{
+			float halfTexel = 0.5f / scale, surface = 0.f;
+			for (int k = 0; k < 4; ++k)
+				surface = std::max(surface, at(xPhoto + ((k & 1) ? halfTexel : -halfTexel), yPhoto + ((k & 2) ? halfTexel : -halfTexel)));
+			return d <= surface * (1.f + relTolerance);
+		}
+	};
+
+	enum Visibility
+	{
+		Visibility_Hidden,		// behind the surface, behind the camera or outside the photo
+		Visibility_Visible,
+		Visibility_Unknown		// the view's depth map is still being rendered
+	};
+
+	float relTolerance = 0.01f;	// of the depth, how far behind the surface still counts as visible
+
+	explicit ViewDepthCache(int maxSize = 512) :
+		m_maxSize(maxSize),
+		m_cancel(utils::CancelToken::create())
+	{
+	}
+
+	~ViewDepthCache()
+	{
+		cancelBuilds();
+	}
+
+	ViewDepthCache(const ViewDepthCache&) = delete;
+	ViewDepthCache& operator=(const ViewDepthCache&) = delete;
+
+	// `cameras` must outlive this, or the next setCameras()
+	void setCameras(const PhotoCameras *cameras)
+	{
+		cancelBuilds();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cameras = cameras;
+		m_aInvM.clear();
+		for (const auto &P : cameras->aProj)
+			m_aInvM.push_back(P.leftCols<3>().inverse());
+		invalidateLocked();
+	}
+
+	// `model` must stay unchanged until the next setModel() or invalidate()
+	void setModel(const Model *model)
+	{
+		cancelBuilds();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_model = model;
+		m_boundsMin = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+		m_boundsMax = -m_boundsMin;
+		for (const Mesh &mesh : model->meshes)
+		{
+			for (const Vertex &v : mesh.vertices)
+			{
+				Eigen::Vector3f p(v.position_.x, v.position_.y, v.position_.z);
+				m_boundsMin = m_boundsMin.cwiseMin(p);
+				m_boundsMax = m_boundsMax.cwiseMax(p);
+			}
+		}
+		invalidateLocked();
+	}
+
+	// Drops every map, e.g. before the mesh changes; waits for renders still reading the mesh
+	void invalidate()
+	{
+		cancelBuilds();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		invalidateLocked();
+	}
+
+	// The depth map of `iView`, rendered on the calling thread if it is not cached yet
+	std::shared_ptr<const DepthMap> map(size_t iView)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_aMaps[iView])
+				return m_aMaps[iView];
+			job = jobLocked(iView);
+		}
+		std::shared_ptr<const DepthMap> pMap = render(job);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		storeLocked(job, pMap);
+		return pMap;
+	}
+
+	bool isCached(size_t iView)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return iView < m_aMaps.size() && m_aMaps[iView];
+	}
+
+	// Depth of the surface at photo pixel (xPhoto, yPhoto) of `iView`, NO_SURFACE where there is
+	// none; renders like map()
+	float depth(size_t iView, float xPhoto, float yPhoto)
+	{
+		return map(iView)->at(xPhoto, yPhoto);
+	}
+
+	// Whether X projects into the photo of `iView` with nothing in the mesh in front of it
+	Visibility visibility(size_t iView, const Eigen::Vector3f &X)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		Eigen::Vector3f h = m_cameras->aProj[iView] * X.homogeneous();
+		if (h.z() <= 0.f)
+			return Visibility_Hidden;
+		float x = h.x() / h.z(), y = h.y() / h.z();
+		if (x < 0.f || y < 0.f || x >= m_cameras->width || y >= m_cameras->height)
+			return Visibility_Hidden;
+		std::shared_ptr<const DepthMap> depthMap = requestLocked(iView);
+		lock.unlock();
+		if (!depthMap)
+			return Visibility_Unknown;
+		return depthMap->sees(x, y, h.z(), relTolerance) ? Visibility_Visible : Visibility_Hidden;
+	}
+
+	// World point of the surface seen at photo pixel (xPhoto, yPhoto) of `iView`; false if none,
+	// or while the view's map is still being rendered
+	bool unproject(size_t iView, float xPhoto, float yPhoto, Eigen::Vector3f &X)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::shared_ptr<const DepthMap> depthMap = requestLocked(iView);
+		float d = depthMap ? depthMap->at(xPhoto, yPhoto) : NO_SURFACE;
+		if (d == NO_SURFACE)
+			return false;
+		X = m_aInvM[iView] * (d * Eigen::Vector3f(xPhoto, yPhoto, 1.f) - m_cameras->aProj[iView].col(3));
+		return true;
+	}
+
+private:
+	// What rendering one view reads, copied under the lock so the render itself runs without it
+	struct Job
+	{
+		size_t iView = 0;
+		uint64_t generation = 0;
+		Eigen::Matrix<float, 3, 4> P;
+		float width = 0.f, height = 0.f;
+		const Model *model = nullptr;
+		Eigen::Vector3f boundsMin, boundsMax;
+	};
+
+	Job jobLocked(size_t iView) const
+	{
+		Job job;
+		job.iView = iView;
+		job.generation = m_generation;
+		job.P = m_cameras->aProj[iView];
+		job.width = m_cameras->width;
+		job.height = m_cameras->height;
+		job.model = m_model;
+		job.boundsMin = m_boundsMin;
+		job.boundsMax = m_boundsMax;
+		return job;
+	}
+
+	// The map of `iView` if rendered; otherwise queues its render, once, and returns null
+	std::shared_ptr<const DepthMap> requestLocked(size_t iView)
+	{
+		if (!m_aMaps[iView] && !m_aPending[iView])
+		{
+			m_aPending[iView] = true;
+			Job job = jobLocked(iView);
+			m_aBuilds.push_back(utils::scheduler().submit([this, job]() {
+				std::shared_ptr<const DepthMap> pMap = render(job);
+				std::lock_guard<std::mutex> lock(m_mutex);
+				storeLocked(job, pMap);
+			}, utils::TaskPriority_Background, m_cancel));
+		}
+		return m_aMaps[iView];
+	}
+
+	// Keeps a finished render unless the cameras or the mesh changed since it started
+	void storeLocked(const Job &job, const std::shared_ptr<const DepthMap> &pMap)
+	{
+		if (job.generation != m_generation || m_aMaps[job.iView])
+			return;
+		m_aMaps[job.iView] = pMap;
+		m_aPending[job.iView] = false;
+		g_memoryRegistry.set("Depth maps", "view " + std::to_string(job.iView), MemoryRegistry::Location_Host, pMap->depth.size() * sizeof(float));
+	}
+
+	// Drops queued renders and waits for running ones, which read the mesh; called without the lock
+	void cancelBuilds()
+	{
+		std::vector<std::future<void>> aBuilds;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_cancel.cancel();
+			m_cancel = utils::CancelToken::create();
+			++m_generation;
+			aBuilds.swap(m_aBuilds);
+		}
+		for (std::future<void> &build : aBuilds)
+			build.wait();
+	}
+
+	void invalidateLocked()
+	{
+		for (size_t i = 0; i < m_aMaps.size(); ++i)
+			g_memoryRegistry.release("Depth maps", "view " + std::to_string(i));
+		size_t nViews = m_cameras ? m_cameras->views() : 0;
+		m_aMaps.assign(nViews, nullptr);
+		m_aPending.assign(nViews, false);
+		++m_generation;
+	}
+
+	// Rasterizes the mesh with clip coordinates built from the projection matrix: x and y map
+	// the photo onto the map, z is a perspective depth between the nearest and farthest
+	// corner of the mesh bounds, read back and linearized
+	std::shared_ptr<const DepthMap> render(const Job &job) const
+	{
+		TRACE_SCOPE("ViewDepthCache::render");
+		auto pMap = std::make_shared<DepthMap>();
+		DepthMap &m = *pMap;
+		m.scale = m_maxSize / std::max(job.width, job.height);
+		m.width = std::max(1, int(std::ceil(job.width * m.scale)));
+		m.height = std::max(1, int(std::ceil(job.height * m.scale)));
+		m.depth.assign(size_t(m.width) * m.height, NO_SURFACE);
+		if (!job.model)
+			return pMap;
+
+		const Eigen::Matrix<float, 3, 4> &P = job.P;
+		Eigen::RowVector4f depthRow = P.row(2);
+		float nearest = std::numeric_limits<float>::max(), farthest = 0.f;
+		for (int k = 0; k < 8; ++k)
+		{
+			Eigen::Vector4f corner((k & 1) ? job.boundsMax.x() : job.boundsMin.x(), (k & 2) ? job.boundsMax.y() : job.boundsMin.y(),
+				(k & 4) ? job.boundsMax.z() : job.boundsMin.z(), 1.f);
+			float d = depthRow * corner;
+			nearest = std::min(nearest, d);
+			farthest = std::max(farthest, d);
+		}
+		if (farthest <= 0.f)
+			return pMap;	// the mesh is behind the camera
+		float n = std::max(nearest, farthest * 1e-3f), f = farthest * 1.01f;
+		float a = (f + n) / (f - n), b = -2.f * f * n / (f - n);
+
+		Eigen::Matrix4f clip;
+		clip.row(0) = 2.f / job.width * P.row(0) - depthRow;
+		clip.row(1) = 2.f / job.height * P.row(1) - depthRow;
+		clip.row(2) = a * depthRow;
+		clip(2, 3) += b;
+		clip.row(3) = depthRow;
+
+		soft::Rasterizer raster;
+		raster.resize(m.width, m.height);
+		raster.clear(glm::vec4(0.f));
+		std::vector<soft::Vertex> aVertices;
+		for (const Mesh &mesh : job.model->meshes)
+		{
+			aVertices.resize(mesh.vertices.size());
+			const size_t CHUNK = 4096;
+			utils::parallelFor((aVertices.size() + CHUNK - 1) / CHUNK, utils::hardwareThreads(), [&](size_t iChunk) {
+				for (size_t i = iChunk * CHUNK; i < std::min(aVertices.size(), (iChunk + 1) * CHUNK); ++i)
+				{
+					const glm::vec3 &p = mesh.vertices[i].position_;
+					Eigen::Vector4f c = clip * Eigen::Vector4f(p.x, p.y, p.z, 1.f);
+					aVertices[i] = { glm::vec4(c.x(), c.y(), c.z(), c.w()), glm::vec4(0.f), glm::vec2(0.f) };
+				}
+			});
+			raster.drawTriangles(aVertices, mesh.indices);
+		}
+		raster.flush();
+
+		// rows are bottom-up, which with y_ndc = 2 y / height - 1 puts photo row 0 first
+		std::vector<float> window;
+		raster.readDepth(window);
+		for (size_t i = 0; i < window.size(); ++i)
+		{
+			float zNdc = window[i] * 2.f - 1.f;
+			if (window[i] < 1.f)
+				m.depth[i] = b / (zNdc - a);
+		}
+		return pMap;
+	}
+
+	int m_maxSize;
+	const PhotoCameras *m_cameras = nullptr;
+	std::vector<Eigen::Matrix3f> m_aInvM;	// of the left 3x3 of each projection
+	const Model *m_model = nullptr;
+	Eigen::Vector3f m_boundsMin = Eigen::Vector3f::Zero(), m_boundsMax = Eigen::Vector3f::Zero();
+
+	std::mutex m_mutex;
+	std::vector<std::shared_ptr<const DepthMap>> m_aMaps;	// null until rendered
+	std::vector<bool> m_aPending;	// render queued or running
+	std::vector<std::future<void>> m_aBuilds;
+	utils::CancelToken m_cancel;	// of the queued renders
+	uint64_t m_generation = 0;		// bumped when cameras or mesh change, so older renders are dropped
+};
+
+
+#endif // VIEW_DEPTH_CACHE_H
@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+
+uniform mat4 View;
+uniform mat4 Proj;
+
+// between the photo and the landmark markers
+uniform float Depth = 1.05;
+
+void main()
+{
+	gl_Position = Proj * View * vec4(aPos, Depth, 1.0);
+}
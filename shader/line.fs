@@ -1,7 +1,9 @@
 #version 330 core
 out vec4 FragColor;
 
+uniform vec3 LineColor = vec3(1.0);
+
 void main()
 {
-    FragColor = vec4(1.0);
+    FragColor = vec4(LineColor, 1.0);
 } 
\ No newline at end of file
@@ -1,6 +1,6 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec3 aPos;		// unorm, relative to the mesh bounds
+layout (location = 1) in vec2 aNormal;	// snorm, octahedral
 layout (location = 2) in vec4 aColor;
 
 out vec3 FragPos;
@@ -9,11 +9,21 @@ out vec4 Color;
 
 uniform mat4 View;
 uniform mat4 Proj;
+uniform vec3 BoundsMin;
+uniform vec3 BoundsExtent;
+
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
 
 void main()
 {
-    FragPos = aPos;
-    Normal = aNormal; 
+    FragPos = BoundsMin + aPos * BoundsExtent;
+    Normal = DecodeOctahedral(aNormal); 
 	Color = aColor;
-    gl_Position = Proj * View * vec4(aPos, 1.0);
+    gl_Position = Proj * View * vec4(FragPos, 1.0);
 }
\ No newline at end of file
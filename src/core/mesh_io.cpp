@@ -0,0 +1,188 @@
+#include "core/mesh_io.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "utils/file_utils.h"
+#include "utils/trace.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace mesh_io
+{
+
+namespace
+{
+
+
+struct MeshCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t meshCount;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
+
+// identifies the source file the cache was built from; bump version when the layout or processing changes
+MeshCacheHeader cacheHeader(const std::string &sourcePath)
+{
+	MeshCacheHeader header = { { 'F', 'M', 'V', 'M', 'E', 'S', 'H', '\0' }, 1, 0, 0, 0 };
+	file_utils::FileStamp stamp = file_utils::Stamp(sourcePath);
+	header.sourceSize = stamp.size;
+	header.sourceTime = stamp.time;
+	return header;
+}
+
+MeshData processMesh(const aiMesh *mesh)
+{
+	MeshData data;
+	data.vertices.reserve(mesh->mNumVertices);
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	{
+		Vertex vertex;
+		vertex.position_ = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+		vertex.normal_ = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+		vertex.color_ = glm::vec4(1.f);
+		if (mesh->HasVertexColors(0))
+			vertex.color_ = glm::vec4(mesh->mColors[0][i].r, mesh->mColors[0][i].g, mesh->mColors[0][i].b, 1.f);
+		data.vertices.push_back(vertex);
+	}
+	// a face is one triangle after aiProcess_Triangulate
+	data.indices.reserve(size_t(mesh->mNumFaces) * 3);
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace &face = mesh->mFaces[i];
+		for (unsigned int j = 0; j < face.mNumIndices; j++)
+			data.indices.push_back(face.mIndices[j]);
+	}
+	return data;
+}
+
+// collects the meshes of a node and its children, depth first
+void processNode(const aiNode *node, const aiScene *scene, std::vector<MeshData> &meshes)
+{
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+		meshes.push_back(processMesh(scene->mMeshes[node->mMeshes[i]]));
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		processNode(node->mChildren[i], scene, meshes);
+}
+
+
+}
+
+
+std::vector<MeshData> loadMeshes(const std::string &path)
+{
+	TRACE_SCOPE("mesh_io::loadMeshes");
+	std::vector<MeshData> meshes;
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenNormals);
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	{
+		std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+		return meshes;
+	}
+	processNode(scene->mRootNode, scene, meshes);
+	return meshes;
+}
+
+
+bool loadCache(const std::string &cachePath, const std::string &sourcePath, std::vector<MeshData> &meshes)
+{
+	TRACE_SCOPE("mesh_io::loadCache");
+	std::ifstream in(cachePath, std::ios::binary);
+	if (!in)
+		return false;
+
+	MeshCacheHeader header, expected = cacheHeader(sourcePath);
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!in || memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version
+		|| header.sourceSize != expected.sourceSize || header.sourceTime != expected.sourceTime)
+	{
+		std::cout << "Mesh cache " << cachePath << " is stale." << std::endl;
+		return false;
+	}
+
+	std::vector<MeshData> loaded(header.meshCount);
+	for (uint32_t i = 0; i < header.meshCount; i++)
+	{
+		MeshData &mesh = loaded[i];
+		uint64_t nVertices = 0, nIndices = 0;
+		in.read(reinterpret_cast<char*>(&nVertices), sizeof(nVertices));
+		in.read(reinterpret_cast<char*>(&nIndices), sizeof(nIndices));
+		in.read(reinterpret_cast<char*>(&mesh.acmrBefore), sizeof(float));
+		in.read(reinterpret_cast<char*>(&mesh.acmrAfter), sizeof(float));
+		if (!in)
+			break;
+		mesh.vertices.resize(nVertices);
+		mesh.indices.resize(nIndices);
+		in.read(reinterpret_cast<char*>(mesh.vertices.data()), nVertices * sizeof(Vertex));
+		in.read(reinterpret_cast<char*>(mesh.indices.data()), nIndices * sizeof(unsigned int));
+		if (!in)
+			break;
+		std::cout << "Mesh " << i << " ACMR (FIFO 16): " << mesh.acmrBefore << " -> " << mesh.acmrAfter << " (cached)" << std::endl;
+	}
+	if (!in)
+	{
+		std::cout << "Mesh cache " << cachePath << " is truncated." << std::endl;
+		return false;
+	}
+	meshes = std::move(loaded);
+	return true;
+}
+
+
+bool saveCache(const std::string &cachePath, const std::string &sourcePath, const std::vector<MeshData> &meshes)
+{
+	TRACE_SCOPE("mesh_io::saveCache");
+	std::ofstream out(cachePath, std::ios::binary);
+	if (!out)
+	{
+		std::cout << "Can not write mesh cache " << cachePath << "." << std::endl;
+		return false;
+	}
+
+	MeshCacheHeader header = cacheHeader(sourcePath);
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const MeshData &mesh : meshes)
+	{
+		uint64_t nVertices = mesh.vertices.size(), nIndices = mesh.indices.size();
+		float acmr[2] = { mesh.acmrBefore, mesh.acmrAfter };
+		out.write(reinterpret_cast<const char*>(&nVertices), sizeof(nVertices));
+		out.write(reinterpret_cast<const char*>(&nIndices), sizeof(nIndices));
+		out.write(reinterpret_cast<const char*>(acmr), sizeof(acmr));
+		out.write(reinterpret_cast<const char*>(mesh.vertices.data()), nVertices * sizeof(Vertex));
+		out.write(reinterpret_cast<const char*>(mesh.indices.data()), nIndices * sizeof(unsigned int));
+	}
+	return static_cast<bool>(out);
+}
+
+
+std::vector<MeshData> ingest(const std::string &path, const std::string &cachePath)
+{
+	TRACE_SCOPE("mesh_io::ingest");
+	std::vector<MeshData> meshes;
+	if (loadCache(cachePath, path, meshes))
+		return meshes;
+
+	meshes = loadMeshes(path);
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		meshes[i].optimize();
+		std::cout << "Mesh " << i << " ACMR (FIFO 16): " << meshes[i].acmrBefore
+			<< " -> " << meshes[i].acmrAfter << std::endl;
+	}
+	if (!meshes.empty())
+		saveCache(cachePath, path, meshes);
+	return meshes;
+}
+
+
+}
@@ -0,0 +1,489 @@
+#include "core/project_data.h"
+
+#include "memory_registry.h"
+#include "utils/file_utils.h"
+#include "utils/parallel_utils.h"
+#include "utils/trace.h"
+#include "tinyxml2.h"
+
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+using namespace tinyxml2;
+
+
+ProjectData::ProjectData(const std::string &rootDir) :
+	m_pathRootDir(fs::path(rootDir)),
+	m_dirFacialLdmk(m_pathRootDir / "face_landmarks"),
+	m_dirEarLdmk(m_pathRootDir / "ear_landmarks"),
+	m_pathPhotoDir(m_pathRootDir / "image"),
+	m_pathModel(m_pathRootDir / "photoscan_scale.ply"),
+	m_pathXml(m_pathRootDir / "cam_scale.xml")
+{
+	loadCamInfo();
+	loadLandmarks();
+	loadTextures();
+}
+
+
+ProjectData::~ProjectData()
+{
+	releasePixels();
+}
+
+
+int ProjectData::loadCamInfo()
+{
+	TRACE_SCOPE("ProjectData::loadCamInfo");
+	std::cout << "Load camera information." << std::endl;
+
+	Eigen::Matrix4f T_model = Eigen::Matrix4f::Identity();
+
+	m_cameras = PhotoCameras();
+	m_aTransMatrices.clear();
+	m_aInvTransMatrices.clear();
+
+	std::vector<double> sensor_f;
+	std::vector<double> sensor_cx;
+	std::vector<double> sensor_cy;
+	std::vector<double> sensor_w;
+	std::vector<double> sensor_h;
+
+	std::vector<int> sensor_idxs;
+
+	int sensorNum;
+
+	XMLDocument doc;
+	doc.LoadFile(m_pathXml.string().c_str());
+
+	XMLElement *root = doc.RootElement();
+	XMLElement *chunk = root->FirstChildElement("chunk");  //document->chunk->sensors
+	if (chunk != NULL)
+	{
+		//model transform
+		XMLElement *xml_transform = chunk->FirstChildElement("transform");
+		if (xml_transform != NULL)
+		{
+			XMLElement* rot = xml_transform->FirstChildElement("rotation");
+			if(rot)
+			{
+				const char* rotationText = xml_transform->FirstChildElement("rotation")->GetText();
+				const char* translationText = xml_transform->FirstChildElement("translation")->GetText();
+
+				char *rotation = const_cast<char *>(rotationText);
+				char *splits;
+				const char *d = " ";
+				splits = strtok(rotation, d);
+				int row = 0, col = 0;
+				while (splits)
+				{
+					T_model(row, col) = atof(splits);
+					col++;
+					if (col == 3)
+					{
+						row++;
+						col = 0;
+					}
+					splits = strtok(NULL, d);
+				}
+
+				char *translation = const_cast<char *>(translationText);
+				splits = strtok(translation, d);
+				for (int i = 0; i < 3; i++)
+				{
+					T_model(i, 3) = atof(splits);
+					splits = strtok(NULL, d);
+				}
+			}
+			else
+			{
+				m_scale = stod(xml_transform->FirstChildElement("scale")->GetText());
+				std::cout << "Scale:" << m_scale << std::endl;
+			}
+		}
+
+
+		// sensors
+		XMLElement *xml_sensors = chunk->FirstChildElement("sensors");
+		if (xml_sensors != NULL)
+		{
+			int sensorNum = atoi(xml_sensors->Attribute("next_id"));
+			cout << "sensor nums: " << sensorNum << endl;
+
+			// intial sensor size
+			sensor_f.resize(sensorNum);
+			sensor_cx.resize(sensorNum);
+			sensor_cy.resize(sensorNum);
+			sensor_w.resize(sensorNum);
+			sensor_h.resize(sensorNum);
+
+			XMLElement *xml_sensor = xml_sensors->FirstChildElement("sensor");
+			for (int i = 0; i < sensorNum; i++)
+				while (NULL != xml_sensor)
+				{
+					int sensorId = atoi(xml_sensor->Attribute("id"));
+					//cout<<sensorId<<endl;
+
+					XMLElement *xml_calibration = xml_sensor->FirstChildElement("calibration");
+					XMLElement *xml_resolution = xml_calibration->FirstChildElement("resolution");
+
+					XMLElement *xml_f = xml_calibration->FirstChildElement("f");
+					XMLElement *xml_cx = xml_calibration->FirstChildElement("cx");
+					XMLElement *xml_cy = xml_calibration->FirstChildElement("cy");
+
+					sensor_w[sensorId] = atoi(xml_resolution->Attribute("width"));
+					sensor_h[sensorId] = atoi(xml_resolution->Attribute("height"));
+					sensor_f[sensorId] = atof(xml_f->GetText());
+					sensor_cx[sensorId] = atof(xml_cx->GetText());
+					sensor_cy[sensorId] = atof(xml_cy->GetText());
+
+					//distoration parameters
+					XMLElement *xml_k1 = xml_calibration->FirstChildElement("k1");
+					XMLElement *xml_k2 = xml_calibration->FirstChildElement("k2");
+					XMLElement *xml_p1 = xml_calibration->FirstChildElement("p1");
+					XMLElement *xml_p2 = xml_calibration->FirstChildElement("p2");
+					XMLElement *xml_k3 = xml_calibration->FirstChildElement("k3");
+
+					xml_sensor = xml_sensor->NextSiblingElement("sensor");
+				}
+		}
+
+		//cameras
+		XMLElement *cameras = chunk->FirstChildElement("cameras");
+		if (cameras != NULL)
+		{
+			m_nFaces = atoi(cameras->Attribute("next_id"));
+			cout << "camera nums: " << m_nFaces << endl;
+
+			sensor_idxs.resize(m_nFaces);
+
+			XMLElement *xml_camera = cameras->FirstChildElement("camera");
+			while (NULL != xml_camera)
+			{
+
+				Eigen::Matrix<float, 4, 4> T_camera;
+				Eigen::Matrix<float, 3, 4> P;
+				int camera_idx = atoi(xml_camera->Attribute("id"));
+				int sensor_idx = atoi(xml_camera->Attribute("sensor_id"));
+				//cout << "camera " << camera_idx << " using sensor " << sensor_idx << endl;
+
+
+				const char* transformtmp = xml_camera->FirstChildElement("transform")->GetText();
+				char *transform = const_cast<char *>(transformtmp);
+				char *splits;
+				const char *d = " ";
+				splits = strtok(transform, d);
+				int row = 0, col = 0;
+				while (splits) {
+					T_camera(row, col) = atof(splits);
+					col++;
+					if (col == 4) {
+						row++;
+						col = 0;
+					}
+					splits = strtok(NULL, d);
+
+				}
+
+				double f = sensor_f[sensor_idx];
+				double cx = sensor_cx[sensor_idx];
+				double cy = sensor_cy[sensor_idx];
+				double w = sensor_w[sensor_idx];
+				double h = sensor_h[sensor_idx];
+				Eigen::Matrix<float, 3, 4> K;
+				K << f, 0, w / 2.0 + cx, 0,
+					0, f, h / 2.0 + cy, 0,
+					0, 0, 1, 0;
+
+				Eigen::Matrix<float, 4, 4> T = T_camera.inverse() * T_model.inverse();
+				P = K * T;
+
+				m_cameras.aProj.push_back(P);
+				m_aTransMatrices.push_back(T.block(0, 0, 3, 4));
+				m_aInvTransMatrices.push_back(T.inverse());
+
+				Eigen::Matrix3f R = T.block(0, 0, 3, 3);
+				Eigen::Vector3f t(T(0, 3), T(1, 3), T(2, 3));
+				Eigen::Vector3f tmp = -R.transpose()*t;
+				m_cameras.aCenters.push_back(Eigen::Vector3f(tmp[0], tmp[1], tmp[2]));
+
+				sensor_idxs[camera_idx] = sensor_idx;
+
+				xml_camera = xml_camera->NextSiblingElement("camera");
+			}
+		}
+	}
+
+	m_f = sensor_f[0];
+	m_cx = sensor_cx[0];
+	m_cy = sensor_cy[0];
+	m_width = sensor_w[0];
+	m_height = sensor_h[0];
+	m_cameras.width = float(m_width);
+	m_cameras.height = float(m_height);
+
+	return 0;
+}
+
+
+void ProjectData::loadLandmarks()
+{
+	TRACE_SCOPE("ProjectData::loadLandmarks");
+	std::cout << "Load landmarks." << std::endl;
+
+	m_aLandmarkCoordsSets.resize(m_nFaces);
+	for(auto& set : m_aLandmarkCoordsSets)
+		set = std::vector<float>(N_LANDMARKS * 2, 0.f);
+
+	// one file per view and directory; ear landmarks follow the facial ones. Each file only
+	// writes its directory's range, so the two files of a view can be parsed side by side
+	std::vector<fs::path> aFiles;
+	for (const fs::path &dir : { m_dirFacialLdmk, m_dirEarLdmk })
+	{
+		if (!std::filesystem::exists(dir))
+		{
+			std::cout << "Error: Directory " << dir << " does not exist." << std::endl;
+			break;
+		}
+		for (std::filesystem::directory_iterator it(dir); it != std::filesystem::directory_iterator(); it++)
+		{
+			if (it->path().extension() != ".txt")
+				continue;
+			std::cout << "Load landmarks from: " << it->path().string() << std::endl;
+			aFiles.push_back(it->path());
+		}
+	}
+
+	utils::parallelFor(aFiles.size(), utils::hardwareThreads(), [&](size_t iFile) {
+		const fs::path &path = aFiles[iFile];
+		unsigned int camera_id = file_utils::Str2Id(path.stem().string());
+		int iFirst = 0, n = 0;
+		landmarkRange(path.parent_path(), iFirst, n);
+		if (camera_id >= m_aLandmarkCoordsSets.size() || !parseLandmarks(path, iFirst, n, m_aLandmarkCoordsSets[camera_id]))
+			std::cout << "\nError: Can not open " << path.string() << "." << std::endl;
+	});
+	m_aSavedLandmarkSets = m_aLandmarkCoordsSets;
+
+	for (size_t i = 0; i < m_aLandmarkCoordsSets.size(); ++i)
+	{
+		g_memoryRegistry.set("Landmarks", "view " + std::to_string(i), MemoryRegistry::Location_Host, 
+			(m_aLandmarkCoordsSets[i].capacity() + m_aSavedLandmarkSets[i].capacity()) * sizeof(float));
+	}
+	std::cout << "Done" << std::endl;
+
+}
+
+
+bool ProjectData::landmarkRange(const fs::path &dir, int &iFirst, int &n) const
+{
+	if (dir == m_dirFacialLdmk)
+	{
+		iFirst = 0;
+		n = N_FACIAL_LDMKS;
+		return true;
+	}
+	if (dir == m_dirEarLdmk)
+	{
+		iFirst = N_FACIAL_LDMKS;
+		n = N_LANDMARKS - N_FACIAL_LDMKS;
+		return true;
+	}
+	return false;
+}
+
+
+bool ProjectData::parseLandmarks(const fs::path &path, int iFirst, int n, std::vector<float> &coords)
+{
+	std::ifstream in(path.string());
+	if (!in)
+		return false;
+	std::string line;
+	int i = iFirst;
+	try
+	{
+		while (std::getline(in, line) && i < iFirst + n)
+		{
+			if (line.empty() || line == "\n")
+				continue;
+			std::vector<std::string> words;
+			boost::split(words, line, boost::is_any_of(" "));
+			if (words.size() < 2)
+				return false;
+			coords[i * 2] = std::stof(words[0]);
+			coords[(i++) * 2 + 1] = std::stof(words[1]);
+		}
+	}
+	catch (const std::exception&)
+	{
+		return false;	// not a number, e.g. a line cut off mid-write
+	}
+	return true;
+}
+
+
+ProjectData::LandmarkReload ProjectData::reloadLandmarks(const std::vector<fs::path> &aPaths)
+{
+	TRACE_SCOPE("ProjectData::reloadLandmarks");
+	struct Staged
+	{
+		int iView, iFirst, n;
+		std::vector<float> coords;
+	};
+	std::vector<Staged> aStaged;
+	for (const fs::path &path : aPaths)
+	{
+		Staged staged;
+		if (path.extension() != ".txt" || !landmarkRange(path.parent_path(), staged.iFirst, staged.n))
+			continue;
+		try
+		{
+			staged.iView = int(file_utils::Str2Id(path.stem().string()));
+		}
+		catch (const std::exception&)
+		{
+			continue;
+		}
+		if (staged.iView < 0 || staged.iView >= int(m_aLandmarkCoordsSets.size()))
+			continue;
+		staged.coords.assign(N_LANDMARKS * 2, 0.f);
+		if (!parseLandmarks(path, staged.iFirst, staged.n, staged.coords))
+		{
+			std::cout << "Skipped reloading " << path.string() << ", it does not parse." << std::endl;
+			continue;
+		}
+		aStaged.push_back(std::move(staged));
+	}
+
+	// three-way merge against the positions last loaded or saved
+	LandmarkReload reload;
+	for (const Staged &staged : aStaged)
+	{
+		std::vector<float> &current = m_aLandmarkCoordsSets[staged.iView];
+		std::vector<float> &saved = m_aSavedLandmarkSets[staged.iView];
+		for (int i = staged.iFirst; i < staged.iFirst + staged.n; ++i)
+		{
+			float disk[2] = { staged.coords[i * 2], staged.coords[i * 2 + 1] };
+			if (disk[0] == saved[i * 2] && disk[1] == saved[i * 2 + 1])
+				continue;	// the file did not move it
+			bool bEdited = isEdited(staged.iView, i);
+			saved[i * 2] = disk[0];
+			saved[i * 2 + 1] = disk[1];
+			if (disk[0] == current[i * 2] && disk[1] == current[i * 2 + 1])
+				continue;
+			if (bEdited)
+			{
+				reload.aConflicts.push_back({ staged.iView, i, { current[i * 2], current[i * 2 + 1] }, { disk[0], disk[1] } });
+				continue;
+			}
+			reload.aUpdates.push_back({ staged.iView, i, { current[i * 2], current[i * 2 + 1] }, { disk[0], disk[1] } });
+			current[i * 2] = disk[0];
+			current[i * 2 + 1] = disk[1];
+		}
+	}
+	reload.nFiles = aStaged.size();
+	return reload;
+}
+
+
+bool ProjectData::isEdited(int iView, int iLandmark) const
+{
+	const std::vector<float> &current = m_aLandmarkCoordsSets[iView];
+	const std::vector<float> &saved = m_aSavedLandmarkSets[iView];
+	return current[iLandmark * 2] != saved[iLandmark * 2] || current[iLandmark * 2 + 1] != saved[iLandmark * 2 + 1];
+}
+
+
+void ProjectData::saveLandmarks(unsigned int iPickedFace)
+{
+	TRACE_SCOPE("ProjectData::saveLandmarks");
+	std::cout << "save landmark from face " << iPickedFace << std::endl;
+
+	auto landmarkCoords = m_aLandmarkCoordsSets[iPickedFace];
+	auto now = std::chrono::system_clock::now();
+	time_t tt = std::chrono::system_clock::to_time_t(now);
+	std::string strTime = ctime(&tt);
+	strTime = strTime.substr(4, 3) + "_" + strTime.substr(9, 1) + "_" + strTime.substr(11, 8);
+	fs::path landmarkFile = m_dirFacialLdmk / (file_utils::Id2Str(iPickedFace) + ".txt");
+	if(fs::exists(landmarkFile))
+	{
+		fs::rename(landmarkFile, fs::path(m_dirFacialLdmk / (file_utils::Id2Str(iPickedFace)
+			+ "_" + strTime + ".backup")));
+		std::ofstream out(landmarkFile.string());
+		for (int i = 0; i < N_FACIAL_LDMKS; ++i)
+		{
+			out << std::scientific << std::setprecision(19) 
+				<< landmarkCoords[i * 2] << " " << landmarkCoords[i * 2 + 1] << "\n";
+		}
+		out.close();
+		std::copy(landmarkCoords.begin(), landmarkCoords.begin() + N_FACIAL_LDMKS * 2, m_aSavedLandmarkSets[iPickedFace].begin());
+	}
+	landmarkFile = m_dirEarLdmk / (file_utils::Id2Str(iPickedFace) + ".txt");
+
+	if(fs::exists(landmarkFile))
+	{
+		fs::rename(landmarkFile, fs::path(m_dirEarLdmk / (file_utils::Id2Str(iPickedFace)
+			+ "_" + strTime + ".backup")));
+		std::ofstream out(landmarkFile.string());
+		for (int i = N_FACIAL_LDMKS; i < N_LANDMARKS; ++i)
+		{
+			out << std::scientific << std::setprecision(19) 
+				<< landmarkCoords[i * 2] << " " << landmarkCoords[i * 2 + 1] << "\n";
+		}
+		out.close();
+		std::copy(landmarkCoords.begin() + N_FACIAL_LDMKS * 2, landmarkCoords.end(), m_aSavedLandmarkSets[iPickedFace].begin() + N_FACIAL_LDMKS * 2);
+	}
+}
+
+
+fs::path ProjectData::photoPath(int i) const
+{
+	fs::path pathTexture = m_pathPhotoDir / (file_utils::Id2Str(i) + ".jpg");
+	if(!fs::exists(pathTexture))
+		pathTexture = m_pathPhotoDir / (file_utils::Id2Str(i) + ".JPG");
+	return pathTexture;
+}
+
+
+void ProjectData::loadTextures()
+{
+	TRACE_SCOPE("ProjectData::loadTextures");
+	std::cout << "Load texture" << std::endl;
+	m_aTextures.resize(N_VIEWS);
+	std::vector<fs::path> aPaths;
+	for (auto i = 0; i < N_VIEWS; i++)
+	{
+		aPaths.push_back(photoPath(i));
+		std::cout << "Load texture: " << aPaths.back().string() << std::endl;
+	}
+	// one photo per task, decoded side by side
+	utils::parallelFor(aPaths.size(), utils::hardwareThreads(), [&](size_t i) {
+		TRACE_SCOPE("Decode photo");
+		m_aTextures[i] = Texture(aPaths[i].string());
+		if (m_aTextures[i].data)
+		{
+			g_memoryRegistry.set("Photos", "view " + std::to_string(i) + " pixels", MemoryRegistry::Location_Host,
+				size_t(m_aTextures[i].width) * m_aTextures[i].height * m_aTextures[i].channels);
+		}
+	});
+}
+
+
+void ProjectData::releasePixels()
+{
+	for (size_t i = 0; i < m_aTextures.size(); ++i)
+	{
+		if (!m_aTextures[i].data)
+			continue;
+		stbi_image_free(m_aTextures[i].data);
+		m_aTextures[i].data = nullptr;
+		g_memoryRegistry.release("Photos", "view " + std::to_string(i) + " pixels");
+	}
+}
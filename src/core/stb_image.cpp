@@ -0,0 +1,3 @@
+// the single translation unit holding the stb_image decoder
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
@@ -0,0 +1,3 @@
+// the single translation unit holding the stb_image_write encoder
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
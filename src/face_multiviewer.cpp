@@ -16,11 +16,34 @@
 
 #include "data_manager.h"
 #include "gl/render_manager.h"
+#include "gl/framebuffer.h"
+#include "gl/headless_context.h"
+#include "batch_renderer.h"
+#include "soft/soft_batch_renderer.h"
 #include "camera.h"
 #include "rotate_camera.h"
-
+#include "landmark_grid.h"
+#include "epipolar_geometry.h"
+#include "landmark_triangulator.h"
+#include "landmark_raycaster.h"
+#include "landmark_propagator.h"
+#include "landmark_history.h"
+#include "view_depth_cache.h"
+#include "profiler.h"
+#include "resolution_scaler.h"
+#include "memory_panel.h"
+#include "utils/trace.h"
+#include "utils/photo_utils.h"
+#include "utils/file_watcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
 
 namespace bpo = boost::program_options;
 
@@ -50,7 +73,14 @@ void Overall2DetailedMode();
 void Detailed2OverallMode();
 
 void HelpMarker(const char* desc);
-std::vector<float> PhotoPts2ScrPts(const std::vector<float> &photoPts, float height, float width, RotateType rotateType);
+int PickView(double xCursorPos, double yCursorPos, int scrWidth, int scrHeight, 
+	const std::vector<Eigen::Matrix4f> &aQuadInvModels);
+void RebuildLandmarkGrid(const std::vector<float> &scrPts, const std::vector<float> &photoPts);
+void OnLandmarkMoved(int iView, int iLandmark);
+void AcceptCandidate(size_t i);
+bool PollFileChanges();
+std::string DefaultShaderCacheDir();
+int RunBatch(const std::vector<std::string> &aProjDirs, const std::string &sOutDir, bool bSoftware);
 
 SceneMode g_sceneMode = SceneMode_Overall;
 
@@ -60,6 +90,9 @@ const unsigned int SCR_HEIGHT = 600;
 
 const float LANDMARK_SIZE = 0.002;
 
+// max screen-space error (pixels) of a mesh LOD before a finer one is drawn
+float g_fLodPixelError = 1.f;
+
 // camera
 RotateCamera g_cam;
 RotateCamera g_lastCam = g_cam;
@@ -80,34 +113,126 @@ int g_iPickedView = NO_PICKED_FACE;
 int g_iPickedLandmark = NO_PICKED_LANDMARK;
 int g_iExptView = 0;
 glm::vec2 landmarkOffset = glm::vec2(0.f, 0.f);
+bool g_bLeftWasPressed = false;
+
+// landmark hit-testing
+LandmarkGrid g_landmarkGrid;
+int g_iLandmarkGridView = NO_PICKED_FACE;
+float g_fPickTolerance = 6.f;	// pixels beyond the marker
 
 // pure color
 const glm::vec3 RED = glm::vec3(1.f, 0.f, 0.f);
 const glm::vec3 YELLOW = glm::vec3(1.f, 1.f, 0.f);
 const glm::vec3 LANDMARK_COLOR = RED;
 const glm::vec3 PICKED_LANDMARK_COLOR = YELLOW;
+const glm::vec3 OUTLIER_LANDMARK_COLOR = glm::vec3(1.f, 0.f, 1.f);
+const glm::vec3 REPROJECTED_LANDMARK_COLOR = glm::vec3(0.f, 1.f, 1.f);
+const glm::vec3 RAY_COLOR = glm::vec3(1.f, 1.f, 1.f);
+const glm::vec3 EPIPOLAR_LINE_COLOR = glm::vec3(0.f, 1.f, 0.f);
+const glm::vec3 CANDIDATE_LANDMARK_COLOR = glm::vec3(1.f, 0.5f, 0.f);
+
+// landmarks triangulated across views; annotations far from their reprojection are outliers
+LandmarkTriangulator g_triangulator;
+bool g_bShowOutliers = true;
+
+// epipolar lines of the picked landmark from the other views, in the landmark pane
+EpipolarGeometry g_epipolar;
+bool g_bShowEpipolarLines = true;
+std::vector<float> g_aEpipolarSegments;
+
+// annotations cast onto the mesh surface; the picked landmark's ray ends at its hit
+LandmarkRaycaster g_raycaster;
+std::vector<std::vector<MeshBvh::Hit>> g_aLandmarkHits;	// of the last "cast all"
+float g_fCastAllMs = 0.f;
+
+// landmark positions projected from 3D into the other views, pending the user's decision
+LandmarkPropagator g_propagator;
+bool g_bPropagateFromSurface = true;	// else from the triangulation
+bool g_bPropagateVisibleOnly = true;
+
+// mesh depth seen from each camera, rendered on the CPU when a view is first queried
+ViewDepthCache g_depthCache;
+
+// annotation files and the model rewritten by other tools are picked up while the project is open
+utils::FileWatcher g_fileWatcher;
+std::vector<ProjectData::LandmarkConflict> g_aConflicts;	// changed on disk and edited here, unresolved
+
+// with --dev, shaders edited under SHADER_DIR are relinked in place
+bool g_bDevMode = false;
+utils::FileWatcher g_shaderWatcher;
 
 //	DataManager *g_pDataManager = new DataManager("D:/database/face_zzm/project");
 DataManager *g_pDataManager = nullptr;
 RenderManager *g_pRenderManager = new RenderManager();
 
+// cached left pane of the detailed mode and the inputs it was rendered with
+struct LeftPaneState
+{
+	glm::mat4 proj = glm::mat4(0.f);
+	glm::mat4 view = glm::mat4(0.f);
+	int width = 0;
+	int height = 0;
+	int iView = -1;
+	int iLandmark = -1;
+	glm::vec2 landmarkCoord = glm::vec2(0.f);
+	float lodPixelError = 0.f;
+	unsigned int modelVersion = 0;
+	glm::vec3 rayColor = glm::vec3(0.f);
+	float rayLength = 0.f;	// depth of the ray's surface hit, 0 while it misses
+	float scale = 1.f;	// of width x height actually rendered
+
+	bool operator==(const LeftPaneState &o) const
+	{
+		return proj == o.proj && view == o.view && width == o.width && height == o.height && 
+			iView == o.iView && iLandmark == o.iLandmark && landmarkCoord == o.landmarkCoord &&
+			lodPixelError == o.lodPixelError && modelVersion == o.modelVersion && rayColor == o.rayColor &&
+			rayLength == o.rayLength && scale == o.scale;
+	}
+};
+Framebuffer *g_pLeftPaneFbo = new Framebuffer("left pane");
+LeftPaneState g_leftPaneState;
+unsigned int g_uModelVersion = 0;	// bumped whenever the uploaded mesh data changes
+
+// dynamic resolution of the 3D views; the landmark pane always renders at native resolution
+ResolutionScaler g_resolutionScaler;
+Framebuffer *g_pSceneFbo = new Framebuffer("overall scene");
+
+// frame profiler HUD, toggled with F3, history dumped with F4 while it is on
+FrameProfiler g_profiler;
+
+// Chrome trace output, empty when tracing is off
+std::string g_sTracePath;
+
+// memory panel, toggled with F5, and the JSON report written on exit
+MemoryPanel g_memoryPanel;
+bool g_bShowMemory = false;
+std::string g_sMemoryReportPath;
+
 glm::mat4 g_mProj;
 glm::mat4 g_mView;
 
-// change landmark Log
+// landmark edits, undone with Ctrl-Z and redone with Ctrl-Y; also the change log
 bool g_bSelectLandmark = false;
-std::vector<std::string> g_aChangeLog;
-std::string g_sLog;
+LandmarkHistory g_history;
 
 
 int main(int argc, char* argv[])
 {
-	std::string sProjDir;
+	std::vector<std::string> aProjDirs;
+	std::string sBatchDir;
+	bool bSoftware = false;
+	std::string sShaderCache;
     bpo::options_description opt("All options");
 	bpo::variables_map vm;
 
 	opt.add_options()
-		("project,p", bpo::value<std::string>(&sProjDir), "Project root directory")
+		("project,p", bpo::value<std::vector<std::string>>(&aProjDirs)->multitoken(), "Project root directory (several with --batch)")
+		("batch", bpo::value<std::string>(&sBatchDir), "Render QA images of all views of every project into this directory, without a window")
+		("software", bpo::bool_switch(&bSoftware), "With --batch, rasterize on the CPU instead of OpenGL")
+		("trace", bpo::value<std::string>(&g_sTracePath), "Record trace zones and write them as Chrome trace JSON to this file")
+		("memory-report", bpo::value<std::string>(&g_sMemoryReportPath), "Write the resource memory accounting as JSON to this file on exit")
+		("shader-cache", bpo::value<std::string>(&sShaderCache)->default_value(DefaultShaderCacheDir()), "Keep linked shader binaries in this directory, empty to disable")
+		("dev", bpo::bool_switch(&g_bDevMode), "Watch the shader directory and relink edited shaders while running")
 		("help,h", "A viewer for facial multiview, used for modifying landmarks.");
 	try
 	{
@@ -127,11 +252,29 @@ int main(int argc, char* argv[])
 		return EXIT_SUCCESS;  
     }
 
+	if (!g_sTracePath.empty())
+	{
+		trace_utils::setThreadName("main");
+		trace_utils::setEnabled(true);
+	}
+
+	g_programCache.setDirectory(sShaderCache);
+
+	if (vm.count("batch"))
+	{
+		int ret = RunBatch(aProjDirs, sBatchDir, bSoftware);
+		if (!g_sTracePath.empty())
+			trace_utils::writeChromeTrace(g_sTracePath);
+		if (!g_sMemoryReportPath.empty())
+			g_memoryRegistry.writeJson(g_sMemoryReportPath);
+		return ret;
+	}
+
 	if(vm.count("project"))
 	{
 		// "/home/bemfoo/Data/static_face_test/full_head_examples/old_man/project/"
 		// "/home/bemfoo/Data/face_zzm/project/"
-		g_pDataManager = new DataManager(sProjDir);
+		g_pDataManager = new DataManager(aProjDirs.front());
 	}
 
 	glfwInit();
@@ -160,6 +303,7 @@ int main(int argc, char* argv[])
 		return EXIT_FAILURE;
 	}
 
+	g_programCache.loadEntryPoints((GLADloadproc)glfwGetProcAddress);
 	stbi_set_flip_vertically_on_load(true);
 
 	// init imgui
@@ -175,31 +319,43 @@ int main(int argc, char* argv[])
 	glEnable(GL_PROGRAM_POINT_SIZE);
 
 	// Shader
+	auto shaderStart = std::chrono::steady_clock::now();
 	Shader modelShader(SHADER_DIR"model.vs", SHADER_DIR"model.fs");
 	Shader camShader(SHADER_DIR"cam.vs", SHADER_DIR"cam.fs");
 	Shader quadShader(SHADER_DIR"quad.vs", SHADER_DIR"quad.fs");
 	Shader pointsShader(SHADER_DIR"points.vs", SHADER_DIR"points.fs");
 	Shader lineShader(SHADER_DIR"line.vs", SHADER_DIR"line.fs");
-
+	Shader epipolarShader(SHADER_DIR"epipolar.vs", SHADER_DIR"line.fs");
+	Shader *aShaders[] = { &modelShader, &camShader, &quadShader, &pointsShader, &lineShader, &epipolarShader };
+	std::cout << "Shaders ready in " << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - shaderStart).count()
+		<< " ms, " << g_programCache.hits() << " of " << std::size(aShaders) << " from the cache." << std::endl;
+	if (g_bDevMode && !g_shaderWatcher.watch(fs::path(SHADER_DIR).lexically_normal().parent_path().string()))
+		std::cout << "Not watching " << SHADER_DIR << " for changes." << std::endl;
+
+	g_pDataManager->loadModel(true, true, true);
 	g_pDataManager->bindTextures();
-	g_pDataManager->loadModel();
 	// g_pRenderManager = new RenderManager();
 
 	auto nViews = g_pDataManager->getFaces();
 	const Model *faceModel = g_pDataManager->getModel();
-	const std::vector < Eigen::Matrix<float, 3, 4>> &aProjMatrices = g_pDataManager->getProjMatrices();
 	const std::vector<Eigen::Matrix4f> &aInvTransMatrices = g_pDataManager->getInvTransMatrices();
 	const std::vector<Eigen::Vector3f> &aCamPositions = g_pDataManager->getCamPositions();
 	std::vector<std::vector<float>> &aLandmarkCoordsSets = g_pDataManager->getLandmarkCoordsSets();
 	const std::vector<Texture> &aTextures = g_pDataManager->getTextures();
 
-	modelShader.use();
-	std::string strLightPos;
-	for (std::size_t i = 0; i < nViews; ++i)
-	{
-		strLightPos = "lightPosArr[" + std::to_string(i) + "]";
-		glUniform3fv(glGetUniformLocation(modelShader.ID, strLightPos.c_str()), 1, aCamPositions[i].data());
-	}
+	// uniforms set once, again whenever a program is relinked
+	auto setStaticUniforms = [&]() {
+		modelShader.use();
+		std::string strLightPos;
+		for (std::size_t i = 0; i < nViews; ++i)
+		{
+			strLightPos = "lightPosArr[" + std::to_string(i) + "]";
+			glUniform3fv(glGetUniformLocation(modelShader.ID, strLightPos.c_str()), 1, aCamPositions[i].data());
+		}
+		quadShader.use();
+		quadShader.setVec3("PureColor", LANDMARK_COLOR);	// mark landmarks as red
+	};
+	setStaticUniforms();
 
 	Eigen::Matrix4f trans, model;
 	Eigen::Matrix4f matPhotoScale;
@@ -207,34 +363,87 @@ int main(int argc, char* argv[])
 	double faceHeight = g_pDataManager->getHeight();
 	std::cout << "View width " << faceWidth << " height " << faceHeight << std::endl;
 
+	const PhotoCameras &cameras = g_pDataManager->getCameras();
+	g_epipolar.setCameras(&cameras);
+	g_triangulator.setCameras(cameras);
+	g_triangulator.solve(aLandmarkCoordsSets);
+	std::cout << g_triangulator.outlierCount() << " landmark annotation(s) off by more than " 
+		<< g_triangulator.outlierThreshold << " px from their triangulation." << std::endl;
+
 	double f = g_pDataManager->getF();
 	double invF = 1. / f;
 	double cx = g_pDataManager->getCx();
 	double cy = g_pDataManager->getCy();
 	double faceScale = 0.6 / f;
 
-	quadShader.use();
-	quadShader.setVec3("PureColor", LANDMARK_COLOR);	// mark landmarks as red
+	g_raycaster.setCameras(aInvTransMatrices, f, cx, cy, faceWidth, faceHeight);
+	g_raycaster.startBuild(*faceModel);
+	g_propagator.setCameras(&cameras);
+	g_depthCache.setCameras(&cameras);
+	g_depthCache.setModel(faceModel);
+
+	for (const fs::path &dir : { g_pDataManager->facialLandmarkDir(), g_pDataManager->earLandmarkDir(), g_pDataManager->rootDir() })
+	{
+		if (!g_fileWatcher.watch(dir.string()))
+			std::cout << "Not watching " << dir.string() << " for changes." << std::endl;
+	}
+
+	// Camera quads are static, so their world-to-quad transforms are computed once for picking
+	std::vector<Eigen::Matrix4f> aQuadInvModels(nViews);
+	for (int i = 0; i < nViews; ++i)
+	{
+		aQuadInvModels[i] = utils::scale(Eigen::Matrix4f(aInvTransMatrices[i]), 
+			float(faceWidth * faceScale), float(faceHeight * faceScale), 0.5f).inverse();
+	}
 
-	uByte ucScrData[3];
 	int scrWidth, scrHeight;
 	double xCursorPos, yCursorPos;
 
 	while (!glfwWindowShouldClose(window))
 	{
+		TRACE_SCOPE("Frame");
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+		g_profiler.beginFrame();
+		g_profiler.beginPass("Input");
 		ProcessInput(window);
+		{
+			TRACE_SCOPE("DataManager::updateModel");
+			if (g_pDataManager->updateModel())
+				++g_uModelVersion;
+		}
+		if (g_raycaster.poll())
+			std::cout << "Surface BVH: " << g_raycaster.bvh().triangleCount() << " triangles, " << g_raycaster.bvh().nodeCount()
+				<< " nodes, built in " << g_raycaster.buildMs() << " ms." << std::endl;
+		if (PollFileChanges())
+			faceModel = g_pDataManager->getModel();
+		if (g_bDevMode)
+		{
+			bool bRelinked = false;
+			for (const std::string &path : g_shaderWatcher.poll(100))
+			{
+				for (Shader *pShader : aShaders)
+					bRelinked = (pShader->uses(path) && pShader->reload()) || bRelinked;
+			}
+			if (bRelinked)
+			{
+				setStaticUniforms();
+				++g_uModelVersion;	// redraws the cached left pane
+			}
+		}
 		glfwGetWindowSize(window, &scrWidth, &scrHeight);
 		glfwGetCursorPos(window, &xCursorPos, &yCursorPos);
 		glViewport(0, 0, scrWidth, scrHeight);
 		g_mView = g_cam.GetViewMatrix();
 
+		g_profiler.beginPass("GUI build");
 		if(DrawGui(window))
 		{
+			g_profiler.beginPass("GUI render");
 			ImGui::Render();
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			g_profiler.endPass();
 			glfwSwapBuffers(window);
 			glfwPollEvents();
 			continue;
@@ -242,6 +451,7 @@ int main(int argc, char* argv[])
 		
 		if (g_sceneMode == SceneMode_Overall)
 		{
+			TRACE_SCOPE("Overall scene");
 			glDisable(GL_SCISSOR_TEST);
 
 			g_mProj = glm::perspective(glm::radians(g_cam.Zoom), (float)scrWidth / (float)scrHeight, 0.1f, 5000.0f);
@@ -250,53 +460,33 @@ int main(int argc, char* argv[])
 			float camY = cos(glfwGetTime() / 10.0) * radius;
 			g_mView = glm::lookAt(glm::vec3(0.f, camY, camZ), glm::vec3(0.f, 0.f, 0.f), glm::vec3(1.f, 0.f, 0.f));
 
-			quadShader.use();
-			quadShader.setInt("RenderMode", RenderMode_ColorPicking);  
-			quadShader.setMat4("Proj", g_mProj);
-			quadShader.setMat4("View", g_mView);
-
-			// Render color-picking
-			glClearColor(1.0f, NO_PICKED_FACE / 255.0f, 1.0f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-			for (int i = 0; i < N_VIEWS; ++i)
-			{
-				trans = aInvTransMatrices[i];
-				quadShader.setMat4("Model", 
-					utils::scale(trans, float(faceWidth * faceScale), float(faceHeight * faceScale), 0.5f));
-				quadShader.setFloat("FaceIdx", (float)i);
-				quadShader.setFloat("LandmarkIdx", 255.0 * 255.0);
-				g_pRenderManager->RenderQuad(RotateType_No);
-			}
-
+			// Ray-cast picking against the photo quads, no extra render pass or read-back
+			g_profiler.beginPass("Picking");
 			if(xCursorPos > 0 && yCursorPos > 0 &&
 				xCursorPos < scrWidth && yCursorPos < scrHeight)
 			{
-				std::cout << xCursorPos << " " << yCursorPos << std::endl;
-				glReadPixels(xCursorPos, scrHeight - yCursorPos, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, ucScrData); 
-				g_iPickedView = ucScrData[0]; // Value-red -> View id
-
-				if (g_iPickedView != NO_PICKED_FACE)	// Not background 
-				{
+				int iLastPickedView = g_iPickedView;
+				g_iPickedView = PickView(xCursorPos, yCursorPos, scrWidth, scrHeight, aQuadInvModels);
+				if (g_iPickedView != NO_PICKED_FACE && g_iPickedView != iLastPickedView)
 					std::cout << "Chosen view: " << g_iPickedView << std::endl;
-					std::vector<float> aLandmarkCoords = aLandmarkCoordsSets[g_iPickedView];
-				}
 			}
 			else
 			{
 				g_iPickedView = NO_PICKED_FACE;
 			}
 
-			// For color-picking debug
-			// {
-			// 	ImGui::Render();
-			// 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-			// 	glfwSwapBuffers(window);
-			// 	glfwPollEvents();
-			// 	continue;
-			// }
-
-			// Render scene
+			// Render scene, into a reduced-resolution target while frames run over budget;
+			// the camera orbits continuously, so this view always counts as moving
+			g_profiler.beginPass("Model");
+			float sceneScale = g_resolutionScaler.update(deltaTime * 1000.f, true);
+			int sceneWidth = std::max(1, int(scrWidth * sceneScale));
+			int sceneHeight = std::max(1, int(scrHeight * sceneScale));
+			bool bSceneScaled = sceneWidth != scrWidth || sceneHeight != scrHeight;
+			if (bSceneScaled)
+			{
+				g_pSceneFbo->resize(scrWidth, scrHeight);
+				g_pSceneFbo->bind(sceneWidth, sceneHeight);
+			}
 			glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // Black background
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -305,8 +495,9 @@ int main(int argc, char* argv[])
 			modelShader.setMat4("Proj", g_mProj);
 			modelShader.setMat4("View", g_mView);
 			modelShader.setVec3("ViewPos", glm::vec3(0.f, camY, camZ));
-			faceModel->Draw(modelShader);
+			faceModel->Draw(modelShader, g_mProj, g_mView, sceneHeight, g_fLodPixelError);
 
+			g_profiler.beginPass("Photo quads");
 			camShader.use();
 			camShader.setMat4("Proj", g_mProj);
 			camShader.setVec3("ViewPos", glm::vec3(0.f, camY, camZ));
@@ -323,6 +514,7 @@ int main(int argc, char* argv[])
 					utils::scale(trans, float(faceWidth * faceScale), float(faceHeight * faceScale), 0.5f));
 				glActiveTexture(GL_TEXTURE0);
 				glBindTexture(GL_TEXTURE_2D, aTextures[i].id);
+				++g_drawStats.stateChanges;
 				g_pRenderManager->RenderQuad(RotateType_No);
 
 				glEnable(GL_CULL_FACE);
@@ -331,57 +523,119 @@ int main(int argc, char* argv[])
 				g_pRenderManager->RenderCube();
 				glDisable(GL_CULL_FACE);
 			}
+
+			if (bSceneScaled)
+			{
+				glViewport(0, 0, scrWidth, scrHeight);
+				g_pSceneFbo->blitRegionTo(sceneWidth, sceneHeight, 0, 0, scrWidth, scrHeight, GL_LINEAR);
+			}
 		}
 		else if (g_sceneMode == SceneMode_Detailed)
 		{
+			TRACE_SCOPE("Detailed scene");
+			g_profiler.beginPass("Left pane");
 			g_mView = g_deCam.GetViewMatrix();
 			auto itLandmarkCoords = aLandmarkCoordsSets.begin() + g_iPickedView;
-			std::vector<float> scrPts = PhotoPts2ScrPts(*itLandmarkCoords, faceHeight, faceWidth, k_aRotTypes[g_iPickedView]);
-
-			// Left part: Model
-			glEnable(GL_SCISSOR_TEST);
-			glViewport(0, 0, scrWidth / 2, scrHeight);
-			glScissor(0, 0, scrWidth / 2, scrHeight);
-			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			std::vector<float> scrPts = photo_utils::PhotoPts2ScrPts(*itLandmarkCoords, faceHeight, faceWidth, k_aRotTypes[g_iPickedView]);
 
+			// Left part: Model, re-rendered into its cache only when what it shows changes
+			int paneWidth = scrWidth / 2;
 			g_mProj = glm::perspective(glm::radians(g_deCam.Zoom), (float)scrWidth / (float)scrHeight / 2.f, 0.1f, 5000.0f);
-			glm::mat4 invProjView = glm::inverse(g_mProj * g_mView);
 
-			modelShader.use();
-			modelShader.setMat4("Proj", g_mProj);
-			modelShader.setMat4("View", g_mView);
-			modelShader.setVec3("ViewPos", g_deCam.Position);
-			faceModel->Draw(modelShader);
+			LeftPaneState paneState;
+			paneState.proj = g_mProj;
+			paneState.view = g_mView;
+			paneState.width = paneWidth;
+			paneState.height = scrHeight;
+			paneState.iView = g_iPickedView;
+			paneState.iLandmark = g_iPickedLandmark;
+			paneState.landmarkCoord = g_iPickedLandmark < itLandmarkCoords->size() ?
+				glm::vec2(itLandmarkCoords->at(g_iPickedLandmark * 2), itLandmarkCoords->at(g_iPickedLandmark * 2 + 1)) : glm::vec2(0.f);
+			paneState.lodPixelError = g_fLodPixelError;
+			paneState.modelVersion = g_uModelVersion;
+			paneState.rayColor = g_bShowOutliers && g_triangulator.isOutlier(g_iPickedView, g_iPickedLandmark) ? 
+				OUTLIER_LANDMARK_COLOR : RAY_COLOR;
+			MeshBvh::Hit rayHit = g_iPickedLandmark < itLandmarkCoords->size() ?
+				g_raycaster.castLandmark(g_iPickedView, paneState.landmarkCoord.x, paneState.landmarkCoord.y) : MeshBvh::Hit();
+			paneState.rayLength = rayHit.valid() ? rayHit.t : 0.f;
+
+			// Moving while anything but the resolution differs from the cached render; once it
+			// stops the scaler asks for full resolution, which re-renders the pane sharp
+			LeftPaneState cachedContent = g_leftPaneState;
+			cachedContent.scale = paneState.scale;
+			paneState.scale = g_resolutionScaler.update(deltaTime * 1000.f, !(paneState == cachedContent));
 
-			if (g_iPickedLandmark < itLandmarkCoords->size())
+			glEnable(GL_SCISSOR_TEST);
+			if (g_pLeftPaneFbo->resize(paneWidth, scrHeight) || !(paneState == g_leftPaneState))
 			{
-				Eigen::Matrix4f invTransMat = aInvTransMatrices[g_iPickedView];
-				float x = (itLandmarkCoords->at(g_iPickedLandmark * 2) - faceWidth * 0.5 - cx) * invF;
-				float y = (itLandmarkCoords->at(g_iPickedLandmark * 2 + 1) - faceHeight * 0.5 - cy) * invF;
+				g_leftPaneState = paneState;
+				int renderHeight = std::max(1, int(scrHeight * paneState.scale));
+				g_pLeftPaneFbo->bind(std::max(1, int(paneWidth * paneState.scale)), renderHeight);
+				glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-				lineShader.use();
-				lineShader.setMat4("Proj", g_mProj);
-				lineShader.setMat4("View", g_mView);
-				lineShader.setMat4("Model", invTransMat);
-				lineShader.setVec4("EndPoint", x, y, 1.f, 1.f); // TODO
-				std::cout << x << " " << y << std::endl;
-				g_pRenderManager->RenderLine();
+				modelShader.use();
+				modelShader.setMat4("Proj", g_mProj);
+				modelShader.setMat4("View", g_mView);
+				modelShader.setVec3("ViewPos", g_deCam.Position);
+				faceModel->Draw(modelShader, g_mProj, g_mView, renderHeight, g_fLodPixelError);
+
+				if (g_iPickedLandmark < itLandmarkCoords->size())
+				{
+					Eigen::Matrix4f invTransMat = aInvTransMatrices[g_iPickedView];
+					float x = (itLandmarkCoords->at(g_iPickedLandmark * 2) - faceWidth * 0.5 - cx) * invF;
+					float y = (itLandmarkCoords->at(g_iPickedLandmark * 2 + 1) - faceHeight * 0.5 - cy) * invF;
+
+					lineShader.use();
+					lineShader.setMat4("Proj", g_mProj);
+					lineShader.setMat4("View", g_mView);
+					lineShader.setMat4("Model", invTransMat);
+					// line.vs scales EndPoint by its fixed strength; a hit ends the ray on the surface
+					float rayScale = rayHit.valid() ? rayHit.t / 200.f : 1.f;
+					lineShader.setVec4("EndPoint", x * rayScale, y * rayScale, rayScale, 1.f);
+					lineShader.setVec3("LineColor", paneState.rayColor);
+					g_pRenderManager->RenderLine();
+
+					if (rayHit.valid())
+					{
+						// cam.vs draws the unit cube at a tenth of its size
+						glm::vec3 extent = g_raycaster.bvh().boundsMax() - g_raycaster.bvh().boundsMin();
+						float markerSize = glm::length(extent) * 0.004f / 0.1f;
+						camShader.use();
+						camShader.setMat4("Proj", g_mProj);
+						camShader.setMat4("View", g_mView);
+						camShader.setVec3("ViewPos", g_deCam.Position);
+						camShader.setMat4("Model", glm::scale(glm::translate(glm::mat4(1.f), rayHit.point), glm::vec3(markerSize)));
+						g_pRenderManager->RenderCube();
+					}
+				}
+				g_pLeftPaneFbo->unbind();
+			}
+			glViewport(0, 0, paneWidth, scrHeight);
+			glScissor(0, 0, paneWidth, scrHeight);
+			if (g_leftPaneState.scale < 1.f)
+			{
+				g_pLeftPaneFbo->blitRegionTo(std::max(1, int(paneWidth * g_leftPaneState.scale)), 
+					std::max(1, int(scrHeight * g_leftPaneState.scale)), 0, 0, paneWidth, scrHeight, GL_LINEAR);
 			}
+			else
+				g_pLeftPaneFbo->blitTo(0, 0, paneWidth, scrHeight);
 		
 			// Right part: Landmarks
+			g_profiler.beginPass("Landmarks");
 			glViewport(scrWidth / 2, 0, scrWidth / 2, scrHeight);
 			glScissor(scrWidth / 2, 0, scrWidth / 2, scrHeight);
 	
+			float xMin = -1.f, xMax = 1.f, yMin = -1.f, yMax = 1.f;
 			if(g_bSelectLandmark)
 			{
 				float halfWinSize = 0.15f;
 				float x = scrPts[g_iPickedLandmark * 2];
 				float y = scrPts[g_iPickedLandmark * 2 + 1];
-				g_mProj = glm::ortho(x - halfWinSize, x + halfWinSize, y - halfWinSize, y + halfWinSize, 0.1f, 100.0f);
+				xMin = x - halfWinSize; xMax = x + halfWinSize;
+				yMin = y - halfWinSize; yMax = y + halfWinSize;
 			}
-			else
-				g_mProj = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, 0.1f, 100.0f);
+			g_mProj = glm::ortho(xMin, xMax, yMin, yMax, 0.1f, 100.0f);
 			g_mView = glm::lookAt(glm::vec3(0.0, 0.0, 5.0), glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
 			
 			quadShader.use();
@@ -391,56 +645,45 @@ int main(int argc, char* argv[])
 			// store color
 			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-			if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && g_bSelectLandmark == false)
-			{
-				// Color-picking
-				glClearColor(0.0f, 0.0f, 1.0f, 1.0f);
-				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-				quadShader.setInt("RenderMode", RenderMode_ColorPicking);
-				quadShader.setFloat("FaceIdx", 0.0f); // Irrelevant
+			float pointSize = g_bSelectLandmark ? 0.001f : 0.008f;
+			if (g_iLandmarkGridView != g_iPickedView)
+				RebuildLandmarkGrid(scrPts, *itLandmarkCoords);
 
-				glm::mat4 quadModel(1.0f);
-				for (int i = 0; i < itLandmarkCoords->size() / 2; ++i)
+			bool bLeftPressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+			if (bLeftPressed && !g_bLeftWasPressed && !ImGui::GetIO().WantCaptureMouse
+				&& xCursorPos > scrWidth * 0.5 && xCursorPos < scrWidth
+				&& yCursorPos > 0.0 && yCursorPos < scrHeight) // Valid cursor
+			{
+				// Cursor to pane coordinates, tolerance in pixels on top of the marker half-size
+				float paneWidth = scrWidth / 2;
+				float xPane = xMin + (xCursorPos - scrWidth / 2) / paneWidth * (xMax - xMin);
+				float yPane = yMin + (scrHeight - yCursorPos) / scrHeight * (yMax - yMin);
+				float rx = pointSize + g_fPickTolerance * (xMax - xMin) / paneWidth;
+				float ry = pointSize + g_fPickTolerance * (yMax - yMin) / scrHeight;
+
+				int iHit = g_landmarkGrid.query(xPane, yPane, rx, ry);
+				if (iHit != LandmarkGrid::NO_LANDMARK)
 				{
-					if(itLandmarkCoords->at(i * 2) == 0.f && itLandmarkCoords->at(i * 2 + 1) == 0.f) continue;
-					quadShader.use();
-					glm::mat4 quadModel(1.0f);
-					quadModel = glm::translate(quadModel, glm::vec3(scrPts[i * 2], scrPts[i * 2 + 1], 0.0f));
-					quadModel = glm::scale(quadModel, glm::vec3(0.01f, 0.01f, 1.1f));
-					quadShader.setMat4("Model", quadModel);
-					quadShader.setFloat("LandmarkIdx", static_cast<float>(i));
-					g_pRenderManager->RenderQuad(RotateType_No);
+					std::cout << "Choose Landmark: " << iHit << std::endl;
+					g_iPickedLandmark = iHit;
+					g_bSelectLandmark = true;
 				}
-
-				if (xCursorPos > scrWidth * 0.5 && xCursorPos < scrWidth
-					&& yCursorPos > 0.0 && yCursorPos < scrHeight) // Valid cursor
+				else if (!g_bSelectLandmark)	// keep the zoomed-in landmark on a miss
 				{
-					glReadPixels(xCursorPos, scrHeight - yCursorPos, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, ucScrData);
-					g_iPickedLandmark = ucScrData[1] + ucScrData[2] * 255;
-					std::cout << (int)ucScrData[0] << " " << (int)ucScrData[1] << " " << (int)ucScrData[2] << std::endl;
-					if (g_iPickedLandmark != NO_PICKED_LANDMARK)	// not background
-					{
-						std::cout << "Choose Landmark: " << g_iPickedLandmark << std::endl;
-						g_bSelectLandmark = true;
-					} 
-					else
-					{
-						g_bSelectLandmark = false;
-					}
+					g_iPickedLandmark = NO_PICKED_LANDMARK;
 				}
 			}
 			else if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
 			{
 				g_bSelectLandmark = false;
 			}
+			g_bLeftWasPressed = bLeftPressed;
 
 			// Draw landmarks
 			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			quadShader.setInt("RenderMode", RenderMode_PureColor);
 			
-			float pointSize = g_bSelectLandmark ? 0.001f : 0.008f;
 			for (int i = 0; i < itLandmarkCoords->size() / 2; ++i)
 			{
 				if(itLandmarkCoords->at(i * 2) == 0.f && itLandmarkCoords->at(i * 2 + 1) == 0.f) continue;
@@ -457,27 +700,88 @@ int main(int argc, char* argv[])
 				}
 				else
 				{
+					bool bOutlier = g_bShowOutliers && g_triangulator.isOutlier(g_iPickedView, i);
 					quadModel = glm::scale(quadModel, glm::vec3(pointSize, pointSize, 1.1f));
 					quadShader.setMat4("Model", quadModel);
-					quadShader.setVec3("PureColor", LANDMARK_COLOR);
+					quadShader.setVec3("PureColor", bOutlier ? OUTLIER_LANDMARK_COLOR : LANDMARK_COLOR);
 					g_pRenderManager->RenderQuad(RotateType_No);
 				}
+
+				// where the other views put an outlier, as a smaller marker
+				if (g_bShowOutliers && g_triangulator.isOutlier(g_iPickedView, i))
+				{
+					Eigen::Vector2f reprojected = g_triangulator.reproject(g_iPickedView, i);
+					glm::vec2 scrPt = photo_utils::PhotoPt2ScrPt(reprojected.x(), reprojected.y(), faceHeight, faceWidth, k_aRotTypes[g_iPickedView]);
+					quadModel = glm::translate(glm::mat4(1.0f), glm::vec3(scrPt.x, scrPt.y, 0.0f));
+					quadModel = glm::scale(quadModel, glm::vec3(pointSize * 0.6f, pointSize * 0.6f, 1.15f));
+					quadShader.setMat4("Model", quadModel);
+					quadShader.setVec3("PureColor", REPROJECTED_LANDMARK_COLOR);
+					g_pRenderManager->RenderQuad(RotateType_No);
+				}
+			}
+
+			// pending propagated positions in this view
+			for (const LandmarkPropagator::Candidate &c : g_propagator.candidates())
+			{
+				if (c.iView != g_iPickedView)
+					continue;
+				glm::vec2 scrPt = photo_utils::PhotoPt2ScrPt(c.pt.x(), c.pt.y(), faceHeight, faceWidth, k_aRotTypes[g_iPickedView]);
+				glm::mat4 quadModel = glm::translate(glm::mat4(1.0f), glm::vec3(scrPt.x, scrPt.y, 0.0f));
+				quadModel = glm::scale(quadModel, glm::vec3(pointSize * 0.8f, pointSize * 0.8f, 1.12f));
+				quadShader.setMat4("Model", quadModel);
+				quadShader.setVec3("PureColor", CANDIDATE_LANDMARK_COLOR);
+				g_pRenderManager->RenderQuad(RotateType_No);
 			}
 
+			if (g_bShowEpipolarLines && g_iPickedLandmark < N_LANDMARKS)
+			{
+				g_aEpipolarSegments.clear();
+				g_epipolar.segments(aLandmarkCoordsSets, g_iPickedView, g_iPickedLandmark, g_aEpipolarSegments);
+				for (size_t i = 0; i < g_aEpipolarSegments.size(); i += 2)
+				{
+					glm::vec2 scrPt = photo_utils::PhotoPt2ScrPt(g_aEpipolarSegments[i], g_aEpipolarSegments[i + 1], 
+						faceHeight, faceWidth, k_aRotTypes[g_iPickedView]);
+					g_aEpipolarSegments[i] = scrPt.x;
+					g_aEpipolarSegments[i + 1] = scrPt.y;
+				}
+				epipolarShader.use();
+				epipolarShader.setMat4("Proj", g_mProj);
+				epipolarShader.setMat4("View", g_mView);
+				epipolarShader.setVec3("LineColor", EPIPOLAR_LINE_COLOR);
+				g_pRenderManager->RenderLines(g_aEpipolarSegments);
+				quadShader.use();
+			}
+
+			g_profiler.beginPass("Photo");
 			quadShader.setMat4("Model", Eigen::Matrix4f::Identity());
 			quadShader.setInt("RenderMode", RenderMode_Texture);
 			glActiveTexture(GL_TEXTURE0);
 			glBindTexture(GL_TEXTURE_2D, aTextures[g_iPickedView].id);
+			++g_drawStats.stateChanges;
 			g_pRenderManager->RenderQuad(k_aRotTypes[g_iPickedView]);
 		}
 
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-		glfwSwapBuffers(window);
+		g_profiler.beginPass("GUI render");
+		{
+			TRACE_SCOPE("ImGui render");
+			ImGui::Render();
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		}
+		g_profiler.endPass();
+		{
+			TRACE_SCOPE("Swap buffers");
+			glfwSwapBuffers(window);
+		}
 		glfwPollEvents();
 	}
 
+	if (!g_sTracePath.empty())
+		trace_utils::writeChromeTrace(g_sTracePath);
+	if (!g_sMemoryReportPath.empty())
+		g_memoryRegistry.writeJson(g_sMemoryReportPath);
+
 	// Cleanup
+	g_profiler.release();
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -486,8 +790,55 @@ int main(int argc, char* argv[])
 }
 
 
+// Renders the QA images of every project on a surfaceless context, or on the CPU with
+// `bSoftware`; images are encoded on a thread pool while the next views render
+int RunBatch(const std::vector<std::string> &aProjDirs, const std::string &sOutDir, bool bSoftware)
+{
+	HeadlessContext context;
+	if (!bSoftware && !context.create())
+		return EXIT_FAILURE;
+
+	ImageWriter writer;
+	{
+		std::unique_ptr<BatchRenderer> pRenderer;
+		std::unique_ptr<SoftBatchRenderer> pSoftRenderer;
+		if (bSoftware)
+			pSoftRenderer.reset(new SoftBatchRenderer(writer));
+		else
+			pRenderer.reset(new BatchRenderer(writer));
+		for (const auto &sProjDir : aProjDirs)
+		{
+			fs::path pathProj = fs::path(sProjDir).lexically_normal();
+			if (!pathProj.has_filename())
+				pathProj = pathProj.parent_path();
+			std::cout << "Batch rendering " << pathProj << (bSoftware ? " (software)" : "") << std::endl;
+
+			DataManager dataManager(pathProj.string());
+			fs::path outDir = fs::path(sOutDir) / pathProj.filename();
+			if (bSoftware)
+			{
+				dataManager.loadModel(false, false);
+				pSoftRenderer->renderProject(dataManager, outDir);
+				dataManager.releasePixels();
+			}
+			else
+			{
+				dataManager.loadModel(false);
+				dataManager.bindTextures();
+				pRenderer->renderProject(dataManager, outDir);
+				dataManager.releaseGpu();
+			}
+		}
+	}
+	size_t nFailed = writer.wait();
+	std::cout << "Batch done, " << nFailed << " image(s) failed." << std::endl;
+	return nFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
 void ProcessInput(GLFWwindow *window)
 {
+	TRACE_SCOPE("ProcessInput");
 	if (g_sceneMode == SceneMode_Overall)
 	{
 		if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
@@ -509,6 +860,8 @@ void ProcessInput(GLFWwindow *window)
 	else if(g_sceneMode == SceneMode_Detailed && g_iPickedLandmark != NO_PICKED_LANDMARK)
 	{
 		auto itLandmarkCoords = g_pDataManager->getLandmarkCoordsSets().begin() + g_iPickedView;
+		float xOld = itLandmarkCoords->at(g_iPickedLandmark * 2);
+		float yOld = itLandmarkCoords->at(g_iPickedLandmark * 2 + 1);
 		if (k_aRotTypes[g_iPickedView] == RotateType_CCW)
 		{
 			if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
@@ -531,7 +884,19 @@ void ProcessInput(GLFWwindow *window)
 			if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 				itLandmarkCoords->at(g_iPickedLandmark * 2 + 1) += LDMK_SPEED;
 		}
+
+		float xNew = itLandmarkCoords->at(g_iPickedLandmark * 2), yNew = itLandmarkCoords->at(g_iPickedLandmark * 2 + 1);
+		if (xNew != xOld || yNew != yOld)
+		{
+			// a held key keeps extending the same edit until it is released
+			g_history.record(g_iPickedView, g_iPickedLandmark, xOld, yOld, xNew, yNew, LandmarkHistory::Source_Nudge);
+			OnLandmarkMoved(g_iPickedView, g_iPickedLandmark);
+		}
+		else
+			g_history.seal();
 	}
+	else
+		g_history.seal();
 
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
@@ -594,8 +959,20 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 
 		if (key == GLFW_KEY_R && action == GLFW_RELEASE && mods == GLFW_MOD_CONTROL)
 			g_deCam = Camera();
+
+		if (key == GLFW_KEY_Z && action != GLFW_RELEASE && mods == GLFW_MOD_CONTROL)
+			g_history.undo(g_pDataManager->getLandmarkCoordsSets(), OnLandmarkMoved);
+		else if (key == GLFW_KEY_Y && action != GLFW_RELEASE && mods == GLFW_MOD_CONTROL)
+			g_history.redo(g_pDataManager->getLandmarkCoordsSets(), OnLandmarkMoved);
 	}
 
+	if (key == GLFW_KEY_F3 && action == GLFW_RELEASE)
+		g_profiler.enabled = !g_profiler.enabled;
+	else if (key == GLFW_KEY_F4 && action == GLFW_RELEASE && g_profiler.enabled)
+		g_profiler.dumpCsv("profile.csv");	// nothing is recorded while the profiler is off
+	else if (key == GLFW_KEY_F5 && action == GLFW_RELEASE)
+		g_bShowMemory = !g_bShowMemory;
+
 	if (key == GLFW_KEY_LEFT_SHIFT && action == GLFW_PRESS)
 		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -633,38 +1010,143 @@ void HelpMarker(const char* desc)
 }
 
 
-std::vector<float> PhotoPts2ScrPts(const std::vector<float>& photoPts, float height, float width, RotateType rotateType)
+int PickView(double xCursorPos, double yCursorPos, int scrWidth, int scrHeight, 
+	const std::vector<Eigen::Matrix4f> &aQuadInvModels)
 {
-	std::vector<float> scrPts;
-	for (int i = 0; i < photoPts.size() / 2; ++i)
+	Eigen::Vector3f origin, dir;
+	utils::unproject(xCursorPos, yCursorPos, scrWidth, scrHeight, g_mProj, g_mView, origin, dir);
+
+	// Quad vertices lie on z = 1 of the model frame (see RenderManager::RenderQuad)
+	int iPicked = NO_PICKED_FACE;
+	float tNearest = std::numeric_limits<float>::max();
+	for (int i = 0; i < aQuadInvModels.size(); ++i)
 	{
-		float xPos, yPos;
-		if (rotateType == RotateType_CCW)
+		float t;
+		if (utils::intersectQuad(aQuadInvModels[i], origin, dir, 1.f, t) && t < tNearest)
 		{
-			xPos = photoPts.at(i * 2 + 1) / height * 2 - 1.0f;
-			yPos = photoPts.at(i * 2) / width * 2 - 1.0f;
+			tNearest = t;
+			iPicked = i;
 		}
-		else if(rotateType == RotateType_CW)
+	}
+	return iPicked;
+}
+
+
+void RebuildLandmarkGrid(const std::vector<float> &scrPts, const std::vector<float> &photoPts)
+{
+	g_landmarkGrid.reset(photoPts.size() / 2);
+	for (int i = 0; i < photoPts.size() / 2; ++i)
+	{
+		if (photoPts[i * 2] == 0.f && photoPts[i * 2 + 1] == 0.f) continue;	// missing in this view
+		g_landmarkGrid.update(i, scrPts[i * 2], scrPts[i * 2 + 1]);
+	}
+	g_iLandmarkGridView = g_iPickedView;
+}
+
+
+// Keeps derived per-landmark state in sync after landmark `iLandmark` of view `iView` was edited
+void OnLandmarkMoved(int iView, int iLandmark)
+{
+	g_triangulator.update(g_pDataManager->getLandmarkCoordsSets(), iView, iLandmark);
+	if (iView != g_iLandmarkGridView)
+		return;
+
+	const std::vector<float> &photoPts = g_pDataManager->getLandmarkCoordsSets()[iView];
+	glm::vec2 scrPt = photo_utils::PhotoPt2ScrPt(photoPts[iLandmark * 2], photoPts[iLandmark * 2 + 1], 
+		g_pDataManager->getHeight(), g_pDataManager->getWidth(), k_aRotTypes[iView]);
+	g_landmarkGrid.update(iLandmark, scrPt.x, scrPt.y);
+}
+
+
+// Merges annotation files changed on disk and reloads the model if it was rewritten, reading it on
+// the scheduler and swapping it in on a later call; landmarks with unsaved edits here are kept and
+// listed as conflicts. Returns true if the model was replaced
+bool PollFileChanges()
+{
+	std::vector<fs::path> aLandmarkFiles;
+	bool bModel = false;
+	for (const std::string &path : g_fileWatcher.poll())
+	{
+		if (fs::path(path) == g_pDataManager->modelPath())
+			bModel = true;
+		else
+			aLandmarkFiles.push_back(path);
+	}
+
+	if (!aLandmarkFiles.empty())
+	{
+		ProjectData::LandmarkReload reload = g_pDataManager->reloadLandmarks(aLandmarkFiles);
+		// the whole reload is one undo step
+		g_history.beginGroup();
+		for (const ProjectData::LandmarkUpdate &u : reload.aUpdates)
 		{
-			xPos = photoPts.at(i * 2 + 1) / height * 2 - 1.0f;
-			yPos = 1.f - photoPts.at(i * 2) / width * 2;
+			g_history.record(u.iView, u.iLandmark, u.from[0], u.from[1], u.to[0], u.to[1], LandmarkHistory::Source_Reload);
+			OnLandmarkMoved(u.iView, u.iLandmark);
 		}
-		else
+		g_history.endGroup();
+		for (const ProjectData::LandmarkConflict &c : reload.aConflicts)
 		{
-			std::cerr << "[ERROR] Wrong rotate type at point: " << i << std::endl;
-			xPos = yPos = 0.f; 
+			g_aConflicts.erase(std::remove_if(g_aConflicts.begin(), g_aConflicts.end(), [&](const ProjectData::LandmarkConflict &old) {
+				return old.iView == c.iView && old.iLandmark == c.iLandmark;
+			}), g_aConflicts.end());
+			g_aConflicts.push_back(c);
 		}
+		if (reload.nFiles)
+			std::cout << "Reloaded " << reload.nFiles << " landmark file(s): " << reload.aUpdates.size() << " landmark(s) updated, "
+				<< reload.aConflicts.size() << " conflicting with unsaved edits." << std::endl;
+	}
 
-		scrPts.push_back(xPos);
-		scrPts.push_back(yPos);
-		// std::cout << photoPts.at(i * 2) << " : " << photoPts.at(i * 2 + 1) << " : " << xPos << " : " << yPos << std::endl; 
+	if (bModel)
+	{
+		g_pDataManager->startReloadModel();
+		std::cout << "Reloading the model from " << g_pDataManager->modelPath().string() << "." << std::endl;
 	}
-	return scrPts;
+	if (!g_pDataManager->pollReload())
+		return false;
+	// the BVH and depth map renders read the old meshes
+	g_raycaster.wait();
+	g_depthCache.invalidate();
+	g_pDataManager->finishReload();
+	g_depthCache.setModel(g_pDataManager->getModel());
+	g_raycaster.startBuild(*g_pDataManager->getModel());
+	g_aLandmarkHits.clear();
+	++g_uModelVersion;
+	std::cout << "Reloaded the model from " << g_pDataManager->modelPath().string() << "." << std::endl;
+	return true;
+}
+
+
+// $XDG_CACHE_HOME/face_multiviewer/shaders, or under ~/.cache; empty if neither is set
+std::string DefaultShaderCacheDir()
+{
+	const char *xdg = std::getenv("XDG_CACHE_HOME");
+	const char *home = std::getenv("HOME");
+	fs::path base;
+	if (xdg && *xdg)
+		base = xdg;
+	else if (home && *home)
+		base = fs::path(home) / ".cache";
+	else
+		return "";
+	return (base / "face_multiviewer" / "shaders").string();
+}
+
+
+// Writes propagation candidate `i` into the landmarks as an undoable edit
+void AcceptCandidate(size_t i)
+{
+	const LandmarkPropagator::Candidate &c = g_propagator.candidates()[i];
+	const std::vector<float> &pts = g_pDataManager->getLandmarkCoordsSets()[c.iView];
+	float xOld = pts[c.iLandmark * 2], yOld = pts[c.iLandmark * 2 + 1];
+	LandmarkPropagator::Candidate accepted = g_propagator.accept(i, g_pDataManager->getLandmarkCoordsSets());
+	g_history.record(accepted.iView, accepted.iLandmark, xOld, yOld, accepted.pt.x(), accepted.pt.y(), LandmarkHistory::Source_Propagation);
+	OnLandmarkMoved(accepted.iView, accepted.iLandmark);
 }
 
 
 bool DrawGui(GLFWwindow* window)
 {
+	TRACE_SCOPE("DrawGui");
 	bool guiActive = true;
 
 	ImGui_ImplOpenGL3_NewFrame();
@@ -677,6 +1159,8 @@ bool DrawGui(GLFWwindow* window)
 		{
 			if (ImGui::BeginMenu("File"))
 			{
+				if (!g_sTracePath.empty() && ImGui::MenuItem("Write Trace"))
+					trace_utils::writeChromeTrace(g_sTracePath);
 				if (ImGui::MenuItem("Close", "Esc")) glfwSetWindowShouldClose(window, true);
 				ImGui::EndMenu();
 			}
@@ -700,6 +1184,12 @@ bool DrawGui(GLFWwindow* window)
 		ImGui::SameLine(); 
 		HelpMarker("Or you can click with cursor pointing at expected face");
 		ImGui::Text("If moving cursor to expected face, then its landmarks will show up.");
+		ImGui::Text("Reprojection outliers: %zu (over %.1f px).", g_triangulator.outlierCount(), g_triangulator.outlierThreshold);
+		ImGui::SliderFloat("LOD error (px)", &g_fLodPixelError, 0.f, 8.f, "%.1f");
+		ImGui::Checkbox("Adaptive resolution", &g_resolutionScaler.bEnabled);
+		ImGui::SameLine();
+		ImGui::Text("(%.0f%% while moving)", g_resolutionScaler.scale() * 100.f);
+		ImGui::SliderFloat("Frame budget (ms)", &g_resolutionScaler.budgetMs, 8.f, 100.f, "%.1f");
 	}
 	else // Detailed Mode
 	{
@@ -713,6 +1203,9 @@ bool DrawGui(GLFWwindow* window)
 					g_pDataManager->saveLandmarks(g_iPickedView);
 				}
 
+				if (!g_sTracePath.empty() && ImGui::MenuItem("Write Trace"))
+					trace_utils::writeChromeTrace(g_sTracePath);
+
 				if (ImGui::MenuItem("Close", "Esc")) 
 				{
 					glfwSetWindowShouldClose(window, true);
@@ -737,6 +1230,20 @@ bool DrawGui(GLFWwindow* window)
 			"Hold `Left_Shift` and move with `W`/`A`/`S`/`D` or mouse.\n"
 			"(first person perspective)"
 		);
+		ImGui::SliderFloat("LOD error (px)", &g_fLodPixelError, 0.f, 8.f, "%.1f");
+		ImGui::Checkbox("Adaptive resolution", &g_resolutionScaler.bEnabled);
+		ImGui::SameLine();
+		ImGui::Text("(%.0f%% while moving)", g_resolutionScaler.scale() * 100.f);
+		ImGui::SliderFloat("Frame budget (ms)", &g_resolutionScaler.budgetMs, 8.f, 100.f, "%.1f");
+		if (g_pDataManager->hasPhotoColors())
+		{
+			bool bPhotoColors = g_pDataManager->usesPhotoColors();
+			if (ImGui::Checkbox("Colors from photos", &bPhotoColors))
+			{
+				g_pDataManager->usePhotoColors(bPhotoColors);
+				++g_uModelVersion;
+			}
+		}
 		ImGui::Separator();
 		ImGui::TextColored(ImVec4(0.0f, 0.78f, 0.55f, 1.0f), "II. Landmark (right)");
 		ImGui::Text("Current Chosen Face Id: %d.", g_iPickedView);
@@ -749,7 +1256,8 @@ bool DrawGui(GLFWwindow* window)
 		else if(g_iPickedLandmark == NO_PICKED_LANDMARK) g_iPickedLandmark = NO_PICKED_LANDMARK;
 		else if(g_iPickedLandmark >= N_LANDMARKS) g_iPickedLandmark = N_LANDMARKS - 1;
 
-		ImGui::Text("Hold `Mouse Left Butoon` to change landmark coordinates.");
+		ImGui::Text("Click with `Mouse Left Button` to choose a landmark.");
+		ImGui::SliderFloat("Pick tolerance (px)", &g_fPickTolerance, 0.f, 20.f, "%.1f");
 		ImGui::Text("If one landmark (original is ");
 		ImGui::SameLine(); ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "RED");
 		ImGui::SameLine(); ImGui::Text(") was chosen, it would turn into ");
@@ -760,10 +1268,238 @@ bool DrawGui(GLFWwindow* window)
 			ImGui::Text("Current Chosen Landmark Id: %d.", g_iPickedLandmark);
 		else
 			ImGui::Text("Current No Chosen Landmark.");
+		ImGui::Separator();
+		ImGui::TextColored(ImVec4(0.0f, 0.78f, 0.55f, 1.0f), "III. Reprojection");
+		ImGui::Checkbox("Highlight outliers", &g_bShowOutliers);
+		ImGui::SameLine(); ImGui::TextColored(ImVec4(1.0f, 0.0f, 1.0f, 1.0f), "annotation");
+		ImGui::SameLine(); ImGui::TextColored(ImVec4(0.0f, 1.0f, 1.0f, 1.0f), "reprojection");
+		if (ImGui::SliderFloat("Outlier threshold (px)", &g_triangulator.outlierThreshold, 1.f, 50.f, "%.1f"))
+			g_triangulator.updateStatistics();
+		ImGui::Checkbox("Epipolar lines", &g_bShowEpipolarLines);
+		ImGui::SameLine(); ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "from the other views");
+		if (!g_raycaster.ready())
+		{
+			ImGui::Text("Building the surface BVH...");
+		}
+		else
+		{
+			if (g_iPickedLandmark < g_triangulator.landmarks().size())
+			{
+				const std::vector<float> &pts = g_pDataManager->getLandmarkCoordsSets()[g_iPickedView];
+				MeshBvh::Hit hit = g_raycaster.castLandmark(g_iPickedView, pts[g_iPickedLandmark * 2], pts[g_iPickedLandmark * 2 + 1]);
+				const LandmarkTriangulator::Landmark &lm = g_triangulator.landmarks()[g_iPickedLandmark];
+				if (!hit.valid())
+					ImGui::Text("The ray misses the surface.");
+				else if (lm.bValid)
+					ImGui::Text("Surface hit at depth %.2f, %.3f from the triangulated point.", hit.t, 
+						glm::length(hit.point - glm::vec3(lm.point.x(), lm.point.y(), lm.point.z())));
+				else
+					ImGui::Text("Surface hit at depth %.2f.", hit.t);
+			}
+			if (ImGui::Button("Cast all landmarks"))
+			{
+				auto start = std::chrono::steady_clock::now();
+				g_aLandmarkHits = g_raycaster.castAll(g_pDataManager->getLandmarkCoordsSets());
+				g_fCastAllMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			}
+			if (!g_aLandmarkHits.empty())
+			{
+				size_t nHits = 0, nRays = 0;
+				const std::vector<std::vector<float>> &aSets = g_pDataManager->getLandmarkCoordsSets();
+				for (size_t v = 0; v < g_aLandmarkHits.size(); ++v)
+				{
+					for (size_t i = 0; i < g_aLandmarkHits[v].size(); ++i)
+					{
+						nRays += aSets[v][i * 2] != 0.f || aSets[v][i * 2 + 1] != 0.f;
+						nHits += g_aLandmarkHits[v][i].valid();
+					}
+				}
+				ImGui::SameLine();
+				ImGui::Text("%zu of %zu rays hit in %.2f ms", nHits, nRays, g_fCastAllMs);
+			}
+		}
+		if (g_iPickedLandmark < g_triangulator.landmarks().size())
+		{
+			const LandmarkTriangulator::Landmark &lm = g_triangulator.landmarks()[g_iPickedLandmark];
+			float error = g_triangulator.error(g_iPickedView, g_iPickedLandmark);
+			if (error != LandmarkTriangulator::NO_ERROR)
+				ImGui::Text("Error %.1f px here, inlier RMS %.1f px over %d views.", error, lm.rmsError, lm.nViews - lm.nOutliers);
+			else
+				ImGui::Text("Not triangulated (%d annotated views).", lm.nViews);
+			if (lm.bValid && g_depthCache.visibility(g_iPickedView, lm.point) == ViewDepthCache::Visibility_Hidden)
+				ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "The triangulated point is hidden in this view.");
+		}
+		ImGui::Text("Outliers: %zu in this view, %zu in all views.", 
+			g_triangulator.outlierCount(g_iPickedView), g_triangulator.outlierCount());
+		for (size_t i = 0; i < g_triangulator.landmarks().size(); ++i)
+		{
+			if (!g_triangulator.isOutlier(g_iPickedView, i))
+				continue;
+			char label[64];
+			bool bHidden = g_depthCache.visibility(g_iPickedView, g_triangulator.landmarks()[i].point) == ViewDepthCache::Visibility_Hidden;
+			snprintf(label, sizeof(label), "Landmark %zu: %.1f px%s", i, g_triangulator.error(g_iPickedView, i), bHidden ? " (hidden)" : "");
+			if (ImGui::Selectable(label, g_iPickedLandmark == int(i)))
+			{
+				g_iPickedLandmark = int(i);
+				g_bSelectLandmark = true;
+			}
+		}
+		ImGui::Separator();
+		ImGui::TextColored(ImVec4(0.0f, 0.78f, 0.55f, 1.0f), "IV. Propagation");
+		ImGui::Checkbox("Seed from the surface hit", &g_bPropagateFromSurface);
+		ImGui::SameLine(); HelpMarker("Otherwise from the triangulated point; either falls back to the other when missing.");
+		ImGui::SliderFloat("Min offset (px)", &g_propagator.minOffset, 0.f, 50.f, "%.1f");
+		ImGui::Checkbox("Only where visible", &g_bPropagateVisibleOnly);
+		std::function<bool(size_t, const Eigen::Vector3f&)> isVisible;
+		// a view whose depth map is still rendering keeps its candidate, better one too many to review
+		if (g_bPropagateVisibleOnly)
+			isVisible = [](size_t iView, const Eigen::Vector3f &X) { return g_depthCache.visibility(iView, X) != ViewDepthCache::Visibility_Hidden; };
+		if (ImGui::Button("Propagate to all views") && g_iPickedLandmark < g_triangulator.landmarks().size())
+		{
+			const std::vector<float> &pts = g_pDataManager->getLandmarkCoordsSets()[g_iPickedView];
+			MeshBvh::Hit hit = g_raycaster.castLandmark(g_iPickedView, pts[g_iPickedLandmark * 2], pts[g_iPickedLandmark * 2 + 1]);
+			const LandmarkTriangulator::Landmark &lm = g_triangulator.landmarks()[g_iPickedLandmark];
+			bool bSurface = hit.valid() && (g_bPropagateFromSurface || !lm.bValid);
+			if (bSurface || lm.bValid)
+			{
+				Eigen::Vector3f point = bSurface ? Eigen::Vector3f(hit.point.x, hit.point.y, hit.point.z) : lm.point;
+				g_propagator.propose({ g_iPickedLandmark }, { point }, g_pDataManager->getLandmarkCoordsSets(), g_iPickedView, isVisible);
+			}
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Propagate all landmarks"))
+		{
+			// every triangulated landmark in one batch, into every view
+			std::vector<int> aLandmarks;
+			std::vector<Eigen::Vector3f> aPoints;
+			for (size_t i = 0; i < g_triangulator.landmarks().size(); ++i)
+			{
+				if (!g_triangulator.landmarks()[i].bValid) continue;
+				aLandmarks.push_back(int(i));
+				aPoints.push_back(g_triangulator.landmarks()[i].point);
+			}
+			g_propagator.propose(aLandmarks, aPoints, g_pDataManager->getLandmarkCoordsSets(), -1, isVisible);
+		}
+
+		const std::vector<LandmarkPropagator::Candidate> &aCandidates = g_propagator.candidates();
+		if (!aCandidates.empty())
+		{
+			ImGui::Text("%zu candidate(s):", aCandidates.size());
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Accept all"))
+			{
+				// one undo step for all of them
+				g_history.beginGroup();
+				while (!g_propagator.candidates().empty())
+					AcceptCandidate(0);
+				g_history.endGroup();
+			}
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Reject all"))
+				g_propagator.clear();
+		}
+		for (size_t i = 0; i < g_propagator.candidates().size(); ++i)
+		{
+			const LandmarkPropagator::Candidate &c = g_propagator.candidates()[i];
+			ImGui::PushID(int(i));
+			if (c.offset < 0.f)
+				ImGui::Text("View %d, landmark %d: new at (%.0f, %.0f)", c.iView, c.iLandmark, c.pt.x(), c.pt.y());
+			else
+				ImGui::Text("View %d, landmark %d: moves %.1f px", c.iView, c.iLandmark, c.offset);
+			ImGui::SameLine();
+			bool bAccept = ImGui::SmallButton("Accept");
+			ImGui::SameLine();
+			bool bReject = ImGui::SmallButton("Reject");
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Show"))
+			{
+				g_iPickedView = c.iView;
+				g_iPickedLandmark = c.iLandmark;
+				g_bSelectLandmark = true;
+			}
+			ImGui::PopID();
+			if (bAccept)
+			{
+				AcceptCandidate(i);
+				break;
+			}
+			if (bReject)
+			{
+				g_propagator.reject(i);
+				break;
+			}
+		}
+		if (!g_aConflicts.empty())
+		{
+			ImGui::Separator();
+			ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "%zu landmark(s) changed on disk with unsaved edits here:", g_aConflicts.size());
+			for (size_t i = 0; i < g_aConflicts.size(); ++i)
+			{
+				const ProjectData::LandmarkConflict &c = g_aConflicts[i];
+				ImGui::PushID(int(i));
+				ImGui::Text("View %d, landmark %d: here (%.1f, %.1f), file (%.1f, %.1f)", c.iView, c.iLandmark,
+					c.local[0], c.local[1], c.disk[0], c.disk[1]);
+				ImGui::SameLine();
+				bool bKeep = ImGui::SmallButton("Keep mine");
+				ImGui::SameLine();
+				bool bTake = ImGui::SmallButton("Take file");
+				ImGui::SameLine();
+				if (ImGui::SmallButton("Show"))
+				{
+					g_iPickedView = c.iView;
+					g_iPickedLandmark = c.iLandmark;
+					g_bSelectLandmark = true;
+				}
+				ImGui::PopID();
+				if (bTake)
+				{
+					std::vector<float> &pts = g_pDataManager->getLandmarkCoordsSets()[c.iView];
+					g_history.record(c.iView, c.iLandmark, pts[c.iLandmark * 2], pts[c.iLandmark * 2 + 1], c.disk[0], c.disk[1], 
+						LandmarkHistory::Source_Reload);
+					pts[c.iLandmark * 2] = c.disk[0];
+					pts[c.iLandmark * 2 + 1] = c.disk[1];
+					OnLandmarkMoved(c.iView, c.iLandmark);
+				}
+				if (bKeep || bTake)
+				{
+					g_aConflicts.erase(g_aConflicts.begin() + i);
+					break;
+				}
+			}
+		}
+		ImGui::Separator();
 		ImGui::TextColored(ImVec4(0.5f, 1.0f, 1.0f, 1.0f), "Change Log");
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Undo"))
+			g_history.undo(g_pDataManager->getLandmarkCoordsSets(), OnLandmarkMoved);
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Redo"))
+			g_history.redo(g_pDataManager->getLandmarkCoordsSets(), OnLandmarkMoved);
+		ImGui::SameLine(); HelpMarker("`Ctrl-Z` / `Ctrl-Y`. Undone edits are greyed out until the next edit drops them.");
+		if (g_history.overflowCount() > 0)
+		{
+			ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "%zu edits made in one step did not fit in the history and cannot be undone.", 
+				g_history.overflowCount());
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Dismiss"))
+				g_history.clearOverflow();
+		}
 		ImGui::BeginChild("Scrolling");
-		for (auto iLog = g_aChangeLog.rbegin(); iLog < g_aChangeLog.rend(); iLog++)
-			ImGui::Text("%s", iLog->c_str());
+		// newest first, only the visible rows are formatted
+		ImGuiListClipper clipper;
+		clipper.Begin(int(g_history.size()));
+		while (clipper.Step())
+		{
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+			{
+				size_t i = g_history.size() - 1 - size_t(row);
+				std::string line = LandmarkHistory::describe(g_history.edit(i));
+				if (i < g_history.appliedCount())
+					ImGui::TextUnformatted(line.c_str());
+				else
+					ImGui::TextDisabled("%s", line.c_str());
+			}
+		}
 		ImGui::EndChild();
 		if (ImGui::Button("Save New Landmarks"))
 		{
@@ -780,12 +1516,14 @@ bool DrawGui(GLFWwindow* window)
 				(int)ptm->tm_year + 1900, (int)ptm->tm_mon + 1, (int)ptm->tm_mday,
 				(int)ptm->tm_hour, (int)ptm->tm_min, (int)ptm->tm_sec);
 			std::ofstream out(std::to_string(g_iPickedView) + "-" + std::string(date) + ".log");
-			for (auto iLog = g_aChangeLog.begin(); iLog < g_aChangeLog.end(); iLog++)
-				out << *iLog << "\n";
+			for (size_t i = 0; i < g_history.appliedCount(); ++i)
+				out << LandmarkHistory::describe(g_history.edit(i)) << "\n";
 			out.close();
 		}		
 	}
 
 	ImGui::End();
+	g_profiler.drawGui();
+	g_memoryPanel.draw(g_memoryRegistry, &g_bShowMemory);
 	return false;
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "landmark_history.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+
+static int check(bool bOk, const char *what)
+{
+	if (!bOk)
+		std::cerr << "FAILED: " << what << std::endl;
+	return bOk ? 0 : 1;
+}
+
+
+int main()
+{
+	const int nViews = 2, nLandmarks = 8;
+	std::vector<std::vector<float>> aSets(nViews, std::vector<float>(nLandmarks * 2, 0.f));
+	int nFailed = 0;
+
+	// a held nudge key is one edit until seal(), and undoes to where it started
+	{
+		LandmarkHistory history(16);
+		history.record(0, 1, 0.f, 0.f, 1.f, 0.f, LandmarkHistory::Source_Nudge);
+		history.record(0, 1, 1.f, 0.f, 2.f, 0.f, LandmarkHistory::Source_Nudge);
+		history.record(0, 1, 2.f, 0.f, 3.f, 0.f, LandmarkHistory::Source_Nudge);
+		nFailed += check(history.size() == 1 && history.edit(0).to[0] == 3.f, "nudges of one landmark coalesce");
+		history.record(0, 2, 0.f, 0.f, 0.f, 1.f, LandmarkHistory::Source_Nudge);
+		nFailed += check(history.size() == 2, "a nudge of another landmark starts a new edit");
+		history.seal();
+		history.record(0, 2, 0.f, 1.f, 0.f, 2.f, LandmarkHistory::Source_Nudge);
+		nFailed += check(history.size() == 3, "seal() ends the nudge");
+
+		aSets[0][2] = 3.f;
+		history.undo(aSets, nullptr);
+		history.undo(aSets, nullptr);
+		history.undo(aSets, nullptr);
+		nFailed += check(aSets[0][2] == 0.f && aSets[0][3] == 0.f, "undoing the coalesced nudge restores its start");
+		nFailed += check(!history.canUndo() && history.canRedo(), "everything undone can be redone");
+		history.redo(aSets, nullptr);
+		nFailed += check(aSets[0][2] == 3.f, "redo reapplies the whole nudge");
+	}
+
+	// a full ring drops the oldest operation whole, never part of it
+	{
+		LandmarkHistory history(5);
+		history.beginGroup();
+		for (int i = 0; i < 3; ++i)
+			history.record(1, i, 0.f, 0.f, 1.f, 1.f, LandmarkHistory::Source_Propagation);
+		history.endGroup();
+		history.record(1, 3, 0.f, 0.f, 1.f, 1.f, LandmarkHistory::Source_Propagation);
+		history.record(1, 4, 0.f, 0.f, 1.f, 1.f, LandmarkHistory::Source_Propagation);
+		nFailed += check(history.size() == 5, "the ring fills up");
+		history.record(1, 5, 0.f, 0.f, 1.f, 1.f, LandmarkHistory::Source_Propagation);
+		nFailed += check(history.size() == 3 && history.edit(0).iLandmark == 3, "the three-edit group is dropped whole");
+		int nUndone = 0;
+		while (history.undo(aSets, nullptr))
+			++nUndone;
+		nFailed += check(nUndone == 3, "the remaining single edits undo one by one");
+		nFailed += check(history.overflowCount() == 0, "dropping older operations is no overflow");
+	}
+
+	// a group larger than the ring cannot be undone, and says so
+	{
+		LandmarkHistory history(4);
+		history.record(0, 0, 0.f, 0.f, 1.f, 1.f, LandmarkHistory::Source_Reload);
+		history.beginGroup();
+		size_t nRecorded = 0;
+		for (int i = 0; i < 6; ++i)
+			nRecorded += history.record(0, i + 1, 0.f, 0.f, 1.f, 1.f, LandmarkHistory::Source_Reload);
+		history.endGroup();
+		nFailed += check(nRecorded == 4, "the group is recorded until it fills the ring by itself");
+		nFailed += check(history.overflowCount() == 6, "every edit of the group is reported");
+		nFailed += check(history.size() == 0 && !history.canUndo(), "no part of the group is left to undo");
+
+		nFailed += check(history.record(1, 0, 0.f, 0.f, 1.f, 1.f, LandmarkHistory::Source_Reload), "later edits are recorded again");
+		nFailed += check(history.size() == 1 && history.overflowCount() == 6, "the report stays until cleared");
+		history.clearOverflow();
+		nFailed += check(history.overflowCount() == 0, "clearOverflow() clears the report");
+	}
+
+	if (nFailed == 0)
+		std::cout << "landmark_history_test passed" << std::endl;
+	return nFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
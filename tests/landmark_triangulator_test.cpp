@@ -0,0 +1,83 @@
+#include "landmark_triangulator.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+
+// Cameras on a circle looking at the origin, 1000 x 1000 photos with f = 1000
+static PhotoCameras makeCameras(int nViews)
+{
+	PhotoCameras cameras;
+	cameras.width = cameras.height = 1000.f;
+	Eigen::Matrix3f K;
+	K << 1000.f, 0.f, 500.f,
+		0.f, 1000.f, 500.f,
+		0.f, 0.f, 1.f;
+	for (int i = 0; i < nViews; ++i)
+	{
+		float a = 0.3f * (i - nViews / 2);
+		Eigen::Vector3f C(10.f * std::sin(a), 0.f, -10.f * std::cos(a));
+		Eigen::Vector3f z = -C.normalized(), y(0.f, 1.f, 0.f), x = y.cross(z).normalized();
+		Eigen::Matrix3f R;
+		R << x.transpose(), z.cross(x).transpose(), z.transpose();
+		Eigen::Matrix<float, 3, 4> T;
+		T << R, -R * C;
+		cameras.aProj.push_back(K * T);
+		cameras.aCenters.push_back(C);
+	}
+	return cameras;
+}
+
+
+static int check(bool bOk, const char *what)
+{
+	if (!bOk)
+		std::cerr << "FAILED: " << what << std::endl;
+	return bOk ? 0 : 1;
+}
+
+
+int main()
+{
+	const int nViews = 6, nLandmarks = 3;
+	PhotoCameras cameras = makeCameras(nViews);
+	std::vector<Eigen::Vector3f> aPoints = { { 0.f, 0.f, 0.f }, { 0.5f, 0.2f, 0.1f }, { -0.4f, -0.3f, 0.2f } };
+	std::vector<std::vector<float>> aSets(nViews, std::vector<float>(nLandmarks * 2, 0.f));
+	for (int v = 0; v < nViews; ++v)
+	{
+		for (int i = 0; i < nLandmarks; ++i)
+		{
+			Eigen::Vector3f h = cameras.aProj[v] * aPoints[i].homogeneous();
+			aSets[v][i * 2] = h.x() / h.z();
+			aSets[v][i * 2 + 1] = h.y() / h.z();
+		}
+	}
+	// landmark 0 is misplaced by 80 px in view 0, an outlier against the five others
+	aSets[0][0] += 80.f;
+
+	LandmarkTriangulator triangulator;
+	triangulator.setCameras(cameras);
+	triangulator.solve(aSets);
+	size_t nStart = triangulator.outlierCount();
+	int nFailed = check(nStart == 1, "one outlier after solve()");
+
+	// removing and restoring another view's annotation re-triangulates landmark 0 from scratch
+	float x = aSets[3][0], y = aSets[3][1];
+	for (int round = 0; round < 3; ++round)
+	{
+		aSets[3][0] = aSets[3][1] = 0.f;
+		triangulator.update(aSets, 3, 0);
+		aSets[3][0] = x;
+		aSets[3][1] = y;
+		triangulator.update(aSets, 3, 0);
+	}
+	nFailed += check(triangulator.outlierCount() == nStart, "outlierCount() back to its start after toggling an annotation");
+
+	triangulator.updateStatistics();
+	nFailed += check(triangulator.outlierCount() == nStart, "incremental count matches a full recount");
+
+	if (nFailed == 0)
+		std::cout << "landmark_triangulator_test passed" << std::endl;
+	return nFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
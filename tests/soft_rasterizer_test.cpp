@@ -0,0 +1,200 @@
+#include "gl/headless_context.h"
+#include "soft/soft_rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+// Renders the same clip-space triangles through GL and soft::Rasterizer and compares coverage,
+// depth and color. Needs an EGL context (llvmpipe is enough); exits with 77, which ctest
+// reports as skipped, where there is none.
+
+static const int WIDTH = 517, HEIGHT = 389;	// not multiples of the tile size
+
+static GLuint compile(GLenum type, const char *source)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+	return shader;
+}
+
+
+// Random perspective triangles, some crossing the near plane, plus a textured quad behind them
+static void makeScene(std::vector<soft::Vertex> &aTris, std::vector<unsigned int> &aTriIndices,
+	std::vector<soft::Vertex> &aQuad, std::vector<unsigned int> &aQuadIndices)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> pos(-1.3f, 1.3f), unit(0.f, 1.f), depth(0.5f, 3.f);
+	for (int t = 0; t < 400; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			float w = depth(rng);
+			soft::Vertex v;
+			v.clip = glm::vec4(pos(rng) * w, pos(rng) * w, pos(rng) * 0.9f * w, w);
+			if (t % 37 == 0 && k == 0)
+				v.clip.z = -1.5f * w;	// in front of the near plane, clipped
+			v.color = glm::vec4(unit(rng), unit(rng), unit(rng), 1.f);
+			v.uv = glm::vec2(unit(rng), unit(rng));
+			aTris.push_back(v);
+			aTriIndices.push_back(unsigned(aTriIndices.size()));
+		}
+	}
+	aQuad = {
+		{ glm::vec4(-0.9f, 0.9f, 0.95f, 1.f), glm::vec4(1.f), glm::vec2(0.f, 0.f) },
+		{ glm::vec4(-0.9f, -0.9f, 0.95f, 1.f), glm::vec4(1.f), glm::vec2(0.f, 1.f) },
+		{ glm::vec4(0.9f, 0.9f, 0.95f, 1.f), glm::vec4(1.f), glm::vec2(1.f, 0.f) },
+		{ glm::vec4(0.9f, -0.9f, 0.95f, 1.f), glm::vec4(1.f), glm::vec2(1.f, 1.f) }
+	};
+	aQuadIndices = { 0, 1, 2, 2, 1, 3 };
+}
+
+
+static int check(bool bOk, const char *what)
+{
+	if (!bOk)
+		std::cerr << "FAILED: " << what << std::endl;
+	return bOk ? 0 : 1;
+}
+
+
+int main()
+{
+	HeadlessContext context;
+	if (!context.create())
+	{
+		std::cout << "soft_rasterizer_test skipped, no EGL context" << std::endl;
+		return 77;
+	}
+
+	std::vector<soft::Vertex> aTris, aQuad;
+	std::vector<unsigned int> aTriIndices, aQuadIndices;
+	makeScene(aTris, aTriIndices, aQuad, aQuadIndices);
+	const int TEX_WIDTH = 300, TEX_HEIGHT = 200;
+	std::vector<unsigned char> texels(TEX_WIDTH * TEX_HEIGHT * 3);
+	for (int i = 0; i < TEX_WIDTH * TEX_HEIGHT; ++i)
+	{
+		int x = i % TEX_WIDTH, y = i / TEX_WIDTH;
+		texels[i * 3] = x * 255 / TEX_WIDTH;
+		texels[i * 3 + 1] = y * 255 / TEX_HEIGHT;
+		texels[i * 3 + 2] = ((x / 8 + y / 8) & 1) * 255;
+	}
+
+	// GL, into a float depth buffer so depth compares without quantization
+	GLuint fbo, aRenderbuffers[2];
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glGenRenderbuffers(2, aRenderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, aRenderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, aRenderbuffers[0]);
+	glBindRenderbuffer(GL_RENDERBUFFER, aRenderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, WIDTH, HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, aRenderbuffers[1]);
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, compile(GL_VERTEX_SHADER, "#version 330 core\n"
+		"layout(location = 0) in vec4 aClip; layout(location = 1) in vec4 aColor; layout(location = 2) in vec2 aUv;\n"
+		"out vec4 color; out vec2 uv;\n"
+		"void main() { gl_Position = aClip; color = aColor; uv = aUv; }\n"));
+	glAttachShader(program, compile(GL_FRAGMENT_SHADER, "#version 330 core\n"
+		"in vec4 color; in vec2 uv; uniform bool bTextured; uniform sampler2D tex; out vec4 fragColor;\n"
+		"void main() { fragColor = bTextured ? color * texture(tex, uv) : color; }\n"));
+	glLinkProgram(program);
+	glUseProgram(program);
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, TEX_WIDTH, TEX_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, texels.data());
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	GLuint vao, vbo, ebo;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	auto draw = [&](const std::vector<soft::Vertex> &aVertices, const std::vector<unsigned int> &aIndices, bool bTextured) {
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, aVertices.size() * sizeof(soft::Vertex), aVertices.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, aIndices.size() * sizeof(unsigned int), aIndices.data(), GL_STREAM_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(soft::Vertex), (void*)offsetof(soft::Vertex, clip));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(soft::Vertex), (void*)offsetof(soft::Vertex, color));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(soft::Vertex), (void*)offsetof(soft::Vertex, uv));
+		glUniform1i(glGetUniformLocation(program, "bTextured"), bTextured);
+		glDrawElements(GL_TRIANGLES, GLsizei(aIndices.size()), GL_UNSIGNED_INT, nullptr);
+	};
+	glViewport(0, 0, WIDTH, HEIGHT);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glClearColor(0.f, 0.f, 0.f, 1.f);
+	glClearDepth(1.0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	draw(aTris, aTriIndices, false);
+	draw(aQuad, aQuadIndices, true);
+
+	std::vector<uint8_t> glRgb(size_t(WIDTH) * HEIGHT * 3);
+	std::vector<float> glDepth(size_t(WIDTH) * HEIGHT);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, glRgb.data());
+	glReadPixels(0, 0, WIDTH, HEIGHT, GL_DEPTH_COMPONENT, GL_FLOAT, glDepth.data());
+	int nFailed = check(glGetError() == GL_NO_ERROR, "GL rendering without errors");
+
+	soft::Rasterizer raster;
+	raster.resize(WIDTH, HEIGHT);
+	raster.clear(glm::vec4(0.f, 0.f, 0.f, 1.f));
+	soft::Texture2D softTexture(texels.data(), TEX_WIDTH, TEX_HEIGHT, 3);
+	raster.drawTriangles(aTris, aTriIndices);
+	raster.drawTriangles(aQuad, aQuadIndices, &softTexture);
+	raster.flush();
+	std::vector<uint8_t> softRgb;
+	std::vector<float> softDepth;
+	raster.readRgb(softRgb);
+	raster.readDepth(softDepth);
+
+	size_t nPixels = size_t(WIDTH) * HEIGHT, nCoverage = 0, nCovered = 0, nDepth = 0, nColor = 0;
+	float maxDepthDiff = 0.f;
+	for (size_t i = 0; i < nPixels; ++i)
+	{
+		bool bGl = glDepth[i] < 1.f, bSoft = softDepth[i] < 1.f;
+		nCoverage += bGl != bSoft;
+		if (bGl && bSoft)
+		{
+			++nCovered;
+			float diff = std::abs(glDepth[i] - softDepth[i]);
+			maxDepthDiff = std::max(maxDepthDiff, diff);
+			nDepth += diff > 1e-4f;
+		}
+		int maxDiff = 0;
+		for (int k = 0; k < 3; ++k)
+			maxDiff = std::max(maxDiff, std::abs(int(glRgb[i * 3 + k]) - int(softRgb[i * 3 + k])));
+		nColor += maxDiff > 2;
+	}
+	std::cout << glGetString(GL_RENDERER) << ": " << nCovered << " pixels covered by both, " << nCoverage << " covered by one only, "
+		<< nDepth << " with depth off by more than 1e-4 (max " << maxDepthDiff << "), " << nColor << " off by more than 2/255" << std::endl;
+
+	// GL snaps vertices to a subpixel grid, which shifts steep depth planes by ~1e-5 and lets a
+	// pixel center right on the edge of a sliver go to the triangle behind it instead; both
+	// only touch isolated pixels
+	nFailed += check(nCovered > nPixels / 2, "the scene covers most of the image");
+	nFailed += check(nCoverage * 10000 <= nPixels, "coverage differs in at most 0.01% of the pixels");
+	nFailed += check(nDepth * 5000 <= nPixels, "depth differs by more than 1e-4 in at most 0.02% of the pixels");
+	nFailed += check(nColor * 5000 <= nPixels, "color differs by more than 2/255 in at most 0.02% of the pixels");
+
+	if (nFailed == 0)
+		std::cout << "soft_rasterizer_test passed" << std::endl;
+	return nFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}